@@ -0,0 +1,102 @@
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+static constexpr unsigned MIN_POOLED_SHIFT = 6, NUM_SIZE_CLASSES = 15;
+static_assert(PoolAllocator::MIN_POOLED_SIZE == size_t(1) << MIN_POOLED_SHIFT && PoolAllocator::MAX_POOLED_SIZE == size_t(1) << MIN_POOLED_SHIFT + NUM_SIZE_CLASSES - 1);
+
+// the most bytes that a thread will hold on its free list for any one size class
+static constexpr size_t CACHE_LIMIT = 1 << 20;
+
+
+namespace {
+
+struct FreeBlock {
+	FreeBlock *next;
+};
+
+struct Pool {
+	FreeBlock *heads[NUM_SIZE_CLASSES] = { };
+	PoolAllocator::Stats stats = { };
+	size_t cached[NUM_SIZE_CLASSES] = { };
+	~Pool() { this->trim(); }
+	void trim() noexcept {
+		for (unsigned c = 0; c < NUM_SIZE_CLASSES; ++c) {
+			for (FreeBlock *block; (block = heads[c]);) {
+				heads[c] = block->next;
+				std::free(block);
+			}
+			cached[c] = 0;
+		}
+		stats.cached_bytes = 0;
+	}
+};
+
+thread_local Pool pool;
+
+} // namespace
+
+
+static unsigned _const size_class(size_t size) noexcept {
+	return size <= PoolAllocator::MIN_POOLED_SIZE ? 0 : SIZE_WIDTH - _clz(size - 1) - MIN_POOLED_SHIFT;
+}
+
+void * PoolAllocator::allocate(size_t size) noexcept {
+	++pool.stats.allocations;
+	if (size > MAX_POOLED_SIZE) {
+		return std::malloc(size);
+	}
+	unsigned c = size_class(size);
+	if (FreeBlock *block = pool.heads[c]) {
+		pool.heads[c] = block->next;
+		size_t class_size = MIN_POOLED_SIZE << c;
+		pool.cached[c] -= class_size, pool.stats.cached_bytes -= class_size;
+		++pool.stats.pool_hits;
+		return block;
+	}
+	return std::malloc(MIN_POOLED_SIZE << c);
+}
+
+void * PoolAllocator::reallocate(void *ptr, size_t old_size, size_t new_size) noexcept {
+	if (old_size > MAX_POOLED_SIZE && new_size > MAX_POOLED_SIZE) {
+		return std::realloc(ptr, new_size);
+	}
+	if (old_size <= MAX_POOLED_SIZE && new_size <= MAX_POOLED_SIZE && size_class(old_size) == size_class(new_size)) {
+		return ptr;
+	}
+	void *ret;
+	if ((ret = this->allocate(new_size))) {
+		std::memcpy(ret, ptr, std::min(old_size, new_size));
+		this->deallocate(ptr, old_size);
+	}
+	return ret;
+}
+
+void PoolAllocator::deallocate(void *ptr, size_t size) noexcept {
+	if (!ptr) {
+		return;
+	}
+	++pool.stats.deallocations;
+	if (size <= MAX_POOLED_SIZE) {
+		unsigned c = size_class(size);
+		size_t class_size = MIN_POOLED_SIZE << c;
+		if (pool.cached[c] + class_size <= CACHE_LIMIT) {
+			auto block = static_cast<FreeBlock *>(ptr);
+			block->next = pool.heads[c], pool.heads[c] = block;
+			pool.cached[c] += class_size, pool.stats.cached_bytes += class_size;
+			return;
+		}
+	}
+	std::free(ptr);
+}
+
+auto PoolAllocator::stats() noexcept -> const Stats & {
+	return pool.stats;
+}
+
+void PoolAllocator::trim() noexcept {
+	pool.trim();
+}
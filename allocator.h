@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+#include "arena.h"
+#include "compiler.h"
+
+
+/**
+ * @brief A BasicBuffer allocation policy that recycles blocks through thread-local free lists.
+ *
+ * Requests of up to @ref MAX_POOLED_SIZE bytes are rounded up to a power of two (but no less than @ref MIN_POOLED_SIZE),
+ * and freed blocks are cached on the freeing thread's list for their size class, so a buffer that is repeatedly filled and
+ * released settles into reusing the same few blocks. Resizing within a size class never moves the data.
+ * Larger requests go straight to \c malloc.
+ */
+struct PoolAllocator {
+
+	static constexpr size_t MIN_POOLED_SIZE = 64, MAX_POOLED_SIZE = 1 << 20;
+
+	struct Stats {
+		size_t allocations;
+		size_t pool_hits;
+		size_t deallocations;
+		size_t cached_bytes;
+	};
+
+	_nodiscard void * allocate(size_t size) noexcept;
+	_nodiscard void * reallocate(void *ptr, size_t old_size, size_t new_size) noexcept;
+	void deallocate(void *ptr, size_t size) noexcept;
+
+	// returns the counters of the calling thread
+	static const Stats & stats() noexcept;
+
+	// releases all blocks cached by the calling thread
+	static void trim() noexcept;
+
+};
+
+
+/**
+ * @brief A BasicBuffer allocation policy that carves blocks out of an @ref Arena.
+ *
+ * Memory is reclaimed when the arena is cleared. Until then, only the most recent allocation can be grown in place or returned.
+ */
+class ArenaAllocator {
+
+private:
+	Arena *arena;
+
+public:
+	explicit ArenaAllocator(Arena &arena) noexcept : arena(&arena) { }
+
+public:
+	_nodiscard void * allocate(size_t size) { return arena->allocate(size); }
+	_nodiscard void * reallocate(void *ptr, size_t old_size, size_t new_size) { return arena->reallocate(ptr, old_size, new_size); }
+	void deallocate(void *ptr, size_t size) noexcept { arena->deallocate(ptr, size); }
+
+};
@@ -0,0 +1,45 @@
+#include "arena.h"
+
+#include <algorithm>
+
+#include "memory.h"
+
+
+void Arena::clear() noexcept {
+	if (blocks.empty()) {
+		return;
+	}
+	auto largest = std::max_element(blocks.begin(), blocks.end(), [](const Block &lhs, const Block &rhs) { return lhs.size < rhs.size; });
+	if (largest != blocks.begin()) {
+		std::swap(*largest, blocks.front());
+	}
+	blocks.erase(blocks.begin() + 1, blocks.end());
+	eptr = (ptr = blocks.front().data.get()) + blocks.front().size;
+}
+
+size_t Arena::capacity() const noexcept {
+	size_t ret = 0;
+	for (auto &block : blocks) {
+		ret += block.size;
+	}
+	return ret;
+}
+
+void * Arena::allocate_block(size_t n, size_t align) {
+	if (n > SIZE_MAX - align) {
+		throw std::bad_alloc();
+	}
+	size_t size = n + align - 1;
+	if (size > block_size / 4) {
+		// give oversized allocations their own block so as not to waste the tail of the current block
+		blocks.reserve(blocks.size() + 1);
+		auto data = make_buffer(size);
+		auto p = reinterpret_cast<uintptr_t>(data.get()) + (align - 1) & ~(align - 1);
+		blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, { std::move(data), size });
+		return reinterpret_cast<void *>(p);
+	}
+	blocks.reserve(blocks.size() + 1);
+	blocks.push_back({ make_buffer(block_size), block_size });
+	eptr = (ptr = blocks.back().data.get()) + block_size;
+	return this->allocate(n, align);
+}
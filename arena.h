@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "compiler.h"
+
+
+class Arena {
+
+private:
+	struct Block {
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+	};
+
+private:
+	std::vector<Block> blocks;
+	uint8_t *ptr, *eptr;
+	size_t block_size;
+
+public:
+	explicit Arena(size_t block_size = 1 << 16) noexcept : ptr(), eptr(), block_size(block_size) { }
+	Arena(Arena &&move) noexcept : blocks(std::move(move.blocks)), ptr(move.ptr), eptr(move.eptr), block_size(move.block_size) { move.eptr = move.ptr = nullptr; }
+	Arena & operator = (Arena &&move) noexcept { return this->swap(move), *this; }
+	void swap(Arena &other) noexcept { using std::swap; swap(blocks, other.blocks), swap(ptr, other.ptr), swap(eptr, other.eptr), swap(block_size, other.block_size); }
+	friend void swap(Arena &lhs, Arena &rhs) noexcept { lhs.swap(rhs); }
+
+private:
+	Arena(const Arena &) = delete;
+	Arena & operator = (const Arena &) = delete;
+
+public:
+	void * allocate(size_t n, size_t align = alignof(std::max_align_t)) {
+		auto p = reinterpret_cast<uintptr_t>(ptr) + (align - 1) & ~(align - 1);
+		if (p > reinterpret_cast<uintptr_t>(eptr) || n > reinterpret_cast<uintptr_t>(eptr) - p) {
+			return this->allocate_block(n, align);
+		}
+		ptr = reinterpret_cast<uint8_t *>(p + n);
+		return reinterpret_cast<void *>(p);
+	}
+
+	// resizes an allocation, in place if it was the most recent one and there is room to grow it
+	void * reallocate(void *p, size_t old_size, size_t new_size, size_t align = alignof(std::max_align_t)) {
+		if (static_cast<uint8_t *>(p) + old_size == ptr && (new_size <= old_size || new_size - old_size <= static_cast<size_t>(eptr - ptr))) {
+			ptr = static_cast<uint8_t *>(p) + new_size;
+			return p;
+		}
+		void *ret = this->allocate(new_size, align);
+		std::memcpy(ret, p, std::min(old_size, new_size));
+		return ret;
+	}
+
+	// returns the most recent allocation to the arena; any other allocation is reclaimed only by clear
+	void deallocate(void *p, size_t size) noexcept {
+		if (static_cast<uint8_t *>(p) + size == ptr) {
+			ptr = static_cast<uint8_t *>(p);
+		}
+	}
+
+	template <typename T>
+	T * allocate_array(size_t n) {
+		static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+		if (n > SIZE_MAX / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T *>(this->allocate(n * sizeof(T), alignof(T)));
+	}
+
+	template <typename T, typename... Args>
+	T * create(Args&&... args) {
+		static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+		return new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// copies the string and a terminating NUL into the arena
+	std::string_view copy(std::string_view sv) {
+		auto str = static_cast<char *>(this->allocate(sv.size() + 1, 1));
+		std::memcpy(str, sv.data(), sv.size()), str[sv.size()] = '\0';
+		return { str, sv.size() };
+	}
+
+	// releases all allocations at once, retaining the largest block for reuse
+	void clear() noexcept;
+
+	size_t _pure capacity() const noexcept;
+
+private:
+	void * allocate_block(size_t n, size_t align);
+
+};
@@ -0,0 +1,119 @@
+#include "async.h"
+
+#include <algorithm>
+
+
+AsyncStream::AsyncStream(FileDescriptor &&fd, Selector &selector, size_t high_water, size_t low_water) : fd(std::move(fd)), selector(selector), high_water(high_water), low_water(std::min(low_water, high_water)), armed(Selector::Flags::READABLE), reading(true), congested(), flush_pending(), in_selected() {
+	selector.add(this->fd, this, Selector::Flags::READABLE);
+}
+
+size_t AsyncStream::write(const void *buf, size_t n) {
+	size_t w = 0;
+	if (queue.empty()) {
+		w = fd.write(buf, n);
+	}
+	queue.append_copy(static_cast<const uint8_t *>(buf) + w, n - w);
+	this->enqueued();
+	return n;
+}
+
+size_t AsyncStream::write(const BufferPointer bufs[], size_t count) {
+	size_t w = 0, n = 0;
+	if (queue.empty()) {
+		w = fd.write(bufs, count);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		n += bufs[i].size;
+		if (w < bufs[i].size) {
+			queue.append_copy(static_cast<const uint8_t *>(bufs[i].ptr) + w, bufs[i].size - w);
+			w = 0;
+		}
+		else {
+			w -= bufs[i].size;
+		}
+	}
+	this->enqueued();
+	return n;
+}
+
+void AsyncStream::write(BufferChain &&chain) {
+	if (queue.empty()) {
+		// a failed write throws, as in the other overloads; what the descriptor does not accept is queued below
+		(void) fd.write(chain);
+	}
+	queue.append(std::move(chain));
+	this->enqueued();
+}
+
+bool AsyncStream::flush() {
+	this->drain();
+	if (!queue.empty()) {
+		flush_pending = true;
+		if (!in_selected) {
+			this->arm();
+		}
+		return true;
+	}
+	fd.flush();
+	return true;
+}
+
+void AsyncStream::set_reading(bool reading) {
+	this->reading = reading;
+	if (!in_selected) {
+		this->arm();
+	}
+}
+
+void AsyncStream::selected(Selector &, Selector::Flags flags) noexcept {
+	// the registration is one-shot, so it is disarmed now that it has fired
+	armed = Selector::Flags::NONE;
+	in_selected = true;
+	try {
+		if ((flags & Selector::Flags::WRITABLE) != Selector::Flags::NONE) {
+			this->drain();
+		}
+		if ((flags & Selector::Flags::READABLE) != Selector::Flags::NONE && reading) {
+			this->readable();
+		}
+		in_selected = false;
+		this->arm();
+	}
+	catch (...) {
+		in_selected = false;
+		this->failed(std::current_exception());
+	}
+}
+
+void AsyncStream::enqueued() {
+	if (queue.empty()) {
+		return;
+	}
+	if (queue.size() >= high_water) {
+		congested = true;
+	}
+	if (!in_selected) {
+		this->arm();
+	}
+}
+
+void AsyncStream::drain() {
+	while (!queue.empty() && fd.write(queue) > 0) {
+	}
+	if (queue.empty() && flush_pending) {
+		flush_pending = false;
+		fd.flush();
+	}
+	if (congested && queue.size() <= low_water) {
+		congested = false;
+		this->drained();
+	}
+}
+
+void AsyncStream::arm() {
+	auto flags = (reading ? Selector::Flags::READABLE : Selector::Flags::NONE) | (queue.empty() ? Selector::Flags::NONE : Selector::Flags::WRITABLE);
+	if (flags != armed) {
+		selector.modify(fd, this, flags);
+		armed = flags;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <exception>
+
+#include "fd.h"
+#include "iobuf.h"
+#include "selector.h"
+
+
+/**
+ * @brief A non-blocking stream driven by a @ref Selector.
+ *
+ * Writes never block and never fail for want of buffer space: whatever the descriptor does not accept immediately
+ * is queued and drained when the selector reports the descriptor writable, so protocol code can encode a message
+ * exactly once and move on.
+ *
+ * When the write queue grows to the high-water mark, @ref is_congested becomes \c true, signalling the producer to stop;
+ * once the queue drains to the low-water mark, @ref drained is called. A stream that produces output in response to its
+ * input, such as a proxy, should stop reading while congested (see @ref set_reading), so that a peer that sends faster
+ * than it receives cannot make the queue grow without bound.
+ *
+ * All member functions must be called on the thread that pumps the selector.
+ */
+class AsyncStream : public Selectable, public Sink {
+
+protected:
+	FileDescriptor fd;
+	Selector &selector;
+
+private:
+	BufferChain queue;
+	const size_t high_water, low_water;
+	Selector::Flags armed;
+	bool reading, congested, flush_pending, in_selected;
+
+public:
+	/**
+	 * @param[in] fd A non-blocking descriptor, which is added to \p selector and removed from it by closing it when this object is destroyed.
+	 */
+	AsyncStream(FileDescriptor &&fd, Selector &selector, size_t high_water = 1 << 20, size_t low_water = 1 << 16);
+
+public:
+	using Sink::write;
+	_nodiscard size_t write(const void *buf, size_t n) override;
+	_nodiscard size_t write(const BufferPointer bufs[], size_t count) override;
+
+	// queues the chain without copying it
+	void write(BufferChain &&chain);
+
+	/**
+	 * @brief Tries to drain the write queue and flushes the descriptor once it is empty.
+	 *
+	 * Like a write, a flush is never refused: if the queue does not drain now, the descriptor is flushed when it does.
+	 * So this always returns \c true, and @ref Sink::flush_fully may be used; @ref queued tells whether it has drained.
+	 */
+	bool flush() override;
+
+	size_t _pure queued() const noexcept { return queue.size(); }
+	bool _pure is_congested() const noexcept { return congested; }
+
+	// stops or resumes calling readable
+	void set_reading(bool reading);
+
+protected:
+	void selected(Selector &selector, Selector::Flags flags) noexcept override;
+
+	/**
+	 * @brief Called when the descriptor is readable.
+	 *
+	 * The descriptor is level-triggered, so an implementation need not read until it would block.
+	 */
+	virtual void readable() = 0;
+
+	// called when the write queue has drained to the low-water mark after having reached the high-water mark
+	virtual void drained() { }
+
+	/**
+	 * @brief Called when writing to the descriptor or a callback has thrown.
+	 *
+	 * The stream is no longer armed in the selector. Typically an implementation will destroy the stream.
+	 */
+	virtual void failed(std::exception_ptr exception) noexcept = 0;
+
+private:
+	void enqueued();
+	void drain();
+	void arm();
+
+};
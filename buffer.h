@@ -4,6 +4,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <new>
+#include <utility>
 
 #include "compiler.h"
 
@@ -29,18 +30,37 @@ struct BasicStaticBuffer {
 using StaticBuffer = BasicStaticBuffer<uint8_t>;
 
 
-template <typename T>
-struct BasicBuffer : BasicStaticBuffer<T> {
+// the default allocation policy of BasicBuffer
+struct MallocAllocator {
+	void * allocate(size_t size) noexcept { return std::malloc(size); }
+	void * reallocate(void *ptr, size_t, size_t new_size) noexcept { return std::realloc(ptr, new_size); }
+	void deallocate(void *ptr, size_t) noexcept { std::free(ptr); }
+};
+
+
+template <typename T, typename Allocator = MallocAllocator>
+struct BasicBuffer : BasicStaticBuffer<T>, private Allocator {
 	BasicBuffer() noexcept = default;
-	explicit BasicBuffer(size_t size) : BasicStaticBuffer<T>(static_cast<T *>(size == 0 ? nullptr : sizeof(T) == 1 ? std::malloc(size) : reallocarray(nullptr, size, sizeof(T))), size) { if (!this->bptr && size) throw std::bad_alloc(); }
-	BasicBuffer(BasicBuffer &&move) noexcept : BasicStaticBuffer<T>(std::move(move)) { move.eptr = move.pptr = move.gptr = move.bptr = nullptr; }
+	explicit BasicBuffer(const Allocator &allocator) noexcept : Allocator(allocator) { }
+	explicit BasicBuffer(size_t size, const Allocator &allocator = Allocator()) : BasicStaticBuffer<T>(), Allocator(allocator) { if (size) this->resize(size); }
+	BasicBuffer(BasicBuffer &&move) noexcept : BasicStaticBuffer<T>(std::move(move)), Allocator(std::move(move)) { move.eptr = move.pptr = move.gptr = move.bptr = nullptr; }
 	BasicBuffer & operator = (BasicBuffer &&move) noexcept { return this->swap(move), *this; }
-	~BasicBuffer() noexcept { std::free(this->bptr); }
-	void swap(BasicBuffer &other) noexcept { using std::swap; swap(this->bptr, other.bptr), swap(this->gptr, other.gptr), swap(this->pptr, other.pptr), swap(this->eptr, other.eptr); }
+	~BasicBuffer() noexcept { if (this->bptr) this->deallocate(this->bptr, this->size() * sizeof(T)); }
+	void swap(BasicBuffer &other) noexcept { using std::swap; swap(this->bptr, other.bptr), swap(this->gptr, other.gptr), swap(this->pptr, other.pptr), swap(this->eptr, other.eptr), swap(static_cast<Allocator &>(*this), static_cast<Allocator &>(other)); }
 	friend void swap(BasicBuffer &lhs, BasicBuffer &rhs) noexcept { lhs.swap(rhs); }
+	const Allocator & _pure get_allocator() const noexcept { return *this; }
 	void resize(size_t size) {
-		T *new_bptr = static_cast<T *>(sizeof(T) == 1 ? std::realloc(this->bptr, size) : reallocarray(this->bptr, size, sizeof(T)));
-		if (!new_bptr && size) {
+		if (size > SIZE_MAX / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		T *new_bptr;
+		if (size == 0) {
+			if (this->bptr) {
+				this->deallocate(this->bptr, this->size() * sizeof(T));
+			}
+			new_bptr = nullptr;
+		}
+		else if (!(new_bptr = static_cast<T *>(this->bptr ? this->reallocate(this->bptr, this->size() * sizeof(T), size * sizeof(T)) : this->allocate(size * sizeof(T))))) {
 			throw std::bad_alloc();
 		}
 		size_t gpos = this->gpos(), ppos = this->ppos();
@@ -64,11 +84,6 @@ struct BasicBuffer : BasicStaticBuffer<T> {
 private:
 	BasicBuffer(const BasicBuffer &) = delete;
 	BasicBuffer & operator = (const BasicBuffer &) = delete;
-#if !__GLIBC__ || !__GLIBC_PREREQ(2, 26)
-	static inline void * reallocarray(void *ptr, size_t nmemb, size_t size) noexcept {
-		return size == 0 || nmemb <= SIZE_MAX / size ? std::realloc(ptr, nmemb * size) : nullptr;
-	}
-#endif
 };
 
 using Buffer = BasicBuffer<uint8_t>;
@@ -0,0 +1,248 @@
+#include "combining.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+
+static std::atomic<uint64_t> next_id(1);
+
+
+CombiningSink::CombiningSink(Sink &sink, Ordering ordering, size_t max_pending) : sink(sink), ordering(ordering), max_pending(max_pending), id(next_id.fetch_add(1, std::memory_order_relaxed)), pending(), signalled(), records(), flush_requested(), flush_completed(), stopping() {
+	thread = std::thread(std::mem_fn(&CombiningSink::run), this);
+}
+
+CombiningSink::~CombiningSink() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	flusher_condition.notify_one();
+	thread.join();
+	// only if the flusher died of an exception can records remain
+	for (Record *record = records.load(std::memory_order_acquire), *next; record; record = next) {
+		next = record->next;
+		::operator delete(record);
+	}
+}
+
+size_t CombiningSink::write(const void *buf, size_t n) {
+	BufferPointer bufs[] = { { buf, n } };
+	return this->write(bufs, 1);
+}
+
+size_t CombiningSink::write(const BufferPointer bufs[], size_t count) {
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i) {
+		n += bufs[i].size;
+	}
+	if (n == 0) {
+		return 0;
+	}
+	if (pending.load(std::memory_order_relaxed) >= max_pending) {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (pending.load(std::memory_order_relaxed) >= max_pending && !exception) {
+			producer_condition.wait(lock);
+		}
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+	// count the record before staging it so that the flusher never subtracts it first
+	pending.fetch_add(n, std::memory_order_relaxed);
+	if (ordering == Ordering::PER_PRODUCER) {
+		auto &producer = this->producer();
+		std::lock_guard<std::mutex> lock(producer.mutex);
+		// stage all the buffers under one lock, lest the flusher take a part of the record
+		size_t pos = producer.staging.size();
+		producer.staging.resize(pos + n);
+		for (size_t i = 0; i < count; ++i) {
+			std::memcpy(producer.staging.data() + pos, bufs[i].ptr, bufs[i].size);
+			pos += bufs[i].size;
+		}
+	}
+	else {
+		auto record = static_cast<Record *>(::operator new(sizeof(Record) + n));
+		record->size = n;
+		for (size_t i = 0, pos = 0; i < count; ++i) {
+			std::memcpy(record->data() + pos, bufs[i].ptr, bufs[i].size);
+			pos += bufs[i].size;
+		}
+		record->next = records.load(std::memory_order_relaxed);
+		while (!records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+	this->signal();
+	return n;
+}
+
+bool CombiningSink::flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	unsigned ticket = ++flush_requested;
+	flusher_condition.notify_one();
+	while (static_cast<int>(flush_completed - ticket) < 0 && !exception) {
+		producer_condition.wait(lock);
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+	return true;
+}
+
+auto CombiningSink::producer() -> Producer & {
+	// the producers of this thread, by the ids of their sinks, which learn when the thread exits so that they can reclaim them
+	static thread_local struct Registry {
+		std::vector<std::pair<uint64_t, std::shared_ptr<Producer>>> entries;
+		~Registry() {
+			for (auto &entry : entries) {
+				entry.second->exited.store(true, std::memory_order_release);
+			}
+		}
+	} registry;
+	auto &entries = registry.entries;
+	if (!entries.empty() && entries.back().first == id) {
+		return *entries.back().second;
+	}
+	auto itr = std::find_if(entries.begin(), entries.end(), [this](auto &entry) { return entry.first == id; });
+	if (itr == entries.end()) {
+		// forget the producers of sinks that have been destroyed
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [](auto &entry) { return entry.second.use_count() == 1; }), entries.end());
+		auto producer = std::make_shared<Producer>();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			producers.push_back(producer);
+		}
+		entries.emplace_back(id, std::move(producer));
+	}
+	else {
+		// keep the most recently used producer at the back, where the next write looks first
+		std::rotate(itr, itr + 1, entries.end());
+	}
+	return *entries.back().second;
+}
+
+void CombiningSink::signal() {
+	// the flusher clears the flag before gathering, so only the first record staged per gathering need wake it
+	if (!signalled.exchange(true)) {
+		std::lock_guard<std::mutex> lock(mutex);
+		flusher_condition.notify_one();
+	}
+}
+
+void CombiningSink::run() noexcept {
+	try {
+		std::vector<Producer *> snapshot;
+		std::vector<std::vector<uint8_t>> spares;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			while (!signalled.load() && flush_completed == flush_requested && !stopping) {
+				flusher_condition.wait(lock);
+			}
+			unsigned ticket = flush_requested;
+			bool stop = stopping;
+			// clear the flag before gathering, so that a record staged by a producer that is missing from the snapshot signals again
+			signalled.store(false);
+			if (ordering == Ordering::PER_PRODUCER) {
+				snapshot.clear();
+				for (auto &producer : producers) {
+					snapshot.push_back(producer.get());
+				}
+			}
+			lock.unlock();
+			size_t w = ordering == Ordering::PER_PRODUCER ? this->write_staging(snapshot, spares) : this->write_records();
+			if (ticket != flush_completed) {
+				sink.flush_fully();
+			}
+			lock.lock();
+			if (w > 0) {
+				pending.fetch_sub(w, std::memory_order_relaxed);
+			}
+			if (ordering == Ordering::PER_PRODUCER) {
+				this->reclaim_producers();
+			}
+			flush_completed = ticket;
+			producer_condition.notify_all();
+			if (stop) {
+				return;
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		exception = std::current_exception();
+		producer_condition.notify_all();
+	}
+}
+
+size_t CombiningSink::write_records() {
+	Record *head = nullptr;
+	for (Record *record = records.exchange(nullptr, std::memory_order_acquire), *next; record; record = next) {
+		next = record->next, record->next = head, head = record;
+	}
+	size_t total = 0;
+	try {
+		// gathers in batches as small as those of Sink::write(BufferChain &), to keep the flusher's stack small
+		BufferPointer bufs[64];
+		size_t count = 0;
+		for (Record *record = head; record; record = record->next) {
+			bufs[count++] = { record->data(), record->size };
+			total += record->size;
+			if (count == std::size(bufs) || !record->next) {
+				sink.write_fully(bufs, count);
+				count = 0;
+			}
+		}
+	}
+	catch (...) {
+		for (Record *next; head; head = next) {
+			next = head->next;
+			::operator delete(head);
+		}
+		throw;
+	}
+	for (Record *next; head; head = next) {
+		next = head->next;
+		::operator delete(head);
+	}
+	return total;
+}
+
+size_t CombiningSink::write_staging(std::vector<Producer *> &snapshot, std::vector<std::vector<uint8_t>> &spares) {
+	if (spares.size() < snapshot.size()) {
+		spares.resize(snapshot.size());
+	}
+	BufferPointer bufs[64];
+	size_t count = 0, total = 0;
+	for (size_t i = 0; i < snapshot.size(); ++i) {
+		{
+			std::lock_guard<std::mutex> lock(snapshot[i]->mutex);
+			// swapping hands the producer an empty buffer that retains the capacity of the one it had last time
+			snapshot[i]->staging.swap(spares[i]);
+		}
+		if (!spares[i].empty()) {
+			bufs[count++] = { spares[i].data(), spares[i].size() };
+			total += spares[i].size();
+		}
+		if (count > 0 && (count == std::size(bufs) || i + 1 == snapshot.size())) {
+			sink.write_fully(bufs, count);
+			count = 0;
+		}
+	}
+	for (auto &spare : spares) {
+		spare.clear();
+	}
+	return total;
+}
+
+void CombiningSink::reclaim_producers() {
+	producers.erase(std::remove_if(producers.begin(), producers.end(), [](auto &producer) {
+		if (!producer->exited.load(std::memory_order_acquire)) {
+			return false;
+		}
+		// the thread can stage no more, but what it staged before exiting may have missed this gathering
+		std::lock_guard<std::mutex> lock(producer->mutex);
+		return producer->staging.empty();
+	}), producers.end());
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "io.h"
+
+
+/**
+ * @brief A sink to which many threads may write concurrently, whose records a single flusher thread combines into large gathering writes.
+ *
+ * Each call of \ref write appends one record, which is written downstream contiguously, never interleaved with other records.
+ * A gathering write is one record, so a header and its payload stay together; a \ref BufferChain is one record per batch
+ * of slices that Sink::write(BufferChain &) gathers.
+ * \ref write returns as soon as the record is staged, unless \c max_pending bytes are already awaiting the flusher.
+ * \ref flush waits until every record staged before the call has been written and the downstream sink has been flushed.
+ * Exceptions thrown by the downstream sink are rethrown by the next \ref flush or by the next \ref write that has to wait for the flusher.
+ * Records staged before destruction are written.
+ */
+class CombiningSink : public Sink {
+
+public:
+	enum class Ordering {
+		/**
+		 * @brief Records from any one thread are written in the order that thread wrote them.
+		 *
+		 * Each thread stages its records contiguously in its own buffer, so this ordering needs the fewest I/O vectors.
+		 */
+		PER_PRODUCER,
+		/**
+		 * @brief Records from all threads are written in one global sequence, consistent with the order in which their writes returned.
+		 */
+		GLOBAL,
+	};
+
+private:
+	struct Producer {
+		std::mutex mutex;
+		std::vector<uint8_t> staging; // guarded by mutex
+		std::atomic<bool> exited { false }; // set when the producing thread exits, after which only the flusher touches staging
+	};
+
+	struct Record {
+		Record *next;
+		size_t size;
+		uint8_t * data() noexcept { return reinterpret_cast<uint8_t *>(this + 1); }
+	};
+
+private:
+	Sink &sink;
+	const Ordering ordering;
+	const size_t max_pending;
+	const uint64_t id;
+	std::atomic<size_t> pending;
+	std::atomic<bool> signalled;
+	std::atomic<Record *> records; // a stack of records in reverse order of staging
+	std::mutex mutex;
+	std::condition_variable flusher_condition, producer_condition;
+	std::vector<std::shared_ptr<Producer>> producers; // guarded by mutex; each is shared with its thread until it exits
+	unsigned flush_requested, flush_completed; // guarded by mutex
+	bool stopping; // guarded by mutex
+	std::exception_ptr exception; // guarded by mutex
+	std::thread thread;
+
+public:
+	explicit CombiningSink(Sink &sink, Ordering ordering = Ordering::PER_PRODUCER, size_t max_pending = 1 << 24);
+	~CombiningSink() override;
+
+public:
+	using Sink::write;
+	_nodiscard size_t write(const void *buf, size_t n) override;
+	_nodiscard size_t write(const BufferPointer bufs[], size_t count) override;
+	bool flush() override;
+
+private:
+	CombiningSink(const CombiningSink &) = delete;
+	CombiningSink & operator = (const CombiningSink &) = delete;
+
+private:
+	Producer & producer();
+	void signal();
+	void run() noexcept;
+	size_t write_records();
+	size_t write_staging(std::vector<Producer *> &snapshot, std::vector<std::vector<uint8_t>> &spares);
+	void reclaim_producers();
+
+};
@@ -53,6 +53,7 @@
 #define _hidden __attribute__ ((__visibility__ ("hidden")))
 #define _nonnull(...) __attribute__ ((__nonnull__ (__VA_ARGS__)))
 #define _pure __attribute__ ((__pure__))
+#define _target(...) __attribute__ ((__target__ (__VA_ARGS__)))
 #define _visible __attribute__ ((__visibility__ ("default")))
 #define _weak __attribute__ ((__weak__))
 #define _weakref(...) __attribute__ ((__weakref__ (__VA_ARGS__)))
@@ -120,6 +121,7 @@ static constexpr unsigned __int128 _const bswap(unsigned __int128 v) noexcept {
 #define _hidden
 #define _nonnull(...)
 #define _pure
+#define _target(...)
 #define _visible
 
 #define _restrict
@@ -0,0 +1,305 @@
+#include "decimal.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#include "muldiv.h"
+
+
+static constexpr uint64_t POW10[] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+	10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000, 1000000000000000,
+	10000000000000000, 100000000000000000, 1000000000000000000, 10000000000000000000u,
+};
+
+static constexpr uint64_t _const magnitude(int64_t n) noexcept {
+	return n < 0 ? 0 - static_cast<uint64_t>(n) : n;
+}
+
+_noreturn static void overflow() {
+	throw std::out_of_range("decimal overflow");
+}
+
+static int64_t upscale(int64_t mantissa, unsigned digits) {
+	int64_t product;
+	if (digits > Decimal::MAX_SCALE || __builtin_mul_overflow(mantissa, static_cast<int64_t>(POW10[digits]), &product)) {
+		overflow();
+	}
+	return product;
+}
+
+// a mantissa scaled by at most 10^18 fits in 128 bits, as do sums and differences of two such
+static __int128 _const widen(int64_t mantissa, unsigned digits) noexcept {
+	return static_cast<__int128>(mantissa) * static_cast<int64_t>(POW10[digits]);
+}
+
+static int64_t narrow(__int128 mantissa) {
+	if (mantissa > INT64_MAX || mantissa < INT64_MIN) {
+		overflow();
+	}
+	return static_cast<int64_t>(mantissa);
+}
+
+// returns how twice the magnitude of a remainder compares to the magnitude of its divisor, i.e., how the remainder compares to half
+static int _const compare_half(int64_t remainder, int64_t divisor) noexcept {
+	uint64_t twice = magnitude(remainder) * 2, half = magnitude(divisor);
+	return (twice > half) - (twice < half);
+}
+
+// adjusts a quotient that was truncated toward zero, given the sign of the exact quotient and how its remainder compares to half
+static int64_t round_quotient(int64_t quotient, bool negative, bool inexact, int half, Decimal::Rounding rounding) {
+	if (!inexact) {
+		return quotient;
+	}
+	bool away;
+	switch (rounding) {
+		case Decimal::Rounding::TRUNCATE:
+			return quotient;
+		case Decimal::Rounding::FLOOR:
+			away = negative;
+			break;
+		case Decimal::Rounding::CEILING:
+			away = !negative;
+			break;
+		case Decimal::Rounding::HALF_UP:
+			away = half >= 0;
+			break;
+		default:
+			away = half > 0 || half == 0 && quotient & 1;
+			break;
+	}
+	if (away && __builtin_add_overflow(quotient, negative ? -1 : 1, &quotient)) {
+		overflow();
+	}
+	return quotient;
+}
+
+// returns the quotient and remainder of multiplicand × multiplier ÷ divisor
+static std::pair<int64_t, int64_t> checked_muldiv(int64_t multiplicand, int64_t multiplier, int64_t divisor) {
+	// the division faults if the quotient overflows, so the double-width product is checked against the divisor first
+	__int128 product = static_cast<__int128>(multiplicand) * multiplier;
+	unsigned __int128 product_magnitude = product < 0 ? -static_cast<unsigned __int128>(product) : product;
+	// a negative quotient may be one greater in magnitude
+	bool negative = (product < 0) != (divisor < 0);
+	if (product_magnitude >= (static_cast<unsigned __int128>(magnitude(divisor)) << 63) + (negative ? magnitude(divisor) : 0)) {
+		overflow();
+	}
+	return muldiv(multiplicand, multiplier, divisor);
+}
+
+// returns multiplicand × multiplier ÷ divisor, rounded as given
+static int64_t quotient(int64_t multiplicand, int64_t multiplier, int64_t divisor, Decimal::Rounding rounding) {
+	auto [q, r] = checked_muldiv(multiplicand, multiplier, divisor);
+	return round_quotient(q, (multiplicand < 0) != (multiplier < 0) != (divisor < 0), r != 0, compare_half(r, divisor), rounding);
+}
+
+
+Decimal::Decimal(int64_t mantissa, unsigned scale) : mantissa_(mantissa), scale_(scale) {
+	if (scale > MAX_SCALE) {
+		throw std::out_of_range("decimal scale out of range");
+	}
+}
+
+Decimal::operator double () const noexcept {
+	// powers of ten up to 10^22 are exact in double, so this rounds only once
+	return static_cast<double>(mantissa_) / static_cast<double>(POW10[scale_]);
+}
+
+Decimal Decimal::rescale(unsigned scale, Rounding rounding) const {
+	if (scale >= scale_) {
+		return { upscale(mantissa_, scale - scale_), scale };
+	}
+	return { ::quotient(mantissa_, 1, static_cast<int64_t>(POW10[scale_ - scale]), rounding), scale };
+}
+
+Decimal Decimal::operator - () const {
+	if (mantissa_ == INT64_MIN) {
+		overflow();
+	}
+	Decimal negation = *this;
+	negation.mantissa_ = -mantissa_;
+	return negation;
+}
+
+Decimal & Decimal::operator += (const Decimal &addend) {
+	unsigned scale = scale_ > addend.scale_ ? scale_ : addend.scale_;
+	mantissa_ = narrow(widen(mantissa_, scale - scale_) + widen(addend.mantissa_, scale - addend.scale_));
+	scale_ = scale;
+	return *this;
+}
+
+Decimal & Decimal::operator -= (const Decimal &subtrahend) {
+	unsigned scale = scale_ > subtrahend.scale_ ? scale_ : subtrahend.scale_;
+	mantissa_ = narrow(widen(mantissa_, scale - scale_) - widen(subtrahend.mantissa_, scale - subtrahend.scale_));
+	scale_ = scale;
+	return *this;
+}
+
+Decimal Decimal::multiply(const Decimal &multiplicand, const Decimal &multiplier, unsigned scale, Rounding rounding) {
+	if (scale > MAX_SCALE) {
+		throw std::out_of_range("decimal scale out of range");
+	}
+	unsigned product_scale = multiplicand.scale_ + multiplier.scale_;
+	if (scale >= product_scale) {
+		return { upscale(::quotient(multiplicand.mantissa_, multiplier.mantissa_, 1, rounding), scale - product_scale), scale };
+	}
+	unsigned drop = product_scale - scale;
+	if (drop <= MAX_SCALE) {
+		return { ::quotient(multiplicand.mantissa_, multiplier.mantissa_, static_cast<int64_t>(POW10[drop]), rounding), scale };
+	}
+	// more digits must be dropped than a 64-bit divisor can; the first division only truncates, but it notes what it drops
+	__int128 product = static_cast<__int128>(multiplicand.mantissa_) * multiplier.mantissa_;
+	auto first_divisor = static_cast<__int128>(POW10[drop - MAX_SCALE]);
+	__int128 partial = product / first_divisor, q = partial / static_cast<int64_t>(POW10[MAX_SCALE]);
+	bool sticky = product % first_divisor != 0;
+	auto r = static_cast<int64_t>(partial % static_cast<int64_t>(POW10[MAX_SCALE]));
+	int half = compare_half(r, static_cast<int64_t>(POW10[MAX_SCALE]));
+	return { round_quotient(narrow(q), product < 0, r != 0 || sticky, half == 0 && sticky ? 1 : half, rounding), scale };
+}
+
+Decimal Decimal::divide(const Decimal &dividend, const Decimal &divisor, unsigned scale, Rounding rounding) {
+	if (scale > MAX_SCALE) {
+		throw std::out_of_range("decimal scale out of range");
+	}
+	if (divisor.mantissa_ == 0) {
+		throw std::domain_error("decimal division by zero");
+	}
+	// the quotient is dividend.mantissa × 10^shift ÷ divisor.mantissa
+	int shift = static_cast<int>(scale + divisor.scale_) - static_cast<int>(dividend.scale_);
+	if (shift < 0) {
+		int64_t scaled_divisor;
+		if (__builtin_mul_overflow(divisor.mantissa_, static_cast<int64_t>(POW10[-shift]), &scaled_divisor)) {
+			// the scaled divisor exceeds the dividend in magnitude, so the quotient truncates to zero
+			auto twice = static_cast<unsigned __int128>(magnitude(dividend.mantissa_)) * 2, half = static_cast<unsigned __int128>(magnitude(divisor.mantissa_)) * POW10[-shift];
+			return { round_quotient(0, (dividend.mantissa_ < 0) != (divisor.mantissa_ < 0), dividend.mantissa_ != 0, (twice > half) - (twice < half), rounding), scale };
+		}
+		return { ::quotient(dividend.mantissa_, 1, scaled_divisor, rounding), scale };
+	}
+	if (shift <= static_cast<int>(MAX_SCALE)) {
+		return { ::quotient(dividend.mantissa_, static_cast<int64_t>(POW10[shift]), divisor.mantissa_, rounding), scale };
+	}
+	// divide in two steps, carrying the remainder of the first into the second
+	auto [q0, r0] = checked_muldiv(dividend.mantissa_, static_cast<int64_t>(POW10[MAX_SCALE]), divisor.mantissa_);
+	auto [q1, r1] = muldiv(r0, static_cast<int64_t>(POW10[shift - MAX_SCALE]), divisor.mantissa_);
+	int64_t q;
+	if (__builtin_add_overflow(upscale(q0, shift - MAX_SCALE), q1, &q)) {
+		overflow();
+	}
+	return { round_quotient(q, (dividend.mantissa_ < 0) != (divisor.mantissa_ < 0), r1 != 0, compare_half(r1, divisor.mantissa_), rounding), scale };
+}
+
+int Decimal::compare(const Decimal &lhs, const Decimal &rhs) noexcept {
+	unsigned scale = lhs.scale_ > rhs.scale_ ? lhs.scale_ : rhs.scale_;
+	__int128 l = widen(lhs.mantissa_, scale - lhs.scale_), r = widen(rhs.mantissa_, scale - rhs.scale_);
+	return (l > r) - (l < r);
+}
+
+
+std::from_chars_result from_chars(const char *first, const char *last, Decimal &value) noexcept {
+	auto is_digit = [last](const char *p) noexcept { return p < last && *p >= '0' && *p <= '9'; };
+	auto p = first;
+	bool negative = p < last && *p == '-';
+	if (!is_digit(p += negative)) {
+		return { first, std::errc::invalid_argument };
+	}
+	// trailing zeros are counted rather than accumulated until a nonzero digit follows them, so they cannot overflow
+	uint64_t mantissa = 0;
+	long zeros = 0, fraction_digits = 0, exponent = 0;
+	bool overflow = false;
+	auto accumulate = [&](char c) noexcept {
+		if (c == '0') {
+			++zeros;
+		}
+		else {
+			if (mantissa != 0 && (zeros >= 19 || __builtin_mul_overflow(mantissa, POW10[zeros + 1], &mantissa))) {
+				overflow = true;
+			}
+			if (__builtin_add_overflow(mantissa, c - '0', &mantissa)) {
+				overflow = true;
+			}
+			zeros = 0;
+		}
+	};
+	if (*p == '0') {
+		++p;
+	}
+	else {
+		do {
+			accumulate(*p++);
+		} while (is_digit(p));
+	}
+	if (p < last && *p == '.' && is_digit(p + 1)) {
+		++p;
+		do {
+			accumulate(*p++);
+			++fraction_digits;
+		} while (is_digit(p));
+	}
+	if (p < last && (*p | 0x20) == 'e') {
+		auto q = p + 1;
+		bool negative_exponent = q < last && *q == '-';
+		if (q < last && (*q == '+' || *q == '-')) {
+			++q;
+		}
+		if (is_digit(q)) {
+			do {
+				if (exponent < 100000) {
+					exponent = exponent * 10 + (*q - '0');
+				}
+			} while (is_digit(++q));
+			if (negative_exponent) {
+				exponent = -exponent;
+			}
+			p = q;
+		}
+	}
+	if (overflow) {
+		return { p, std::errc::result_out_of_range };
+	}
+	// the number is mantissa × 10^shift; prefer the scale of the text if the mantissa can be scaled to it
+	long shift = zeros - fraction_digits + exponent, text_scale = fraction_digits - exponent;
+	long min_scale = shift < 0 ? -shift : 0, max_scale = text_scale < 0 ? 0 : text_scale < long(Decimal::MAX_SCALE) ? text_scale : Decimal::MAX_SCALE;
+	if (mantissa == 0) {
+		value = Decimal(0, static_cast<unsigned>(max_scale));
+		return { p, std::errc() };
+	}
+	if (min_scale > long(Decimal::MAX_SCALE)) {
+		return { p, std::errc::result_out_of_range };
+	}
+	uint64_t limit = static_cast<uint64_t>(INT64_MAX) + negative;
+	for (long scale : { max_scale, min_scale }) {
+		uint64_t scaled;
+		if (scale >= min_scale && shift + scale < 20 && !__builtin_mul_overflow(mantissa, POW10[shift + scale], &scaled) && scaled <= limit) {
+			value = Decimal(static_cast<int64_t>(negative ? 0 - scaled : scaled), static_cast<unsigned>(scale));
+			return { p, std::errc() };
+		}
+	}
+	return { p, std::errc::result_out_of_range };
+}
+
+std::to_chars_result to_chars(char *first, char *last, const Decimal &value) noexcept {
+	char digits[20];
+	size_t n = std::to_chars(digits, digits + sizeof digits, magnitude(value.mantissa())).ptr - digits, scale = value.scale();
+	size_t length = (value.mantissa() < 0) + (n > scale ? n - scale : 1) + (scale ? 1 + scale : 0);
+	if (static_cast<size_t>(last - first) < length) {
+		return { last, std::errc::value_too_large };
+	}
+	if (value.mantissa() < 0) {
+		*first++ = '-';
+	}
+	if (n > scale) {
+		std::memcpy(first, digits, n - scale), first += n - scale;
+	}
+	else {
+		*first++ = '0';
+	}
+	if (scale) {
+		*first++ = '.';
+		if (n < scale) {
+			std::memset(first, '0', scale - n), first += scale - n;
+		}
+		size_t fraction = n < scale ? n : scale;
+		std::memcpy(first, digits + n - fraction, fraction), first += fraction;
+	}
+	return { first, std::errc() };
+}
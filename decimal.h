@@ -0,0 +1,90 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+
+#include "compiler.h"
+
+
+/**
+ * @brief An exact decimal number: a 64-bit mantissa scaled by a power of ten, i.e., mantissa × 10^−scale.
+ *
+ * Prices and quantities parsed from their decimal text keep exactly the value and the number of fractional digits that
+ * the text has, so they can be added, compared, and written back without the rounding of binary floating point.
+ * Operations whose result does not fit throw \c std::out_of_range.
+ */
+class Decimal {
+
+public:
+	static constexpr unsigned MAX_SCALE = 18;
+
+	enum class Rounding {
+		TRUNCATE, // toward zero
+		FLOOR, // toward negative infinity
+		CEILING, // toward positive infinity
+		HALF_UP, // to nearest, ties away from zero
+		HALF_EVEN, // to nearest, ties to even
+	};
+
+private:
+	int64_t mantissa_;
+	unsigned scale_;
+
+public:
+	constexpr Decimal() noexcept : mantissa_(), scale_() { }
+	// throws std::out_of_range if scale exceeds MAX_SCALE
+	Decimal(int64_t mantissa, unsigned scale = 0);
+
+public:
+	int64_t _pure mantissa() const noexcept { return mantissa_; }
+	unsigned _pure scale() const noexcept { return scale_; }
+
+	// the nearest double, which is exact if the mantissa is less than 2^53 in magnitude
+	explicit _pure operator double () const noexcept;
+
+	// returns this number with the given number of fractional digits, rounding as given if digits are dropped
+	Decimal rescale(unsigned scale, Rounding rounding = Rounding::HALF_EVEN) const;
+
+	Decimal operator - () const;
+	Decimal & operator += (const Decimal &addend);
+	Decimal & operator -= (const Decimal &subtrahend);
+
+	// numerical comparisons, e.g., 1.50 == 1.5
+	bool _pure operator == (const Decimal &rhs) const noexcept { return compare(*this, rhs) == 0; }
+	bool _pure operator != (const Decimal &rhs) const noexcept { return compare(*this, rhs) != 0; }
+	bool _pure operator < (const Decimal &rhs) const noexcept { return compare(*this, rhs) < 0; }
+	bool _pure operator <= (const Decimal &rhs) const noexcept { return compare(*this, rhs) <= 0; }
+	bool _pure operator > (const Decimal &rhs) const noexcept { return compare(*this, rhs) > 0; }
+	bool _pure operator >= (const Decimal &rhs) const noexcept { return compare(*this, rhs) >= 0; }
+
+	// returns multiplicand × multiplier with the given number of fractional digits
+	static Decimal multiply(const Decimal &multiplicand, const Decimal &multiplier, unsigned scale, Rounding rounding = Rounding::HALF_EVEN);
+	// returns dividend ÷ divisor with the given number of fractional digits; throws std::domain_error if divisor is zero
+	static Decimal divide(const Decimal &dividend, const Decimal &divisor, unsigned scale, Rounding rounding = Rounding::HALF_EVEN);
+
+private:
+	static int _pure compare(const Decimal &lhs, const Decimal &rhs) noexcept;
+
+};
+
+static inline Decimal operator + (Decimal augend, const Decimal &addend) { return augend += addend; }
+static inline Decimal operator - (Decimal minuend, const Decimal &subtrahend) { return minuend -= subtrahend; }
+
+// the product with the greater scale of the operands, e.g., a price times a quantity
+static inline Decimal operator * (const Decimal &multiplicand, const Decimal &multiplier) {
+	return Decimal::multiply(multiplicand, multiplier, multiplicand.scale() > multiplier.scale() ? multiplicand.scale() : multiplier.scale());
+}
+
+
+/**
+ * @brief Parses a number in the syntax of JSON into a decimal, in the manner of \c std::from_chars.
+ *
+ * The digits are accumulated into the mantissa directly, and the scale is that of the text, e.g., 2 for \c "1.50" and
+ * for \c "150e-2", unless trailing zeros must be dropped for the mantissa to fit.
+ * Sets \c ec to \c std::errc::invalid_argument if there is no number, or to \c std::errc::result_out_of_range if it
+ * cannot be represented exactly.
+ */
+std::from_chars_result from_chars(const char *first, const char *last, Decimal &value) noexcept;
+
+// writes a decimal in plain notation with all of its fractional digits, in the manner of std::to_chars
+std::to_chars_result to_chars(char *first, char *last, const Decimal &value) noexcept;
@@ -0,0 +1,184 @@
+#include "dirwalk.h"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+#include <dirent.h>
+
+#include "memory.h"
+
+
+std::string DirectoryWalker::Entry::path() const {
+	size_t size = name_len;
+	for (auto entry = parent; entry; entry = entry->parent) {
+		size += entry->name_len + 1;
+	}
+	std::string ret(size, '/');
+	for (auto entry = this; entry; entry = entry->parent) {
+		size -= entry->name_len;
+		std::memcpy(&ret[size], entry->name, entry->name_len);
+		--size;
+	}
+	return ret;
+}
+
+
+namespace {
+
+struct Work {
+	std::shared_ptr<const FileDescriptor> parent_fd;
+	const DirectoryWalker::Entry *dir;
+};
+
+struct Walk {
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::vector<Work> stack;
+	unsigned busy = 0;
+	std::exception_ptr exception;
+};
+
+} // namespace
+
+
+static bool _pure is_vanished(const std::system_error &e) noexcept {
+	return e.code() == std::errc::no_such_file_or_directory || e.code() == std::errc::not_a_directory;
+}
+
+static void scan(const Work &work, unsigned mask, uint8_t *buf, size_t buf_size, Arena &arena, std::vector<const DirectoryWalker::Entry *> &entries, std::vector<Work> &found) {
+	std::shared_ptr<const FileDescriptor> fd;
+	try {
+		fd = std::make_shared<const FileDescriptor>(work.parent_fd->openat(work.dir ? work.dir->name : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+	}
+	catch (const std::system_error &e) {
+		if (is_vanished(e)) {
+			return;
+		}
+		throw;
+	}
+	for (size_t n; (n = fd->getdents64(buf, buf_size)) > 0;) {
+		for (size_t pos = 0; pos < n;) {
+			auto dirent = reinterpret_cast<const struct dirent64 *>(buf + pos);
+			pos += dirent->d_reclen;
+			auto name = dirent->d_name;
+			if (name[0] == '.' && (name[1] == '\0' || name[1] == '.' && name[2] == '\0')) {
+				continue;
+			}
+			auto name_sv = arena.copy(name);
+			auto entry = arena.create<DirectoryWalker::Entry>();
+			entry->parent = work.dir;
+			entry->name = name_sv.data();
+			entry->name_len = static_cast<uint16_t>(name_sv.size());
+			entry->ino = dirent->d_ino;
+			entry->size = 0;
+			entry->mtime = { };
+			entry->mode = static_cast<uint16_t>(DTTOIF(dirent->d_type));
+			if (mask != 0 || dirent->d_type == DT_UNKNOWN) {
+				struct statx stx;
+				try {
+					fd->statx(name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mask | STATX_TYPE, &stx);
+				}
+				catch (const std::system_error &e) {
+					if (is_vanished(e)) {
+						continue;
+					}
+					throw;
+				}
+				entry->mode = stx.stx_mode;
+				entry->size = stx.stx_size;
+				entry->mtime = stx.stx_mtime;
+			}
+			entries.push_back(entry);
+			if (entry->is_directory()) {
+				found.push_back({ fd, entry });
+			}
+		}
+	}
+}
+
+static void run(Walk &walk, unsigned mask, size_t batch_size, Arena &arena, std::vector<const DirectoryWalker::Entry *> &entries) noexcept {
+	try {
+		auto buf = make_buffer(batch_size);
+		std::vector<Work> found;
+		std::unique_lock<std::mutex> lock(walk.mutex);
+		for (;;) {
+			while (walk.stack.empty() && walk.busy > 0 && !walk.exception) {
+				walk.condition.wait(lock);
+			}
+			if (walk.stack.empty() || walk.exception) {
+				walk.condition.notify_all();
+				return;
+			}
+			// popping from the back walks depth-first, which bounds the number of directories held open
+			Work work = std::move(walk.stack.back());
+			walk.stack.pop_back();
+			++walk.busy;
+			lock.unlock();
+			scan(work, mask, buf.get(), batch_size, arena, entries, found);
+			work.parent_fd.reset();
+			lock.lock();
+			--walk.busy;
+			for (auto &w : found) {
+				walk.stack.push_back(std::move(w));
+				walk.condition.notify_one();
+			}
+			found.clear();
+			if (walk.stack.empty() && walk.busy == 0) {
+				walk.condition.notify_all();
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(walk.mutex);
+		if (!walk.exception) {
+			walk.exception = std::current_exception();
+		}
+		walk.condition.notify_all();
+	}
+}
+
+auto DirectoryWalker::walk(const FileDescriptor &dir) const -> Listing {
+	Walk walk;
+	walk.stack.push_back({ std::shared_ptr<const FileDescriptor>(&dir, [](const FileDescriptor *) { }), nullptr });
+	std::vector<Arena> arenas(concurrency);
+	std::vector<std::vector<const Entry *>> entries(concurrency);
+	std::vector<std::thread> threads;
+	threads.reserve(concurrency - 1);
+	try {
+		for (unsigned i = 1; i < concurrency; ++i) {
+			threads.emplace_back(run, std::ref(walk), mask, batch_size, std::ref(arenas[i]), std::ref(entries[i]));
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(walk.mutex);
+			walk.exception = std::current_exception();
+			walk.condition.notify_all();
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+		throw;
+	}
+	run(walk, mask, batch_size, arenas[0], entries[0]);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	if (walk.exception) {
+		std::rethrow_exception(walk.exception);
+	}
+	Listing listing;
+	size_t count = 0;
+	for (auto &e : entries) {
+		count += e.size();
+	}
+	listing.entries.reserve(count);
+	for (auto &e : entries) {
+		listing.entries.insert(listing.entries.end(), e.begin(), e.end());
+	}
+	listing.arenas = std::move(arenas);
+	return listing;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "fd.h"
+
+
+class DirectoryWalker {
+
+public:
+	struct Entry {
+		/**
+		 * @brief The directory containing this entry, or \c nullptr if it is directly beneath the root of the walk.
+		 */
+		const Entry *parent;
+		const char *name;
+		uint64_t ino;
+		uint64_t size;
+		struct statx_timestamp mtime;
+		uint16_t mode;
+		uint16_t name_len;
+
+		bool _pure is_directory() const noexcept { return S_ISDIR(mode); }
+		std::string path() const;
+	};
+
+	class Listing {
+		friend DirectoryWalker;
+	public:
+		typedef std::vector<const Entry *>::const_iterator const_iterator;
+	private:
+		std::vector<Arena> arenas;
+		std::vector<const Entry *> entries;
+	public:
+		Listing() = default;
+		Listing(Listing &&) = default;
+		Listing & operator = (Listing &&) = default;
+	public:
+		size_t _pure size() const noexcept { return entries.size(); }
+		bool _pure empty() const noexcept { return entries.empty(); }
+		const Entry & _pure operator [] (size_t i) const noexcept { return *entries[i]; }
+		const_iterator _pure begin() const noexcept { return entries.begin(); }
+		const_iterator _pure end() const noexcept { return entries.end(); }
+	};
+
+private:
+	unsigned mask;
+	unsigned concurrency;
+	size_t batch_size;
+
+public:
+	/**
+	 * @param[in] mask The \c STATX_* fields to fetch for every entry.
+	 * With the default of zero, \c statx is called only for entries whose type \c getdents64 does not report,
+	 * and only \ref Entry::name, \ref Entry::ino, and the file type bits of \ref Entry::mode are valid.
+	 * @param[in] concurrency The number of threads (including the calling thread) among which to spread subtree scanning.
+	 * @param[in] batch_size The size of the buffer passed to each \c getdents64 call.
+	 */
+	explicit DirectoryWalker(unsigned mask = 0, unsigned concurrency = std::thread::hardware_concurrency(), size_t batch_size = 1 << 16) noexcept : mask(mask), concurrency(concurrency == 0 ? 1 : concurrency), batch_size(batch_size) { }
+
+public:
+	/**
+	 * @brief Lists recursively all entries beneath the given directory, not following symbolic links.
+	 *
+	 * Entries are listed in no particular order.
+	 * Entries that vanish during the walk are silently omitted.
+	 */
+	Listing walk(const FileDescriptor &dir) const;
+	Listing walk(const char *path) const { return this->walk(FileDescriptor(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)); }
+
+};
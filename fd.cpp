@@ -7,6 +7,10 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 
 namespace posix {
 
@@ -542,6 +546,32 @@ size_t writev(int fildes, const struct iovec iov[], int iovcnt) {
 	return static_cast<size_t>(ret);
 }
 
+#ifdef __linux__
+
+size_t getdents64(int fd, void *dirp, size_t count) {
+	long ret;
+	if ((ret = ::syscall(SYS_getdents64, fd, dirp, count)) < 0) {
+		throw std::system_error(errno, std::system_category(), "getdents64");
+	}
+	return static_cast<size_t>(ret);
+}
+
+int memfd_create(const char *name, unsigned flags) {
+	int ret;
+	if ((ret = ::memfd_create(name, flags)) < 0) {
+		throw std::system_error(errno, std::system_category(), "memfd_create");
+	}
+	return ret;
+}
+
+void statx(int fd, const char * _restrict path, int flag, unsigned mask, struct statx * _restrict buf) {
+	if (::statx(fd, path, flag, mask, buf) < 0) {
+		throw std::system_error(errno, std::system_category(), "statx");
+	}
+}
+
+#endif // defined(__linux__)
+
 } // namespace posix
 
 
@@ -91,6 +91,12 @@ void utimes(const char *path, const struct timeval times[2]);
 _nodiscard size_t write(int fildes, const void *buf, size_t nbyte);
 _nodiscard size_t writev(int fildes, const struct iovec iov[], int iovcnt);
 
+#ifdef __linux__
+size_t getdents64(int fd, void *dirp, size_t count);
+_nodiscard int memfd_create(const char *name, unsigned flags = MFD_CLOEXEC);
+void statx(int fd, const char * _restrict path, int flag, unsigned mask, struct statx * _restrict buf);
+#endif
+
 static inline unsigned select(int nfds, fd_set * _restrict readfds, fd_set * _restrict writefds, fd_set * _restrict errorfds, std::chrono::microseconds timeout) {
 	struct timeval tv;
 	tv.tv_sec = static_cast<std::time_t>(std::chrono::duration_cast<std::chrono::seconds>(timeout).count());
@@ -214,6 +220,10 @@ public:
 	void fchmodat(const char *path, mode_t mode, int flag = 0) const { posix::fchmodat(fd, path, mode, flag); }
 	void fchownat(const char *path, uid_t owner, gid_t group, int flag = 0) const { posix::fchownat(fd, path, owner, group, flag); }
 	void fstatat(const char * _restrict path, struct stat * _restrict buf, int flag = 0) const { posix::fstatat(fd, path, buf, flag); }
+#ifdef __linux__
+	size_t getdents64(void *dirp, size_t count) const { return posix::getdents64(fd, dirp, count); }
+	void statx(const char * _restrict path, int flag, unsigned mask, struct statx * _restrict buf) const { posix::statx(fd, path, flag, mask, buf); }
+#endif
 	void linkat(const char *path1, const char *path2, int flag = 0) const { posix::linkat(fd, path1, fd, path2, flag); }
 	void mkdirat(const char *path, mode_t mode = 0777) const { posix::mkdirat(fd, path, mode); }
 	void mkfifoat(const char *path, mode_t mode = 0666) const { posix::mkfifoat(fd, path, mode); }
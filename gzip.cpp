@@ -1,95 +1,186 @@
-#include "gzip.h"
+#include "gzip.tcc"
 
-#include <cstring>
+#include <algorithm>
+#include <functional>
 
-#include "narrow.h"
+template class BasicGZipSource<Source>;
+template class BasicGZipSink<Sink>;
 
-using z_avail_t = decltype(z_stream::avail_in);
-static_assert(std::is_same_v<decltype(z_stream::avail_out), z_avail_t>, "");
 
+// deflate cannot refer further back than this, so it is all of the preceding block that a dictionary need hold
+static constexpr size_t GZIP_WINDOW_SIZE = 1 << 15;
 
-GZipSource::GZipSource(Source &source) : source(source) {
-	std::memset(&stream, 0, sizeof stream);
-	stream.next_in = ibuf;
-	if (::inflateInit2(&stream, 16 /* gzip format only */ + 15 /* window bits */) != Z_OK) {
-		throw std::runtime_error(stream.msg);
+ParallelGZipSink::ParallelGZipSink(Sink &sink, int level, unsigned threads, size_t block_size) : sink(sink), level(level), block_size(std::max(block_size, GZIP_WINDOW_SIZE)), max_jobs(2 * static_cast<size_t>(std::max(threads, 1U))), crc(), isize(), in_member(), any_member(), stopping() {
+	current = std::make_unique<Job>();
+	current->input.reserve(this->block_size);
+	try {
+		for (unsigned i = std::max(threads, 1U); i > 0; --i) {
+			workers.emplace_back(std::mem_fn(&ParallelGZipSink::run), this);
+		}
 	}
-}
-
-GZipSource::~GZipSource() {
-	if (::inflateEnd(&stream) != Z_OK) {
-		throw std::runtime_error(stream.msg);
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		worker_condition.notify_all();
+		for (auto &worker : workers) {
+			worker.join();
+		}
+		throw;
 	}
 }
 
-ssize_t GZipSource::read(void *buf, size_t n) {
-	uint8_t *iend = const_cast<uint8_t *>(stream.next_in + stream.avail_in);
-	std::ptrdiff_t d;
-	if ((d = ibuf + sizeof ibuf - iend) > 0) {
-		ssize_t r = source.read(iend, d);
-		if (r > 0) {
-			stream.avail_in += static_cast<z_avail_t>(r);
-		}
-	}
-	stream.next_out = static_cast<uint8_t *>(buf);
-	n = stream.avail_out = saturate<z_avail_t>(n);
-	int error;
-	if ((error = ::inflate(&stream, Z_NO_FLUSH)) != Z_OK && error != Z_STREAM_END) {
-		throw std::ios_base::failure(stream.msg);
+ParallelGZipSink::~ParallelGZipSink() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
 	}
-	if (stream.avail_in == 0) {
-		stream.next_in = ibuf;
+	worker_condition.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
 	}
-	ssize_t r = n - stream.avail_out;
-	return r == 0 ? error == Z_STREAM_END ? -1 : 0 : r;
+	workers.clear();
 }
 
-
-GZipSink::GZipSink(Sink &sink, int level) : sink(sink) {
-	std::memset(&stream, 0, sizeof stream);
-	stream.next_out = obuf;
-	if (::deflateInit2(&stream, level, Z_DEFLATED, 16 /* gzip format */ + 15 /* window bits */, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
-		throw std::runtime_error(stream.msg);
+size_t ParallelGZipSink::write(const void *buf, size_t n) {
+	for (size_t w = 0;;) {
+		size_t c = std::min(n - w, block_size - current->input.size());
+		current->input.insert(current->input.end(), static_cast<const uint8_t *>(buf) + w, static_cast<const uint8_t *>(buf) + w + c);
+		if ((w += c) == n) {
+			return n;
+		}
+		this->submit(false);
 	}
 }
 
-GZipSink::~GZipSink() {
-	if (::deflateEnd(&stream) != Z_OK) {
-		throw std::runtime_error(stream.msg);
+bool ParallelGZipSink::flush() {
+	// an empty stream is still one (empty) member
+	if (in_member || !current->input.empty() || !any_member) {
+		this->submit(true);
+		while (!jobs.empty()) {
+			this->retire(true);
+		}
+		uint8_t trailer[8] = {
+			static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 24),
+			static_cast<uint8_t>(isize), static_cast<uint8_t>(isize >> 8), static_cast<uint8_t>(isize >> 16), static_cast<uint8_t>(isize >> 24)
+		};
+		sink.write_fully(trailer, sizeof trailer);
+		crc = 0, isize = 0, in_member = false;
 	}
+	return sink.flush();
 }
 
-size_t GZipSink::write(const void *buf, size_t n) {
-	this->write(buf, n, Z_NO_FLUSH);
-	return n;
+void ParallelGZipSink::submit(bool last) {
+	if (!in_member) {
+		static const uint8_t header[10] = { 0x1F, 0x8B, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3 /* Unix */ };
+		sink.write_fully(header, sizeof header);
+		in_member = any_member = true;
+	}
+	while (jobs.size() >= max_jobs) {
+		this->retire(true);
+	}
+	std::unique_ptr<Job> next;
+	if (spares.empty()) {
+		next = std::make_unique<Job>();
+		next->input.reserve(block_size);
+	}
+	else {
+		next = std::move(spares.back());
+		spares.pop_back();
+		next->input.clear();
+	}
+	if (last) {
+		next->dictionary.clear();
+	}
+	else {
+		size_t d = std::min(current->input.size(), GZIP_WINDOW_SIZE);
+		next->dictionary.assign(current->input.end() - d, current->input.end());
+	}
+	current->last = last, current->done = false, current->exception = nullptr;
+	Job *job = current.get();
+	jobs.push_back(std::move(current));
+	current = std::move(next);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(job);
+	}
+	worker_condition.notify_one();
+	this->retire(false);
 }
 
-bool GZipSink::flush() {
-	size_t n = 0;
-	return this->write(nullptr, n, Z_FINISH) == Z_STREAM_END && stream.avail_out == 0 && sink.flush();
+void ParallelGZipSink::retire(bool wait) {
+	while (!jobs.empty()) {
+		Job &job = *jobs.front();
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!job.done && !wait) {
+				return;
+			}
+			while (!job.done) {
+				done_condition.wait(lock);
+			}
+		}
+		if (job.exception) {
+			std::rethrow_exception(job.exception);
+		}
+		sink.write_fully(job.output.data(), job.output.size());
+		crc = ::crc32_combine(crc, job.crc, static_cast<z_off_t>(job.input.size()));
+		isize += static_cast<uint32_t>(job.input.size());
+		spares.push_back(std::move(jobs.front()));
+		jobs.pop_front();
+		wait = false;
+	}
 }
 
-int GZipSink::write(const void *buf, size_t &n, int flush) {
-	uint8_t *obegin = stream.next_out;
-	stream.next_out += stream.avail_out;
-	stream.avail_out = static_cast<z_avail_t>(obuf + sizeof obuf - stream.next_out);
-	stream.next_in = static_cast<const uint8_t *>(buf);
-	n = stream.avail_in = saturate<z_avail_t>(n);
-	int error;
-	if ((error = ::deflate(&stream, flush)) != Z_OK && error != Z_STREAM_END) {
-		throw std::ios_base::failure(stream.msg);
-	}
-	n -= stream.avail_in;
-	stream.avail_out = static_cast<z_avail_t>(stream.next_out - obegin);
-	stream.next_out = obegin;
-	if (stream.avail_out > 0) {
-		size_t w = sink.write(stream.next_out, stream.avail_out);
-		if ((stream.avail_out -= static_cast<z_avail_t>(w)) == 0) {
-			stream.next_out = obuf;
+void ParallelGZipSink::run() noexcept {
+	z_stream stream;
+	std::memset(&stream, 0, sizeof stream);
+	int error = ::deflateInit2(&stream, level, Z_DEFLATED, -15 /* raw deflate, window bits */, 9, Z_DEFAULT_STRATEGY);
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		while (queue.empty() && !stopping) {
+			worker_condition.wait(lock);
 		}
-		else {
-			stream.next_out += w;
+		if (stopping) {
+			break;
 		}
+		Job &job = *queue.front();
+		queue.pop_front();
+		lock.unlock();
+		try {
+			if (error != Z_OK) {
+				throw std::runtime_error(stream.msg ? stream.msg : "deflateInit2");
+			}
+			this->deflate(stream, job);
+		}
+		catch (...) {
+			job.exception = std::current_exception();
+		}
+		lock.lock();
+		job.done = true;
+		done_condition.notify_all();
+	}
+	if (error == Z_OK) {
+		::deflateEnd(&stream);
+	}
+}
+
+void ParallelGZipSink::deflate(z_stream &stream, Job &job) {
+	job.crc = ::crc32(0, job.input.data(), static_cast<uInt>(job.input.size()));
+	if (::deflateReset(&stream) != Z_OK || !job.dictionary.empty() && ::deflateSetDictionary(&stream, job.dictionary.data(), static_cast<uInt>(job.dictionary.size())) != Z_OK) {
+		throw std::runtime_error(stream.msg ? stream.msg : "deflateSetDictionary");
+	}
+	// a sync flush ends a block on a byte boundary with an empty stored block, after which the next block's output may simply be appended
+	job.output.resize(::deflateBound(&stream, static_cast<uLong>(job.input.size())) + 16);
+	stream.next_in = job.input.data();
+	stream.avail_in = static_cast<z_avail_t>(job.input.size());
+	stream.next_out = job.output.data();
+	stream.avail_out = static_cast<z_avail_t>(job.output.size());
+	int error = ::deflate(&stream, job.last ? Z_FINISH : Z_SYNC_FLUSH);
+	if (error != (job.last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0) {
+		throw std::ios_base::failure(stream.msg ? stream.msg : "deflate");
 	}
-	return error;
+	job.output.resize(job.output.size() - stream.avail_out);
 }
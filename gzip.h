@@ -1,45 +1,58 @@
 #define ZLIB_CONST
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <zlib.h>
 
 #include "io.h"
 
 
-class GZipSource : public Source {
+// definitions in gzip.tcc; see the note on stream adapters in io.h
+template <typename S = Source>
+class BasicGZipSource : public Source {
 
 private:
-	Source &source;
+	S &source;
 	z_stream stream;
 	uint8_t ibuf[1 << 12];
 
 public:
-	explicit GZipSource(Source &source);
-	~GZipSource();
+	explicit BasicGZipSource(S &source);
+	~BasicGZipSource();
 
 private:
-	GZipSource(const GZipSource &) = delete;
-	GZipSource & operator = (const GZipSource &) = delete;
+	BasicGZipSource(const BasicGZipSource &) = delete;
+	BasicGZipSource & operator = (const BasicGZipSource &) = delete;
 
 public:
 	ssize_t read(void *buf, size_t n) override;
 
 };
 
+using GZipSource = BasicGZipSource<>;
+
 
-class GZipSink : public Sink {
+template <typename K = Sink>
+class BasicGZipSink : public Sink {
 
 private:
-	Sink &sink;
+	K &sink;
 	z_stream stream;
 	uint8_t obuf[1 << 12];
 
 public:
-	explicit GZipSink(Sink &sink, int level = Z_DEFAULT_COMPRESSION);
-	~GZipSink();
+	explicit BasicGZipSink(K &sink, int level = Z_DEFAULT_COMPRESSION);
+	~BasicGZipSink();
 
 private:
-	GZipSink(const GZipSink &) = delete;
-	GZipSink & operator = (const GZipSink &) = delete;
+	BasicGZipSink(const BasicGZipSink &) = delete;
+	BasicGZipSink & operator = (const BasicGZipSink &) = delete;
 
 public:
 	size_t write(const void *buf, size_t n) override;
@@ -49,3 +62,62 @@ private:
 	int write(const void *buf, size_t &n, int flush);
 
 };
+
+using GZipSink = BasicGZipSink<>;
+
+
+/**
+ * @brief Compresses into a sink in the gzip format, deflating blocks of input concurrently on a pool of threads.
+ *
+ * Each block is deflated independently, primed with the final 32 KiB of the preceding block as a dictionary,
+ * so the compression ratio is close to that of @ref GZipSink while throughput scales with the number of threads.
+ * Compressed blocks are written in order from the calling thread, so the sink must be blocking.
+ * @ref flush ends the current gzip member; a subsequent write begins a new one, which any gunzip reads as a continuation.
+ * Data not yet flushed at destruction are discarded.
+ */
+class ParallelGZipSink : public Sink {
+
+private:
+	struct Job {
+		std::vector<uint8_t> input, dictionary, output;
+		uLong crc;
+		bool last, done;
+		std::exception_ptr exception;
+	};
+
+private:
+	Sink &sink;
+	const int level;
+	const size_t block_size;
+	const size_t max_jobs;
+	std::unique_ptr<Job> current;
+	std::deque<std::unique_ptr<Job>> jobs; // submitted, in stream order
+	std::vector<std::unique_ptr<Job>> spares;
+	uLong crc;
+	uint32_t isize;
+	bool in_member, any_member;
+	std::mutex mutex;
+	std::condition_variable worker_condition, done_condition;
+	std::deque<Job *> queue; // guarded by mutex
+	bool stopping; // guarded by mutex
+	std::vector<std::thread> workers;
+
+public:
+	explicit ParallelGZipSink(Sink &sink, int level = Z_DEFAULT_COMPRESSION, unsigned threads = std::thread::hardware_concurrency(), size_t block_size = 1 << 17);
+	~ParallelGZipSink() override;
+
+private:
+	ParallelGZipSink(const ParallelGZipSink &) = delete;
+	ParallelGZipSink & operator = (const ParallelGZipSink &) = delete;
+
+public:
+	size_t write(const void *buf, size_t n) override;
+	bool flush() override;
+
+private:
+	void submit(bool last);
+	void retire(bool wait);
+	void run() noexcept;
+	void deflate(z_stream &stream, Job &job);
+
+};
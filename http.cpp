@@ -6,8 +6,6 @@
 
 #include "memory.h"
 
-#define BITS(l, o) (((size_t(1) << (l)) - 1) << (o))
-
 const char
 		HTTP_REASON_PHRASE_100[] = "Continue",
 		HTTP_REASON_PHRASE_101[] = "Switching Protocols",
@@ -262,6 +260,43 @@ std::ostream & operator << (std::ostream &os, const HttpResponseHeaders &headers
 	return write_header_fields(os << headers.protocol_version << ' ' << headers.status_code << ' ' << headers.reason_phrase << "\r\n", headers);
 }
 
+template <typename Headers>
+static bool read_header_block(PeekableSource &source, Headers &headers) {
+	size_t scanned = 0;
+	for (size_t min_bytes = 1;; min_bytes = scanned + 4) {
+		const void *ptr;
+		ssize_t r;
+		if ((r = source.peek(ptr, min_bytes)) < 0) {
+			throw std::ios_base::failure("premature EOF");
+		}
+		std::string_view sv(static_cast<const char *>(ptr), r);
+		if (auto pos = sv.find("\r\n\r\n", scanned); pos != sv.npos) {
+			MemoryBuf mb(ptr, pos += 4);
+			std::istream is(&mb);
+			is.exceptions(std::ios_base::badbit | std::ios_base::failbit);
+			is >> headers;
+			source.consume(pos);
+			return true;
+		}
+		if (static_cast<size_t>(r) < min_bytes) {
+			return false;
+		}
+		scanned = std::max(sv.size(), size_t(3)) - 3;
+	}
+}
+
+bool read_headers(PeekableSource &source, HttpRequestHeaders &headers) {
+	// skip any empty lines preceding the request line, per RFC 2616 §4.1
+	for (const void *ptr; source.peek(ptr, 2) >= 2 && std::memcmp(ptr, "\r\n", 2) == 0;) {
+		source.consume(2);
+	}
+	return read_header_block(source, headers);
+}
+
+bool read_headers(PeekableSource &source, HttpResponseHeaders &headers) {
+	return read_header_block(source, headers);
+}
+
 
 std::string rfc2822_date(const struct std::tm &tm) {
 	static const char *weekday_name[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
@@ -633,250 +668,7 @@ std::time_t rfc2822_date(std::string_view sv) {
 }
 
 
-ssize_t ChunkedSource::read(void *buf, size_t n) {
-	static const int8_t UNHEX['f' - '0' + 1] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15 };
-	ssize_t r;
-	char c;
-	for (;;) {
-		switch (state) {
-			case Size:
-				for (;;) {
-					if ((r = source.read(&c, 1)) <= 0) {
-						goto Exit;
-					}
-					if (c == ';') {
-						state = Extensions;
-						break;
-					}
-					if (c == '\r') {
-						state = Size_CR;
-						break;
-					}
-					int8_t v;
-					if (c < '0' || c > 'f' || (v = UNHEX[static_cast<uint8_t>(c - '0')]) < 0) {
-						throw std::ios_base::failure("invalid chunk size");
-					}
-					chunk_rem = chunk_rem << 4 | v;
-				}
-				break;
-			case Size_CR:
-				if ((r = source.read(&c, 1)) <= 0) {
-					goto Exit;
-				}
-				if (c != '\n') {
-					throw std::ios_base::failure("invalid chunk size");
-				}
-				state = chunk_rem ? Data : End;
-				break;
-			case Extensions:
-				for (;;) {
-					if ((r = source.read(&c, 1)) <= 0) {
-						goto Exit;
-					}
-					if (c == '\r') {
-						state = Extensions_CR;
-						break;
-					}
-				}
-				break;
-			case Extensions_CR:
-				if ((r = source.read(&c, 1)) <= 0) {
-					goto Exit;
-				}
-				if (c != '\n') {
-					if (c != '\r') {
-						state = Extensions;
-					}
-					break;
-				}
-				state = chunk_rem ? Data : End;
-				break;
-			case Data:
-				if ((r = source.read(buf, std::min(n, chunk_rem))) <= 0) {
-					goto Exit;
-				}
-				if ((chunk_rem -= r) == 0) {
-					state = Data_End;
-				}
-				return r;
-			case Data_End:
-				if ((r = source.read(&c, 1)) <= 0) {
-					goto Exit;
-				}
-				if (c != '\r') {
-					throw std::ios_base::failure("invalid chunk");
-				}
-				state = Data_CR;
-				// fall through
-			case Data_CR:
-				if ((r = source.read(&c, 1)) <= 0) {
-					goto Exit;
-				}
-				if (c != '\n') {
-					throw std::ios_base::failure("invalid chunk");
-				}
-				state = Size;
-				break;
-			case End:
-				return -1;
-		}
-	}
-Exit:
-	if (r < 0) {
-		throw std::ios_base::failure("premature End");
-	}
-	return 0;
-}
-
-size_t ChunkedSource::avail() {
-	return std::min(source.avail(), chunk_rem);
-}
-
-
-size_t ChunkedSink::write(const void *buf, size_t n) {
-	return this->write(buf, n, false);
-}
+#include "http.tcc"
 
-size_t ChunkedSink::write(const void *buf, size_t n, bool flush) {
-	static const char HEX[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
-	size_t ret = 0, mask;
-	char c;
-	for (;;) {
-		switch (state) {
-			case Idle:
-				if (n == 0 && !flush) {
-					return ret;
-				}
-				write_size = n;
-				state = Size;
-				// fall through
-			case Size:
-				for (;;) {
-#if SIZE_MAX >= UINT64_MAX
-					if (write_size & BITS(32, 32)) {
-						if (write_size & BITS(16, 48)) {
-							if (write_size & BITS(8, 56)) {
-								if (mask = write_size & BITS(4, 60)) {
-									c = HEX[mask >> 60];
-								}
-								else {
-									c = HEX[(mask = write_size & BITS(4, 56)) >> 56];
-								}
-							}
-							else if (mask = write_size & BITS(4, 52)) {
-								c = HEX[mask >> 52];
-							}
-							else {
-								c = HEX[(mask = write_size & BITS(4, 48)) >> 48];
-							}
-						}
-						else if (write_size & BITS(8, 40)) {
-							if (mask = write_size & BITS(4, 44)) {
-								c = HEX[mask >> 44];
-							}
-							else {
-								c = HEX[(mask = write_size & BITS(4, 40)) >> 40];
-							}
-						}
-						else if (mask = write_size & BITS(4, 36)) {
-							c = HEX[mask >> 36];
-						}
-						else {
-							c = HEX[(mask = write_size & BITS(4, 32)) >> 32];
-						}
-					}
-					else
-#endif
-					if (write_size & BITS(16, 16)) {
-						if (write_size & BITS(8, 24)) {
-							if (mask = write_size & BITS(4, 28)) {
-								c = HEX[mask >> 28];
-							}
-							else {
-								c = HEX[(mask = write_size & BITS(4, 24)) >> 24];
-							}
-						}
-						else if (mask = write_size & BITS(4, 20)) {
-							c = HEX[mask >> 20];
-						}
-						else {
-							c = HEX[(mask = write_size & BITS(4, 16)) >> 16];
-						}
-					}
-					else if (write_size & BITS(8, 8)) {
-						if (mask = write_size & BITS(4, 12)) {
-							c = HEX[mask >> 12];
-						}
-						else {
-							c = HEX[(mask = write_size & BITS(4, 8)) >> 8];
-						}
-					}
-					else if (mask = write_size & BITS(4, 4)) {
-						c = HEX[mask >> 4];
-					}
-					else {
-						c = HEX[mask = write_size & BITS(4, 0)];
-					}
-					if (sink.write(&c, 1) == 0) {
-						return ret;
-					}
-					if ((write_size ^= mask) == 0) {
-						state = Size_CR;
-						break;
-					}
-				}
-				// fall through
-			case Size_CR:
-				c = '\r';
-				if (sink.write(&c, 1) == 0) {
-					return ret;
-				}
-				state = Size_LF;
-				// fall through
-			case Size_LF:
-				c = '\n';
-				if (sink.write(&c, 1) == 0) {
-					return ret;
-				}
-				state = n ? Data : End;
-				break;
-			case Data:
-				if ((ret = sink.write(buf, n)) < n) {
-					return ret;
-				}
-				buf = nullptr;
-				n = 0;
-				state = Data_CR;
-				// fall through
-			case Data_CR:
-				c = '\r';
-				if (sink.write(&c, 1) == 0) {
-					return ret;
-				}
-				state = Data_LF;
-				// fall through
-			case Data_LF:
-				c = '\n';
-				if (sink.write(&c, 1) == 0) {
-					return ret;
-				}
-				state = Idle;
-				break;
-			case End:
-				if (n > 0) {
-					throw std::logic_error("final chunk already sent");
-				}
-				return ret;
-		}
-	}
-}
-
-bool ChunkedSink::flush() {
-	if (state != End) {
-		this->write(nullptr, 0, true);
-		if (state != End) {
-			return false;
-		}
-	}
-	return sink.flush();
-}
+template class BasicChunkedSource<Source>;
+template class BasicChunkedSink<Sink>;
@@ -40,6 +40,15 @@ public:
 std::istream & operator >> (std::istream &is, HttpRequestHeaders &headers);
 std::ostream & operator << (std::ostream &os, const HttpRequestHeaders &headers);
 
+/**
+ * @brief Parses a request header block in place from the buffered data of the given source.
+ *
+ * @return \c true if the header block was parsed and consumed,
+ * or \c false if reading the rest of the header block would block, in which case nothing is consumed.
+ * @throw std::length_error if the header block does not fit within the buffer of \p source.
+ */
+bool read_headers(PeekableSource &source, HttpRequestHeaders &headers);
+
 
 class HttpResponseHeaders : public HttpHeaders {
 
@@ -57,38 +66,51 @@ public:
 std::istream & operator >> (std::istream &is, HttpResponseHeaders &headers);
 std::ostream & operator << (std::ostream &os, const HttpResponseHeaders &headers);
 
+bool read_headers(PeekableSource &source, HttpResponseHeaders &headers);
+
 
 std::string rfc2822_date(const struct std::tm &tm);
 std::time_t rfc2822_date(std::string_view sv);
 
 
-class ChunkedSource : public Source {
+// definitions in http.tcc; see the note on stream adapters in io.h
+template <typename S = Source>
+class BasicChunkedSource : public Source {
 
 private:
-	Source &source;
+	S &source;
+	PeekableSource * const peekable; // used only if S is not statically known to be peekable
 	size_t chunk_rem;
 	enum { Size, Size_CR, Extensions, Extensions_CR, Data, Data_End, Data_CR, End } state;
 
 public:
-	explicit ChunkedSource(Source &source) noexcept : source(source), chunk_rem(), state() { }
+	explicit BasicChunkedSource(S &source) noexcept : source(source), peekable(std::is_base_of_v<PeekableSource, S> ? nullptr : dynamic_cast<PeekableSource *>(&source)), chunk_rem(), state() { }
 
 public:
 	void reset() noexcept { chunk_rem = 0, state = Size; }
 	ssize_t read(void *buf, size_t n) override;
 	size_t avail() override;
 
+private:
+	template <typename P>
+	ssize_t advance(P &upstream);
+	void advance(char c);
+
 };
 
+using ChunkedSource = BasicChunkedSource<>;
+
 
-class ChunkedSink : public Sink {
+template <typename K = Sink>
+class BasicChunkedSink : public Sink {
 
 private:
-	Sink &sink;
+	K &sink;
 	size_t write_size;
 	enum { Idle, Size, Size_CR, Size_LF, Data, Data_CR, Data_LF, End } state;
 
 public:
-	explicit ChunkedSink(Sink &sink) noexcept : sink(sink), write_size(), state() { }
+	explicit BasicChunkedSink(K &sink) noexcept : sink(sink), write_size(), state() { }
 
 public:
 	void reset() noexcept { write_size = 0, state = Idle; }
@@ -99,3 +121,5 @@ private:
 	size_t write(const void *buf, size_t n, bool flush);
 
 };
+
+using ChunkedSink = BasicChunkedSink<>;
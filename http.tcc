@@ -0,0 +1,280 @@
+#include "http.h"
+
+#include <algorithm>
+
+#define BITS(l, o) (((size_t(1) << (l)) - 1) << (o))
+
+
+template <typename S>
+ssize_t BasicChunkedSource<S>::read(void *buf, size_t n) {
+	ssize_t r;
+	for (;;) {
+		switch (state) {
+			case Data:
+				if ((r = source.read(buf, std::min(n, chunk_rem))) <= 0) {
+					goto Exit;
+				}
+				if ((chunk_rem -= r) == 0) {
+					state = Data_End;
+				}
+				return r;
+			case End:
+				return -1;
+			default:
+				break;
+		}
+		if constexpr (std::is_base_of_v<PeekableSource, S>) {
+			if ((r = this->advance(source)) <= 0) {
+				goto Exit;
+			}
+		}
+		else if (peekable) {
+			if ((r = this->advance(*peekable)) <= 0) {
+				goto Exit;
+			}
+		}
+		else {
+			char c;
+			if ((r = source.read(&c, 1)) <= 0) {
+				goto Exit;
+			}
+			this->advance(c);
+		}
+	}
+Exit:
+	if (r < 0) {
+		throw std::ios_base::failure("premature End");
+	}
+	return 0;
+}
+
+// parses the framing in place rather than pulling it through one byte at a time
+template <typename S>
+template <typename P>
+ssize_t BasicChunkedSource<S>::advance(P &upstream) {
+	const void *ptr;
+	ssize_t r;
+	if ((r = upstream.peek(ptr)) > 0) {
+		auto p = static_cast<const char *>(ptr), e = p + r;
+		do {
+			this->advance(*p++);
+		} while (p < e && state != Data && state != End);
+		upstream.consume(p - static_cast<const char *>(ptr));
+	}
+	return r;
+}
+
+template <typename S>
+void BasicChunkedSource<S>::advance(char c) {
+	static const int8_t UNHEX['f' - '0' + 1] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15 };
+	switch (state) {
+		case Size:
+			if (c == ';') {
+				state = Extensions;
+			}
+			else if (c == '\r') {
+				state = Size_CR;
+			}
+			else {
+				int8_t v;
+				if (c < '0' || c > 'f' || (v = UNHEX[static_cast<uint8_t>(c - '0')]) < 0) {
+					throw std::ios_base::failure("invalid chunk size");
+				}
+				chunk_rem = chunk_rem << 4 | v;
+			}
+			break;
+		case Size_CR:
+			if (c != '\n') {
+				throw std::ios_base::failure("invalid chunk size");
+			}
+			state = chunk_rem ? Data : End;
+			break;
+		case Extensions:
+			if (c == '\r') {
+				state = Extensions_CR;
+			}
+			break;
+		case Extensions_CR:
+			if (c == '\n') {
+				state = chunk_rem ? Data : End;
+			}
+			else if (c != '\r') {
+				state = Extensions;
+			}
+			break;
+		case Data_End:
+			if (c != '\r') {
+				throw std::ios_base::failure("invalid chunk");
+			}
+			state = Data_CR;
+			break;
+		case Data_CR:
+			if (c != '\n') {
+				throw std::ios_base::failure("invalid chunk");
+			}
+			state = Size;
+			break;
+		case Data:
+		case End:
+			break;
+	}
+}
+
+template <typename S>
+size_t BasicChunkedSource<S>::avail() {
+	return std::min(source.avail(), chunk_rem);
+}
+
+
+template <typename K>
+size_t BasicChunkedSink<K>::write(const void *buf, size_t n) {
+	return this->write(buf, n, false);
+}
+
+template <typename K>
+size_t BasicChunkedSink<K>::write(const void *buf, size_t n, bool flush) {
+	static const char HEX[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+	size_t ret = 0, mask;
+	char c;
+	for (;;) {
+		switch (state) {
+			case Idle:
+				if (n == 0 && !flush) {
+					return ret;
+				}
+				write_size = n;
+				state = Size;
+				// fall through
+			case Size:
+				for (;;) {
+#if SIZE_MAX >= UINT64_MAX
+					if (write_size & BITS(32, 32)) {
+						if (write_size & BITS(16, 48)) {
+							if (write_size & BITS(8, 56)) {
+								if (mask = write_size & BITS(4, 60)) {
+									c = HEX[mask >> 60];
+								}
+								else {
+									c = HEX[(mask = write_size & BITS(4, 56)) >> 56];
+								}
+							}
+							else if (mask = write_size & BITS(4, 52)) {
+								c = HEX[mask >> 52];
+							}
+							else {
+								c = HEX[(mask = write_size & BITS(4, 48)) >> 48];
+							}
+						}
+						else if (write_size & BITS(8, 40)) {
+							if (mask = write_size & BITS(4, 44)) {
+								c = HEX[mask >> 44];
+							}
+							else {
+								c = HEX[(mask = write_size & BITS(4, 40)) >> 40];
+							}
+						}
+						else if (mask = write_size & BITS(4, 36)) {
+							c = HEX[mask >> 36];
+						}
+						else {
+							c = HEX[(mask = write_size & BITS(4, 32)) >> 32];
+						}
+					}
+					else
+#endif
+					if (write_size & BITS(16, 16)) {
+						if (write_size & BITS(8, 24)) {
+							if (mask = write_size & BITS(4, 28)) {
+								c = HEX[mask >> 28];
+							}
+							else {
+								c = HEX[(mask = write_size & BITS(4, 24)) >> 24];
+							}
+						}
+						else if (mask = write_size & BITS(4, 20)) {
+							c = HEX[mask >> 20];
+						}
+						else {
+							c = HEX[(mask = write_size & BITS(4, 16)) >> 16];
+						}
+					}
+					else if (write_size & BITS(8, 8)) {
+						if (mask = write_size & BITS(4, 12)) {
+							c = HEX[mask >> 12];
+						}
+						else {
+							c = HEX[(mask = write_size & BITS(4, 8)) >> 8];
+						}
+					}
+					else if (mask = write_size & BITS(4, 4)) {
+						c = HEX[mask >> 4];
+					}
+					else {
+						c = HEX[mask = write_size & BITS(4, 0)];
+					}
+					if (sink.write(&c, 1) == 0) {
+						return ret;
+					}
+					if ((write_size ^= mask) == 0) {
+						state = Size_CR;
+						break;
+					}
+				}
+				// fall through
+			case Size_CR:
+				c = '\r';
+				if (sink.write(&c, 1) == 0) {
+					return ret;
+				}
+				state = Size_LF;
+				// fall through
+			case Size_LF:
+				c = '\n';
+				if (sink.write(&c, 1) == 0) {
+					return ret;
+				}
+				state = n ? Data : End;
+				break;
+			case Data:
+				if ((ret = sink.write(buf, n)) < n) {
+					return ret;
+				}
+				buf = nullptr;
+				n = 0;
+				state = Data_CR;
+				// fall through
+			case Data_CR:
+				c = '\r';
+				if (sink.write(&c, 1) == 0) {
+					return ret;
+				}
+				state = Data_LF;
+				// fall through
+			case Data_LF:
+				c = '\n';
+				if (sink.write(&c, 1) == 0) {
+					return ret;
+				}
+				state = Idle;
+				break;
+			case End:
+				if (n > 0) {
+					throw std::logic_error("final chunk already sent");
+				}
+				return ret;
+		}
+	}
+}
+
+template <typename K>
+bool BasicChunkedSink<K>::flush() {
+	if (state != End) {
+		this->write(nullptr, 0, true);
+		if (state != End) {
+			return false;
+		}
+	}
+	return sink.flush();
+}
+
+#undef BITS
@@ -3,8 +3,13 @@
 #include <cstddef>
 #include <system_error>
 
+#include "iobuf.h"
 #include "narrow.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
 
 ssize_t Source::read(const BufferPointer bufs[], size_t count) {
 	ssize_t ret = 0;
@@ -108,41 +113,26 @@ void Sink::write_fully(const BufferPointer bufs[], size_t count) {
 	}
 }
 
-void Sink::flush_fully() {
-	if (!this->flush()) {
-		throw std::logic_error("non-blocking write in blocking context");
-	}
+size_t Sink::write(BufferChain &chain) {
+	// a batch of slices that keeps the array small on the stack yet fills a socket buffer at typical slice sizes
+	BufferPointer bufs[64];
+	size_t w = this->write(bufs, chain.gather(bufs, std::size(bufs)));
+	chain.consume(w);
+	return w;
 }
 
-
-ssize_t LimitedSource::read(void *buf, size_t n) {
-	if (n == 0) {
-		return 0;
-	}
-	if (n > remaining) {
-		if (remaining == 0) {
-			return -1;
+void Sink::write_fully(BufferChain &chain) {
+	while (!chain.empty()) {
+		if (this->write(chain) == 0) {
+			throw std::logic_error("non-blocking write in blocking context");
 		}
-		n = remaining;
 	}
-	ssize_t r = source.read(buf, n);
-	if (r > 0) {
-		remaining -= r;
-	}
-	return r;
 }
 
-
-size_t LimitedSink::write(const void *buf, size_t n) {
-	if (n > remaining) {
-		n = remaining;
-	}
-	if (n == 0) {
-		return 0;
+void Sink::flush_fully() {
+	if (!this->flush()) {
+		throw std::logic_error("non-blocking write in blocking context");
 	}
-	size_t w = sink.write(buf, n);
-	remaining -= w;
-	return w;
 }
 
 
@@ -158,6 +148,12 @@ ssize_t MemorySource::read(void *buf, size_t n) {
 	return n;
 }
 
+ssize_t MemorySource::peek(const void *&ptr, size_t min_bytes) {
+	size_t grem = this->grem();
+	ptr = gptr;
+	return grem < min_bytes ? -1 : grem;
+}
+
 
 size_t MemorySink::write(const void *buf, size_t n) {
 	size_t prem = this->prem();
@@ -181,6 +177,12 @@ ssize_t BufferSource::read(void *buf, size_t n) {
 	return n;
 }
 
+ssize_t BufferSource::peek(const void *&ptr, size_t min_bytes) {
+	size_t grem = buffer.grem();
+	ptr = buffer.gptr;
+	return grem < min_bytes ? -1 : grem;
+}
+
 
 size_t StaticBufferSink::write(const void *buf, size_t n) {
 	size_t prem = buffer.prem();
@@ -192,80 +194,90 @@ size_t StaticBufferSink::write(const void *buf, size_t n) {
 }
 
 
-size_t BufferSink::write(const void *buf, size_t n) {
-	this->append(buf, n);
-	return n;
-}
-
-
 size_t StringSink::write(const void *buf, size_t n) {
 	string.append(static_cast<const char *>(buf), n);
 	return n;
 }
 
 
-ssize_t BufferedSourceBase::read(void *buf, size_t n) {
-	if (n == 0) {
-		return 0;
-	}
-	size_t b = buf_pptr - buf_gptr;
-	if (b > 0) {
-		if (n <= b) {
-			std::memcpy(buf, buf_gptr, n), buf_gptr += n;
-			return n;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/*
+ * Both variants compare a block of candidate positions against the first and last bytes of the delimiter at once
+ * and then verify only the positions where both match.
+ */
+
+_target("sse2")
+static size_t find_delimiter_sse2(const char *p, size_t n, std::string_view delimiter) noexcept {
+	size_t d = delimiter.size() - 1, i = 0;
+	if (n >= d + sizeof(__m128i)) {
+		const __m128i first = _mm_set1_epi8(delimiter.front()), last = _mm_set1_epi8(delimiter.back());
+		for (; i <= n - d - sizeof(__m128i); i += sizeof(__m128i)) {
+			unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+					_mm_cmpeq_epi8(first, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i))),
+					_mm_cmpeq_epi8(last, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + d)))));
+			for (; mask; mask &= mask - 1) {
+				size_t pos = i + _ctz(mask);
+				if (d < 2 || std::memcmp(p + pos + 1, delimiter.data() + 1, d - 1) == 0) {
+					return pos;
+				}
+			}
 		}
-		std::memcpy(buf, buf_gptr, b), buf_gptr += b;
-		buf = static_cast<uint8_t *>(buf) + b, n -= b;
-	}
-	ssize_t r = buf_eptr - buf_bptr;
-	if (n >= static_cast<size_t>(r)) {
-		r = source.read(buf, n);
-		return r >= 0 ? b + r : b == 0 ? r : b;
 	}
-	if ((r = source.read(buf_gptr = buf_bptr, r)) <= 0) {
-		buf_pptr = buf_bptr;
-		return b == 0 ? r : b;
-	}
-	buf_pptr = buf_bptr + r;
-	if (n <= static_cast<size_t>(r)) {
-		std::memcpy(buf, buf_gptr, n), buf_gptr += n;
-		return b + n;
+	size_t pos = std::string_view(p + i, n - i).find(delimiter);
+	return pos == std::string_view::npos ? pos : i + pos;
+}
+
+_target("avx2")
+static size_t find_delimiter_avx2(const char *p, size_t n, std::string_view delimiter) noexcept {
+	size_t d = delimiter.size() - 1, i = 0;
+	if (n >= d + sizeof(__m256i)) {
+		const __m256i first = _mm256_set1_epi8(delimiter.front()), last = _mm256_set1_epi8(delimiter.back());
+		for (; i <= n - d - sizeof(__m256i); i += sizeof(__m256i)) {
+			unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+					_mm256_cmpeq_epi8(first, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i))),
+					_mm256_cmpeq_epi8(last, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i + d)))));
+			for (; mask; mask &= mask - 1) {
+				size_t pos = i + _ctz(mask);
+				if (d < 2 || std::memcmp(p + pos + 1, delimiter.data() + 1, d - 1) == 0) {
+					return pos;
+				}
+			}
+		}
 	}
-	std::memcpy(buf, buf_gptr, r), buf_gptr += r;
-	return b + r;
+	size_t pos = std::string_view(p + i, n - i).find(delimiter);
+	return pos == std::string_view::npos ? pos : i + pos;
 }
 
+#endif
 
-size_t BufferedSinkBase::write(const void *buf, size_t n) {
-	if (n == 0) {
-		return 0;
-	}
-	size_t r = buf_eptr - buf_pptr;
-	if (r > 0) {
-		if (n < r) {
-			std::memcpy(buf_pptr, buf, n), buf_pptr += n;
-			return n;
-		}
-		std::memcpy(buf_pptr, buf, r), buf_pptr += r;
-		buf = static_cast<const uint8_t *>(buf) + r, n -= r;
-	}
-	size_t b = buf_eptr - buf_gptr;
-	if (b > 0 && (buf_gptr += sink.write(buf_gptr, b)) < buf_eptr) {
-		return r;
-	}
-	if (n >= static_cast<size_t>(buf_eptr - buf_bptr)) {
-		return r + sink.write(buf, n);
-	}
-	std::memcpy(buf_gptr = buf_bptr, buf, n), buf_pptr = buf_bptr + n;
-	return r + n;
+// returns the offset of the first occurrence of the delimiter in the buffer, or npos if there is none
+static size_t find_delimiter(const char *p, size_t n, std::string_view delimiter) noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	static const auto find = __builtin_cpu_supports("avx2") ? find_delimiter_avx2 : find_delimiter_sse2;
+	return find(p, n, delimiter);
+#else
+	return std::string_view(p, n).find(delimiter);
+#endif
 }
 
-bool BufferedSinkBase::flush() {
-	size_t b = buf_pptr - buf_gptr;
-	return (b == 0 || (buf_gptr += sink.write(buf_gptr, b)) == buf_pptr) && sink.flush();
+// advances a partial match by one byte, falling back on a mismatch to the longest prefix of the delimiter that is still matched
+static std::string_view::const_iterator advance_match(std::string_view delimiter, std::string_view::const_iterator itr, char c) noexcept {
+	for (;;) {
+		if (c == *itr) {
+			return itr + 1;
+		}
+		if (itr == delimiter.begin()) {
+			return itr;
+		}
+		size_t k = itr - delimiter.begin(), j = k - 1;
+		while (j > 0 && delimiter.compare(0, j, delimiter.substr(k - j, j)) != 0) {
+			--j;
+		}
+		itr = delimiter.begin() + j;
+	}
 }
 
-
 ssize_t DelimitedSource::read(void *buf, size_t n) {
 	ssize_t r = 0;
 	while (n > 0) {
@@ -274,12 +286,40 @@ ssize_t DelimitedSource::read(void *buf, size_t n) {
 			return r == 0 ? -1 : r;
 		}
 		ssize_t s;
-		if ((s = source.read(buf, std::min(static_cast<size_t>(d), n))) <= 0) {
-			return r == 0 ? s : r;
+		if (peekable) {
+			// scan the upstream buffer in place so that we never consume past the end of the delimiter
+			const void *ptr;
+			if ((s = peekable->peek(ptr)) <= 0) {
+				return r == 0 ? s : r;
+			}
+			auto b = static_cast<const char *>(ptr), p = b, e = b + std::min(static_cast<size_t>(s), n);
+			// finish any partial match left over from the previous call
+			for (; p < e && delim_itr != delimiter.begin() && delim_itr != delimiter.end(); ++p) {
+				delim_itr = advance_match(delimiter, delim_itr, *p);
+			}
+			if (p < e && delim_itr == delimiter.begin()) {
+				size_t pos = find_delimiter(p, e - p, delimiter);
+				if (pos != std::string_view::npos) {
+					p += pos + delimiter.size(), delim_itr = delimiter.end();
+				}
+				else {
+					// no complete delimiter here, but the tail may hold the beginning of one
+					for (p = e - std::min(static_cast<size_t>(e - p), delimiter.size() - 1); p < e; ++p) {
+						delim_itr = advance_match(delimiter, delim_itr, *p);
+					}
+				}
+			}
+			std::memcpy(buf, b, s = p - b);
+			peekable->consume(s);
 		}
-		for (ssize_t i = 0; i < s; ++i) {
-			char c = static_cast<char *>(buf)[i];
-			delim_itr = c == *delim_itr ? delim_itr + 1 : c == *delimiter.begin() ? delimiter.begin() + 1 : delimiter.begin();
+		else {
+			if ((s = source.read(buf, std::min(static_cast<size_t>(d), n))) <= 0) {
+				return r == 0 ? s : r;
+			}
+			for (ssize_t i = 0; i < s; ++i) {
+				char c = static_cast<char *>(buf)[i];
+				delim_itr = advance_match(delimiter, delim_itr, c);
+			}
 		}
 		buf = static_cast<char *>(buf) + s, n -= s, r += s;
 	}
@@ -426,3 +466,11 @@ MemoryBuf * MemoryBuf::setbuf(char s[], std::streamsize n) {
 	this->setg(s, s, s + n);
 	return this;
 }
+
+
+#include "io.tcc"
+
+template class BasicLimitedSource<Source>;
+template class BasicLimitedSink<Sink>;
+template class BasicBufferedSourceBase<Source>;
+template class BasicBufferedSinkBase<Sink>;
@@ -10,6 +10,9 @@
 #include "compiler.h"
 
 
+class BufferChain;
+
+
 class Source {
 
 public:
@@ -35,6 +38,28 @@ public:
 };
 
 
+class PeekableSource : public Source {
+
+public:
+	/**
+	 * @brief Exposes buffered data in place, reading more from upstream if fewer than \p min_bytes are buffered.
+	 *
+	 * @param[out] ptr Set to point to the first unconsumed byte. The pointed-to data remain valid until the next call of any other member function.
+	 * @param[in] min_bytes The number of contiguous bytes that the caller needs to see.
+	 * @return the number of contiguous bytes available at \p ptr, which is less than \p min_bytes (possibly zero) only if reading more would block,
+	 * or negative if the end of the stream was reached before \p min_bytes could be made available, in which case any buffered data remain peekable with a smaller \p min_bytes.
+	 * @throw std::length_error if \p min_bytes exceeds the capacity of the buffer.
+	 */
+	_nodiscard virtual ssize_t peek(const void *&ptr, size_t min_bytes = 1) = 0;
+
+	/**
+	 * @brief Discards the given number of bytes, which must not exceed the number returned by the last call of @ref peek.
+	 */
+	virtual void consume(size_t n) noexcept = 0;
+
+};
+
+
 class Sink {
 
 public:
@@ -55,22 +80,51 @@ public:
 	void write_fully(const BufferPointer bufs[], size_t count);
 	void flush_fully();
 
+	// writes as much of the chain as possible in a single gathering write and removes the written bytes from it
+	_nodiscard size_t write(BufferChain &chain);
+	void write_fully(BufferChain &chain);
+
 	_nodiscard size_t write(std::initializer_list<BufferPointer> bufs) { return this->write(bufs.begin(), bufs.size()); }
 	void write_fully(std::initializer_list<BufferPointer> bufs) { return this->write_fully(bufs.begin(), bufs.size()); }
 
 };
 
 
-class LimitedSource : public Source {
+/*
+ * The adapters below are templated on the type of the stream they wrap. Naming a concrete stream type instead of the
+ * default Source or Sink lets the compiler bind and inline the calls between adjacent stages of a pipeline, while each
+ * stage remains usable as a plain Source or Sink. The calls bind directly only if the named type is final; the adapters
+ * are not, so that they remain open to subclassing, but Final seals any stage of a static pipeline:
+ *
+ *     Final<MemorySource> memory(data, size);
+ *     Final<BasicLimitedSource<decltype(memory)>> limited(memory, content_length);
+ *     Final<BufferedSource<4096, decltype(limited)>> buffered(limited);
+ *     BasicChunkedSource chunked(buffered);
+ *
+ * The member function definitions live in io.tcc, which must be included to instantiate an adapter over any stream type
+ * other than the defaults.
+ */
+
+template <typename T>
+class Final final : public T {
+
+public:
+	using T::T;
+
+};
+
+
+template <typename S = Source>
+class BasicLimitedSource : public Source {
 
 public:
 	size_t remaining;
 
 private:
-	Source &source;
+	S &source;
 
 public:
-	LimitedSource(Source &source, size_t remaining) noexcept : remaining(remaining), source(source) { }
+	BasicLimitedSource(S &source, size_t remaining) noexcept : remaining(remaining), source(source) { }
 
 public:
 	_nodiscard ssize_t read(void *buf, size_t n) override;
@@ -78,17 +132,20 @@ public:
 
 };
 
+using LimitedSource = BasicLimitedSource<>;
 
-class LimitedSink : public Sink {
+
+template <typename K = Sink>
+class BasicLimitedSink : public Sink {
 
 public:
 	size_t remaining;
 
 private:
-	Sink &sink;
+	K &sink;
 
 public:
-	LimitedSink(Sink &sink, size_t remaining) noexcept : remaining(remaining), sink(sink) { }
+	BasicLimitedSink(K &sink, size_t remaining) noexcept : remaining(remaining), sink(sink) { }
 
 public:
 	_nodiscard size_t write(const void *buf, size_t n) override;
@@ -96,8 +153,10 @@ public:
 
 };
 
+using LimitedSink = BasicLimitedSink<>;
+
 
-class MemorySource : public BasicStaticBuffer<const uint8_t>, public Source {
+class MemorySource : public BasicStaticBuffer<const uint8_t>, public PeekableSource {
 
 public:
 	MemorySource(const void *buf, size_t n) noexcept : BasicStaticBuffer<const uint8_t>(static_cast<const uint8_t *>(buf), static_cast<const uint8_t *>(buf), static_cast<const uint8_t *>(buf) + n, static_cast<const uint8_t *>(buf) + n) { }
@@ -105,6 +164,8 @@ public:
 public:
 	_nodiscard ssize_t read(void *buf, size_t n) override;
 	size_t _pure avail() override { return this->grem(); }
+	_nodiscard ssize_t peek(const void *&ptr, size_t min_bytes = 1) override;
+	void consume(size_t n) noexcept override { gptr += n; }
 
 };
 
@@ -120,7 +181,7 @@ public:
 };
 
 
-class BufferSource : public Source {
+class BufferSource : public PeekableSource {
 
 private:
 	StaticBuffer &buffer;
@@ -131,6 +192,8 @@ public:
 public:
 	_nodiscard ssize_t read(void *buf, size_t n) override;
 	size_t _pure avail() override { return buffer.grem(); }
+	_nodiscard ssize_t peek(const void *&ptr, size_t min_bytes = 1) override;
+	void consume(size_t n) noexcept override { buffer.gptr += n; }
 
 };
 
@@ -149,18 +212,22 @@ public:
 };
 
 
-class BufferSink : public Buffer, public Sink {
+template <typename Allocator = MallocAllocator>
+class BasicBufferSink : public BasicBuffer<uint8_t, Allocator>, public Sink {
 
 public:
-	BufferSink() noexcept = default;
-	explicit BufferSink(size_t initial_size) : Buffer(initial_size) { }
-	explicit BufferSink(Buffer &&move) : Buffer(std::move(move)) { }
+	BasicBufferSink() noexcept = default;
+	explicit BasicBufferSink(const Allocator &allocator) noexcept : BasicBuffer<uint8_t, Allocator>(allocator) { }
+	explicit BasicBufferSink(size_t initial_size, const Allocator &allocator = Allocator()) : BasicBuffer<uint8_t, Allocator>(initial_size, allocator) { }
+	explicit BasicBufferSink(BasicBuffer<uint8_t, Allocator> &&move) noexcept : BasicBuffer<uint8_t, Allocator>(std::move(move)) { }
 
 public:
-	_nodiscard size_t write(const void *buf, size_t n) override;
+	_nodiscard size_t write(const void *buf, size_t n) override { return this->append(buf, n), n; }
 
 };
 
+using BufferSink = BasicBufferSink<>;
+
 
 class StringSource : public MemorySource {
 
@@ -185,30 +252,39 @@ public:
 };
 
 
-class BufferedSourceBase : public Source {
+template <typename S = Source>
+class BasicBufferedSourceBase : public PeekableSource {
 
 private:
-	Source &source;
+	S &source;
 	uint8_t * const buf_bptr, *buf_gptr, *buf_pptr, * const buf_eptr;
 
 protected:
-	explicit BufferedSourceBase(Source &source, uint8_t *buf_bptr, uint8_t *buf_eptr) noexcept : source(source), buf_bptr(buf_bptr), buf_gptr(buf_bptr), buf_pptr(buf_bptr), buf_eptr(buf_eptr) { }
+	explicit BasicBufferedSourceBase(S &source, uint8_t *buf_bptr, uint8_t *buf_eptr) noexcept : source(source), buf_bptr(buf_bptr), buf_gptr(buf_bptr), buf_pptr(buf_bptr), buf_eptr(buf_eptr) { }
 
 public:
 	_nodiscard ssize_t read(void *buf, size_t n) override;
 	size_t avail() override { return buf_pptr - buf_gptr; }
+	_nodiscard ssize_t peek(const void *&ptr, size_t min_bytes = 1) override { void *p; ssize_t r = this->peek(p, min_bytes); return ptr = p, r; }
+	void consume(size_t n) noexcept override { buf_gptr += n; }
+
+	// as above, but grants write access to the buffered data, e.g., for in-place decoding
+	_nodiscard ssize_t peek(void *&ptr, size_t min_bytes = 1);
 
 };
 
+using BufferedSourceBase = BasicBufferedSourceBase<>;
 
-class BufferedSinkBase : public Sink {
+
+template <typename K = Sink>
+class BasicBufferedSinkBase : public Sink {
 
 private:
-	Sink &sink;
+	K &sink;
 	uint8_t * const buf_bptr, *buf_gptr, *buf_pptr, * const buf_eptr;
 
 protected:
-	explicit BufferedSinkBase(Sink &sink, uint8_t *buf_bptr, uint8_t *buf_eptr) noexcept : sink(sink), buf_bptr(buf_bptr), buf_gptr(buf_eptr), buf_pptr(buf_eptr), buf_eptr(buf_eptr) { }
+	explicit BasicBufferedSinkBase(K &sink, uint8_t *buf_bptr, uint8_t *buf_eptr) noexcept : sink(sink), buf_bptr(buf_bptr), buf_gptr(buf_eptr), buf_pptr(buf_eptr), buf_eptr(buf_eptr) { }
 
 public:
 	_nodiscard size_t write(const void *buf, size_t n) override;
@@ -216,27 +292,29 @@ public:
 
 };
 
+using BufferedSinkBase = BasicBufferedSinkBase<>;
+
 
-template <size_t Buffer_Size>
-class BufferedSource : public BufferedSourceBase {
+template <size_t Buffer_Size, typename S = Source>
+class BufferedSource : public BasicBufferedSourceBase<S> {
 
 private:
 	std::array<uint8_t, Buffer_Size> buffer;
 
 public:
-	explicit BufferedSource(Source &source) noexcept : BufferedSourceBase(source, &*buffer.begin(), &*buffer.end()) { }
+	explicit BufferedSource(S &source) noexcept : BasicBufferedSourceBase<S>(source, &*buffer.begin(), &*buffer.end()) { }
 
 };
 
 
-template <size_t Buffer_Size>
-class BufferedSink : public BufferedSinkBase {
+template <size_t Buffer_Size, typename K = Sink>
+class BufferedSink : public BasicBufferedSinkBase<K> {
 
 private:
 	std::array<uint8_t, Buffer_Size> buffer;
 
 public:
-	explicit BufferedSink(Sink &sink) noexcept : BufferedSinkBase(sink, &*buffer.begin(), &*buffer.end()) { }
+	explicit BufferedSink(K &sink) noexcept : BasicBufferedSinkBase<K>(sink, &*buffer.begin(), &*buffer.end()) { }
 
 };
 
@@ -245,11 +323,12 @@ class DelimitedSource : public Source {
 
 private:
 	Source &source;
+	PeekableSource * const peekable;
 	const std::string_view delimiter;
 	std::string_view::const_iterator delim_itr;
 
 public:
-	DelimitedSource(Source &source, std::string_view delimiter) noexcept : source(source), delimiter(delimiter), delim_itr(delimiter.begin()) { }
+	DelimitedSource(Source &source, std::string_view delimiter) noexcept : source(source), peekable(dynamic_cast<PeekableSource *>(&source)), delimiter(delimiter), delim_itr(delimiter.begin()) { }
 
 public:
 	void reset() noexcept { delim_itr = delimiter.begin(); }
@@ -0,0 +1,125 @@
+#include "io.h"
+
+#include <cstring>
+#include <stdexcept>
+
+
+template <typename S>
+ssize_t BasicLimitedSource<S>::read(void *buf, size_t n) {
+	if (n == 0) {
+		return 0;
+	}
+	if (n > remaining) {
+		if (remaining == 0) {
+			return -1;
+		}
+		n = remaining;
+	}
+	ssize_t r = source.read(buf, n);
+	if (r > 0) {
+		remaining -= r;
+	}
+	return r;
+}
+
+
+template <typename K>
+size_t BasicLimitedSink<K>::write(const void *buf, size_t n) {
+	if (n > remaining) {
+		n = remaining;
+	}
+	if (n == 0) {
+		return 0;
+	}
+	size_t w = sink.write(buf, n);
+	remaining -= w;
+	return w;
+}
+
+
+template <typename S>
+ssize_t BasicBufferedSourceBase<S>::read(void *buf, size_t n) {
+	if (n == 0) {
+		return 0;
+	}
+	size_t b = buf_pptr - buf_gptr;
+	if (b > 0) {
+		if (n <= b) {
+			std::memcpy(buf, buf_gptr, n), buf_gptr += n;
+			return n;
+		}
+		std::memcpy(buf, buf_gptr, b), buf_gptr += b;
+		buf = static_cast<uint8_t *>(buf) + b, n -= b;
+	}
+	ssize_t r = buf_eptr - buf_bptr;
+	if (n >= static_cast<size_t>(r)) {
+		r = source.read(buf, n);
+		return r >= 0 ? b + r : b == 0 ? r : b;
+	}
+	if ((r = source.read(buf_gptr = buf_bptr, r)) <= 0) {
+		buf_pptr = buf_bptr;
+		return b == 0 ? r : b;
+	}
+	buf_pptr = buf_bptr + r;
+	if (n <= static_cast<size_t>(r)) {
+		std::memcpy(buf, buf_gptr, n), buf_gptr += n;
+		return b + n;
+	}
+	std::memcpy(buf, buf_gptr, r), buf_gptr += r;
+	return b + r;
+}
+
+template <typename S>
+ssize_t BasicBufferedSourceBase<S>::peek(void *&ptr, size_t min_bytes) {
+	size_t b = buf_pptr - buf_gptr;
+	if (b < min_bytes) {
+		if (min_bytes > static_cast<size_t>(buf_eptr - buf_bptr)) {
+			throw std::length_error("peek exceeds buffer size");
+		}
+		if (min_bytes > static_cast<size_t>(buf_eptr - buf_gptr)) {
+			std::memmove(buf_bptr, buf_gptr, b), buf_gptr = buf_bptr, buf_pptr = buf_bptr + b;
+		}
+		do {
+			ssize_t r;
+			if ((r = source.read(buf_pptr, buf_eptr - buf_pptr)) <= 0) {
+				ptr = buf_gptr;
+				return r < 0 ? r : b;
+			}
+			buf_pptr += r, b += r;
+		} while (b < min_bytes);
+	}
+	ptr = buf_gptr;
+	return b;
+}
+
+
+template <typename K>
+size_t BasicBufferedSinkBase<K>::write(const void *buf, size_t n) {
+	if (n == 0) {
+		return 0;
+	}
+	size_t r = buf_eptr - buf_pptr;
+	if (r > 0) {
+		if (n < r) {
+			std::memcpy(buf_pptr, buf, n), buf_pptr += n;
+			return n;
+		}
+		std::memcpy(buf_pptr, buf, r), buf_pptr += r;
+		buf = static_cast<const uint8_t *>(buf) + r, n -= r;
+	}
+	size_t b = buf_eptr - buf_gptr;
+	if (b > 0 && (buf_gptr += sink.write(buf_gptr, b)) < buf_eptr) {
+		return r;
+	}
+	if (n >= static_cast<size_t>(buf_eptr - buf_bptr)) {
+		return r + sink.write(buf, n);
+	}
+	std::memcpy(buf_gptr = buf_bptr, buf, n), buf_pptr = buf_bptr + n;
+	return r + n;
+}
+
+template <typename K>
+bool BasicBufferedSinkBase<K>::flush() {
+	size_t b = buf_pptr - buf_gptr;
+	return (b == 0 || (buf_gptr += sink.write(buf_gptr, b)) == buf_pptr) && sink.flush();
+}
@@ -0,0 +1,96 @@
+#include "iobuf.h"
+
+#include <cstring>
+
+#include "memory.h"
+
+
+void BufferChain::append(std::shared_ptr<const void> owner, const void *ptr, size_t n) {
+	if (n > 0) {
+		slices.push_back({ std::move(owner), static_cast<const uint8_t *>(ptr), n });
+		total += n;
+	}
+}
+
+void BufferChain::append(Buffer &&buffer) {
+	if (buffer.grem() > 0) {
+		auto owner = std::make_shared<Buffer>(std::move(buffer));
+		this->append(owner, owner->gptr, owner->grem());
+	}
+}
+
+void BufferChain::append(std::string &&string) {
+	if (!string.empty()) {
+		auto owner = std::make_shared<std::string>(std::move(string));
+		this->append(owner, owner->data(), owner->size());
+	}
+}
+
+void BufferChain::append(const BufferChain &chain) {
+	slices.insert(slices.end(), chain.slices.begin(), chain.slices.end());
+	total += chain.total;
+}
+
+void BufferChain::append(BufferChain &&chain) {
+	if (slices.empty()) {
+		this->swap(chain);
+		return;
+	}
+	for (auto &slice : chain.slices) {
+		slices.push_back(std::move(slice));
+	}
+	total += chain.total;
+	chain.clear();
+}
+
+void BufferChain::append_copy(const void *ptr, size_t n) {
+	if (n > 0) {
+		std::shared_ptr<uint8_t[]> owner(make_buffer(n));
+		auto copy = owner.get();
+		std::memcpy(copy, ptr, n);
+		this->append(std::move(owner), copy, n);
+	}
+}
+
+BufferChain BufferChain::split(size_t n) {
+	BufferChain ret;
+	if (n >= total) {
+		this->swap(ret);
+		return ret;
+	}
+	while (n >= slices.front().size) {
+		n -= slices.front().size;
+		ret.total += slices.front().size;
+		ret.slices.push_back(std::move(slices.front()));
+		slices.pop_front();
+	}
+	if (n > 0) {
+		auto &front = slices.front();
+		ret.slices.push_back({ front.owner, front.ptr, n });
+		ret.total += n;
+		front.ptr += n, front.size -= n;
+	}
+	total -= ret.total;
+	return ret;
+}
+
+void BufferChain::consume(size_t n) noexcept {
+	if (n >= total) {
+		this->clear();
+		return;
+	}
+	total -= n;
+	while (n >= slices.front().size) {
+		n -= slices.front().size;
+		slices.pop_front();
+	}
+	slices.front().ptr += n, slices.front().size -= n;
+}
+
+size_t BufferChain::gather(Sink::BufferPointer bufs[], size_t count) const noexcept {
+	size_t i = 0;
+	for (auto itr = slices.begin(), end = slices.end(); i < count && itr != end; ++itr) {
+		bufs[i++] = { itr->ptr, itr->size };
+	}
+	return i;
+}
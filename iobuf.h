@@ -0,0 +1,74 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "buffer.h"
+#include "io.h"
+
+
+/**
+ * @brief A sequence of reference-counted, immutable byte slices.
+ *
+ * Appending, splitting, and copying a chain only manipulates slice descriptors; the bytes themselves are never copied
+ * (except by @ref append_copy) and are freed when the last slice referring to them is discarded.
+ */
+class BufferChain {
+
+public:
+	struct Slice {
+		std::shared_ptr<const void> owner;
+		const uint8_t *ptr;
+		size_t size;
+	};
+
+	typedef std::deque<Slice>::const_iterator const_iterator;
+
+private:
+	std::deque<Slice> slices;
+	size_t total;
+
+public:
+	// std::deque allocates even when empty, so neither default construction nor move construction is noexcept
+	BufferChain() : total() { }
+	BufferChain(const BufferChain &) = default;
+	BufferChain & operator = (const BufferChain &) = default;
+	BufferChain(BufferChain &&move) : slices(std::move(move.slices)), total(move.total) { move.total = 0; }
+	BufferChain & operator = (BufferChain &&move) noexcept { return this->swap(move), *this; }
+	void swap(BufferChain &other) noexcept { using std::swap; swap(slices, other.slices), swap(total, other.total); }
+	friend void swap(BufferChain &lhs, BufferChain &rhs) noexcept { lhs.swap(rhs); }
+
+public:
+	size_t _pure size() const noexcept { return total; }
+	bool _pure empty() const noexcept { return total == 0; }
+	size_t _pure slice_count() const noexcept { return slices.size(); }
+	const_iterator _pure begin() const noexcept { return slices.begin(); }
+	const_iterator _pure end() const noexcept { return slices.end(); }
+
+	// appends a slice of memory that is kept alive by the given owner
+	void append(std::shared_ptr<const void> owner, const void *ptr, size_t n);
+
+	// takes ownership of the unread portion of the given buffer
+	void append(Buffer &&buffer);
+	void append(std::string &&string);
+
+	void append(const BufferChain &chain);
+	void append(BufferChain &&chain);
+
+	void append_copy(const void *ptr, size_t n);
+
+	// removes the first n bytes and returns them as a new chain
+	BufferChain split(size_t n);
+
+	void consume(size_t n) noexcept;
+	void clear() noexcept { slices.clear(), total = 0; }
+
+	/**
+	 * @brief Fills the given array with pointers to the leading slices of the chain.
+	 *
+	 * @return the number of elements of \p bufs that were filled, at most \p count.
+	 */
+	size_t gather(Sink::BufferPointer bufs[], size_t count) const noexcept;
+
+};
@@ -0,0 +1,694 @@
+#include "json_binary.h"
+
+#include <cfloat>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+#include "base64.h"
+#include "codec.h"
+#include "json_doc.h"
+
+
+namespace json {
+
+// writes a type byte followed by the given number in width bytes, big-endian, and returns the length of the head
+static size_t encode_head(uint8_t (&head)[9], uint8_t type, size_t width, uint64_t n) noexcept {
+	head[0] = type;
+	for (size_t i = width; i > 0; --i, n >>= 8) {
+		head[i] = static_cast<uint8_t>(n);
+	}
+	return 1 + width;
+}
+
+// the head of a CBOR data item of the given major type, in which n is the value or the length
+static size_t encode_cbor_head(uint8_t (&head)[9], unsigned major, uint64_t n) noexcept {
+	if (n < 24) {
+		return encode_head(head, static_cast<uint8_t>(major << 5 | n), 0, n);
+	}
+	size_t width = n <= UINT8_MAX ? 1 : n <= UINT16_MAX ? 2 : n <= UINT32_MAX ? 4 : 8;
+	return encode_head(head, static_cast<uint8_t>(major << 5 | 24 + _ctz(width)), width, n);
+}
+
+// the head of a MessagePack string, array, or map, the types of which for 8, 16, and 32-bit lengths are consecutive
+static size_t encode_msgpack_head(uint8_t (&head)[9], uint8_t fix, uint64_t fix_limit, bool has_8bit, uint8_t type16, uint64_t n) {
+	if (n < fix_limit) {
+		return encode_head(head, static_cast<uint8_t>(fix | n), 0, n);
+	}
+	if (has_8bit && n <= UINT8_MAX) {
+		return encode_head(head, static_cast<uint8_t>(type16 - 1), 1, n);
+	}
+	if (n <= UINT16_MAX) {
+		return encode_head(head, type16, 2, n);
+	}
+	if (n <= UINT32_MAX) {
+		return encode_head(head, static_cast<uint8_t>(type16 + 1), 4, n);
+	}
+	throw std::length_error("too long for MessagePack");
+}
+
+
+bool BinaryWriter::start_object() {
+	this->begin_value();
+	frames.push_back({ buffer.ppos(), 0, true });
+	uint8_t placeholder = 0;
+	this->append(&placeholder, 1);
+	return true;
+}
+
+bool BinaryWriter::key(std::string_view key) {
+	++frames.back().count;
+	this->put_string(key);
+	return true;
+}
+
+bool BinaryWriter::start_array() {
+	this->begin_value();
+	frames.push_back({ buffer.ppos(), 0, false });
+	uint8_t placeholder = 0;
+	this->append(&placeholder, 1);
+	return true;
+}
+
+bool BinaryWriter::string(std::string_view string) {
+	this->begin_value();
+	this->put_string(string);
+	return true;
+}
+
+bool BinaryWriter::integer(intmax_t integer) {
+	this->begin_value();
+	this->put_integer(integer);
+	return true;
+}
+
+bool BinaryWriter::real(double real) {
+	this->begin_value();
+	this->put_real(real);
+	return true;
+}
+
+bool BinaryWriter::number(std::string_view text, bool fractional) {
+	uint64_t integer;
+	if (!fractional && text.front() != '-' && std::from_chars(text.data(), text.data() + text.size(), integer).ec == std::errc()) {
+		this->begin_value();
+		this->put_unsigned(integer);
+		return true;
+	}
+	return Handler::number(text, fractional);
+}
+
+bool BinaryWriter::boolean(bool boolean) {
+	this->begin_value();
+	this->put_boolean(boolean);
+	return true;
+}
+
+bool BinaryWriter::null() {
+	this->begin_value();
+	this->put_null();
+	return true;
+}
+
+BinaryWriter & BinaryWriter::value(const Value &value) {
+	this->begin_value();
+	this->put_value(value);
+	return *this;
+}
+
+BinaryWriter & BinaryWriter::value(const Node &node) {
+	this->begin_value();
+	this->put_value(node);
+	return *this;
+}
+
+void BinaryWriter::flush() {
+	if (sink) {
+		if (frames.empty()) {
+			this->drain();
+		}
+		sink->flush_fully();
+	}
+}
+
+bool BinaryWriter::close(bool object) {
+	Frame frame = frames.back();
+	frames.pop_back();
+	uint8_t head[9];
+	size_t n = this->encode_container(head, object, frame.count), end = buffer.ppos();
+	if (n > 1) {
+		// widen the reserved byte by shifting the contents of the container along
+		buffer.append(head, n - 1);
+		std::memmove(buffer.bptr + frame.offset + n, buffer.bptr + frame.offset + 1, end - frame.offset - 1);
+	}
+	std::memcpy(buffer.bptr + frame.offset, head, n);
+	if (sink && frames.empty() && buffer.grem() >= flush_threshold) {
+		this->drain();
+	}
+	return true;
+}
+
+void BinaryWriter::put_value(const Value &value) {
+	uint8_t head[9];
+	if (auto object = dynamic_cast<const Object *>(&value)) {
+		this->append(head, this->encode_container(head, true, (*object)->size()));
+		for (auto &entry : **object) {
+			this->put_string(entry.first);
+			entry.second ? this->put_value(*entry.second) : this->put_null();
+		}
+	}
+	else if (auto array = dynamic_cast<const Array *>(&value)) {
+		this->append(head, this->encode_container(head, false, (*array)->size()));
+		for (auto &element : **array) {
+			element ? this->put_value(*element) : this->put_null();
+		}
+	}
+	else if (auto integer = dynamic_cast<const Integer *>(&value)) {
+		this->put_integer(**integer);
+	}
+	else if (auto real = dynamic_cast<const Real *>(&value)) {
+		this->put_real(**real);
+	}
+	else if (auto string = dynamic_cast<const String *>(&value)) {
+		this->put_string(**string);
+	}
+	else {
+		this->put_boolean(*value.as_boolean());
+	}
+}
+
+void BinaryWriter::put_value(const Node &node) {
+	uint8_t head[9];
+	switch (node.type()) {
+		case Node::NUL:
+			return this->put_null();
+		case Node::BOOLEAN:
+			return this->put_boolean(node.as_boolean());
+		case Node::INTEGER:
+			return this->put_integer(node.as_integer());
+		case Node::REAL:
+			return this->put_real(node.as_number());
+		case Node::DECIMAL: {
+			Decimal decimal = node.as_decimal();
+			if (format != BinaryFormat::CBOR) {
+				return this->put_real(static_cast<double>(decimal));
+			}
+			// tag 4 and an array of the exponent and the mantissa
+			static const uint8_t DECIMAL_FRACTION[] = { 0xC4, 0x82 };
+			this->append(DECIMAL_FRACTION, sizeof DECIMAL_FRACTION);
+			this->put_integer(-static_cast<intmax_t>(decimal.scale()));
+			return this->put_integer(decimal.mantissa());
+		}
+		case Node::STRING:
+			return this->put_string(node.as_string());
+		case Node::ARRAY: {
+			auto elements = node.as_array();
+			this->append(head, this->encode_container(head, false, elements.size()));
+			for (auto &element : elements) {
+				this->put_value(element);
+			}
+			return;
+		}
+		case Node::OBJECT: {
+			auto members = node.as_object();
+			this->append(head, this->encode_container(head, true, members.size()));
+			for (auto &member : members) {
+				this->put_string(member.key.as_string());
+				this->put_value(member.value);
+			}
+			return;
+		}
+	}
+}
+
+void BinaryWriter::put_unsigned(uint64_t integer) {
+	uint8_t head[9];
+	if (format == BinaryFormat::CBOR) {
+		return this->append(head, encode_cbor_head(head, 0, integer));
+	}
+	if (integer < 0x80) {
+		// positive fixint
+		return this->append(head, encode_head(head, static_cast<uint8_t>(integer), 0, 0));
+	}
+	size_t width = integer <= UINT8_MAX ? 1 : integer <= UINT16_MAX ? 2 : integer <= UINT32_MAX ? 4 : 8;
+	this->append(head, encode_head(head, static_cast<uint8_t>(0xCC + _ctz(width)), width, integer));
+}
+
+void BinaryWriter::put_integer(intmax_t integer) {
+	if (integer >= 0) {
+		return this->put_unsigned(static_cast<uint64_t>(integer));
+	}
+	uint8_t head[9];
+	if (format == BinaryFormat::CBOR) {
+		// a negative integer is encoded as −1 − n
+		return this->append(head, encode_cbor_head(head, 1, static_cast<uint64_t>(~integer)));
+	}
+	if (integer >= -32) {
+		// negative fixint
+		return this->append(head, encode_head(head, static_cast<uint8_t>(integer), 0, 0));
+	}
+	size_t width = integer >= INT8_MIN ? 1 : integer >= INT16_MIN ? 2 : integer >= INT32_MIN ? 4 : 8;
+	this->append(head, encode_head(head, static_cast<uint8_t>(0xD0 + _ctz(width)), width, static_cast<uint64_t>(integer)));
+}
+
+void BinaryWriter::put_real(double real) {
+	uint8_t head[9];
+	if (std::isnan(real) || std::isinf(real) || std::fabs(real) <= static_cast<double>(FLT_MAX) && static_cast<double>(static_cast<float>(real)) == real) {
+		float single = static_cast<float>(real);
+		uint32_t bits;
+		std::memcpy(&bits, &single, sizeof bits);
+		return this->append(head, encode_head(head, format == BinaryFormat::CBOR ? 0xFA : 0xCA, 4, bits));
+	}
+	uint64_t bits;
+	std::memcpy(&bits, &real, sizeof bits);
+	this->append(head, encode_head(head, format == BinaryFormat::CBOR ? 0xFB : 0xCB, 8, bits));
+}
+
+void BinaryWriter::put_string(std::string_view string) {
+	uint8_t head[9];
+	this->append(head, format == BinaryFormat::CBOR ? encode_cbor_head(head, 3, string.size()) : encode_msgpack_head(head, 0xA0, 32, true, 0xDA, string.size()));
+	this->append(string.data(), string.size());
+}
+
+void BinaryWriter::put_null() {
+	uint8_t type = format == BinaryFormat::CBOR ? 0xF6 : 0xC0;
+	this->append(&type, 1);
+}
+
+void BinaryWriter::put_boolean(bool boolean) {
+	uint8_t type = format == BinaryFormat::CBOR ? 0xF4 + boolean : 0xC2 + boolean;
+	this->append(&type, 1);
+}
+
+size_t BinaryWriter::encode_container(uint8_t (&head)[9], bool object, size_t count) const {
+	if (format == BinaryFormat::CBOR) {
+		return encode_cbor_head(head, object ? 5 : 4, count);
+	}
+	return object ? encode_msgpack_head(head, 0x80, 16, false, 0xDE, count) : encode_msgpack_head(head, 0x90, 16, false, 0xDC, count);
+}
+
+void BinaryWriter::append(const void *data, size_t n) {
+	if (sink && frames.empty() && buffer.grem() + n > flush_threshold) {
+		this->drain();
+	}
+	buffer.append(data, n);
+}
+
+void BinaryWriter::drain() {
+	sink->write_fully(buffer.gptr, buffer.grem());
+	buffer.clear();
+}
+
+
+namespace {
+
+class Decoder {
+
+private:
+	struct Frame {
+		uint64_t remaining; // items, counting keys and values separately
+		bool object;
+		bool indefinite; // whether the container ends with a break rather than a count
+		bool key; // whether the next item is a key
+	};
+
+private:
+	PeekableSource &source;
+	Handler &handler;
+	const BinaryFormat format;
+	const uint8_t *begin, *ptr, *end;
+	std::string scratch, chunks, encoded;
+	std::vector<Frame> frames;
+
+public:
+	Decoder(PeekableSource &source, Handler &handler, BinaryFormat format) noexcept : source(source), handler(handler), format(format), begin(), ptr(), end() { }
+
+public:
+	bool decode();
+
+	// consumes from the source everything that has been decoded
+	void finish() {
+		source.consume(ptr - begin);
+		begin = ptr;
+	}
+
+private:
+	void fill(size_t n);
+	uint8_t get() { return this->fill(1), *ptr++; }
+	uint64_t get(size_t width);
+	std::string_view get_bytes(size_t n);
+
+	bool cbor_item(bool key);
+	uint64_t cbor_argument(unsigned info);
+	std::string_view cbor_chunks(unsigned major);
+	bool cbor_decimal();
+	int64_t cbor_integer();
+	bool msgpack_item(bool key);
+
+	bool open(bool object, uint64_t count, bool indefinite = false);
+	bool emit_string(std::string_view string, bool key) { return key ? handler.key(string) : handler.string(string); }
+	bool emit_bytes(std::string_view bytes);
+	bool emit_unsigned(uint64_t integer);
+	bool emit_negative(uint64_t n);
+
+};
+
+bool Decoder::decode() {
+	for (;;) {
+		bool key = false;
+		if (!frames.empty()) {
+			auto &frame = frames.back();
+			if (frame.indefinite ? (this->fill(1), *ptr == 0xFF) : frame.remaining == 0) {
+				if (frame.indefinite) {
+					if (frame.object && !frame.key) {
+						throw std::ios_base::failure("map ends without a value for its last key");
+					}
+					++ptr;
+				}
+				bool object = frame.object;
+				frames.pop_back();
+				if (!(object ? handler.end_object() : handler.end_array())) {
+					return false;
+				}
+				if (frames.empty()) {
+					return true;
+				}
+				continue;
+			}
+			frame.remaining -= !frame.indefinite;
+			key = frame.object && frame.key;
+			frame.key = frame.object && !frame.key;
+		}
+		if (!(format == BinaryFormat::CBOR ? this->cbor_item(key) : this->msgpack_item(key))) {
+			return false;
+		}
+		if (frames.empty()) {
+			return true;
+		}
+	}
+}
+
+void Decoder::fill(size_t n) {
+	if (static_cast<size_t>(end - ptr) >= n) {
+		return;
+	}
+	source.consume(ptr - begin);
+	const void *window;
+	ssize_t r = source.peek(window, n);
+	if (r < 0) {
+		throw std::ios_base::failure("premature EOF");
+	}
+	if (static_cast<size_t>(r) < n) {
+		throw std::logic_error("non-blocking read in blocking context");
+	}
+	end = (begin = ptr = static_cast<const uint8_t *>(window)) + r;
+}
+
+uint64_t Decoder::get(size_t width) {
+	this->fill(width);
+	uint64_t n = 0;
+	for (size_t i = 0; i < width; ++i) {
+		n = n << 8 | *ptr++;
+	}
+	return n;
+}
+
+std::string_view Decoder::get_bytes(size_t n) {
+	if (static_cast<size_t>(end - ptr) >= n) {
+		std::string_view bytes(reinterpret_cast<const char *>(ptr), n);
+		ptr += n;
+		return bytes;
+	}
+	// the bytes straddle the end of the source's buffer
+	scratch.clear();
+	while (n > 0) {
+		this->fill(1);
+		size_t k = std::min(n, static_cast<size_t>(end - ptr));
+		scratch.append(reinterpret_cast<const char *>(ptr), k);
+		ptr += k, n -= k;
+	}
+	return scratch;
+}
+
+bool Decoder::cbor_item(bool key) {
+	uint8_t initial = this->get();
+	while (initial >> 5 == 6) {
+		if (this->cbor_argument(initial & 0x1F) == 4) {
+			if (key) {
+				throw std::ios_base::failure("expected string key");
+			}
+			return this->cbor_decimal();
+		}
+		// other tags are skipped
+		initial = this->get();
+	}
+	unsigned major = initial >> 5, info = initial & 0x1F;
+	if (key && major != 3) {
+		throw std::ios_base::failure("expected string key");
+	}
+	switch (major) {
+		case 0:
+			return this->emit_unsigned(this->cbor_argument(info));
+		case 1:
+			return this->emit_negative(this->cbor_argument(info));
+		case 2:
+			return this->emit_bytes(info == 31 ? this->cbor_chunks(major) : this->get_bytes(this->cbor_argument(info)));
+		case 3:
+			return this->emit_string(info == 31 ? this->cbor_chunks(major) : this->get_bytes(this->cbor_argument(info)), key);
+		case 4:
+			return info == 31 ? this->open(false, 0, true) : this->open(false, this->cbor_argument(info));
+		case 5:
+			return info == 31 ? this->open(true, 0, true) : this->open(true, this->cbor_argument(info));
+	}
+	switch (info) {
+		case 20:
+			return handler.boolean(false);
+		case 21:
+			return handler.boolean(true);
+		case 22: // null
+		case 23: // undefined
+			return handler.null();
+		case 25: {
+			auto half = static_cast<unsigned>(this->get(2));
+			unsigned exponent = half >> 10 & 0x1F, fraction = half & 0x3FF;
+			double real = exponent == 0 ? std::ldexp(fraction, -24) : exponent < 31 ? std::ldexp(fraction | 0x400, static_cast<int>(exponent) - 25) : fraction == 0 ? HUGE_VAL : std::nan("");
+			return handler.real(half & 0x8000 ? -real : real);
+		}
+		case 26: {
+			auto bits = static_cast<uint32_t>(this->get(4));
+			float single;
+			std::memcpy(&single, &bits, sizeof single);
+			return handler.real(single);
+		}
+		case 27: {
+			uint64_t bits = this->get(8);
+			double real;
+			std::memcpy(&real, &bits, sizeof real);
+			return handler.real(real);
+		}
+		case 31:
+			throw std::ios_base::failure("unexpected break");
+	}
+	throw std::ios_base::failure("unsupported simple value");
+}
+
+uint64_t Decoder::cbor_argument(unsigned info) {
+	if (info < 24) {
+		return info;
+	}
+	if (info < 28) {
+		return this->get(size_t(1) << info - 24);
+	}
+	throw std::ios_base::failure("invalid additional information");
+}
+
+// concatenates the chunks of an indefinite-length string
+std::string_view Decoder::cbor_chunks(unsigned major) {
+	chunks.clear();
+	for (uint8_t initial; (initial = this->get()) != 0xFF;) {
+		if (initial >> 5 != major || (initial & 0x1F) == 31) {
+			throw std::ios_base::failure("invalid chunk of indefinite-length string");
+		}
+		chunks.append(this->get_bytes(this->cbor_argument(initial & 0x1F)));
+	}
+	return chunks;
+}
+
+// a decimal fraction is an array of an exponent and a mantissa, which is passed on as the text of a number
+bool Decoder::cbor_decimal() {
+	if (this->get() != 0x82) {
+		throw std::ios_base::failure("invalid decimal fraction");
+	}
+	int64_t exponent = this->cbor_integer(), mantissa = this->cbor_integer();
+	// at most 20 characters each
+	char text[48], *p = std::to_chars(text, text + 20, mantissa).ptr;
+	*p++ = 'e';
+	p = std::to_chars(p, text + sizeof text, exponent).ptr;
+	return handler.number({ text, static_cast<size_t>(p - text) }, true);
+}
+
+int64_t Decoder::cbor_integer() {
+	uint8_t initial = this->get();
+	if (initial >> 5 > 1) {
+		throw std::ios_base::failure("invalid decimal fraction");
+	}
+	uint64_t n = this->cbor_argument(initial & 0x1F);
+	if (n > INT64_MAX) {
+		throw std::ios_base::failure("decimal fraction out of range");
+	}
+	return initial >> 5 == 0 ? static_cast<int64_t>(n) : -1 - static_cast<int64_t>(n);
+}
+
+bool Decoder::msgpack_item(bool key) {
+	uint8_t type = this->get();
+	if (key && !(type >= 0xA0 && type <= 0xBF || type >= 0xD9 && type <= 0xDB)) {
+		throw std::ios_base::failure("expected string key");
+	}
+	if (type < 0x80) {
+		// positive fixint
+		return handler.integer(type);
+	}
+	if (type < 0x90) {
+		return this->open(true, type & 0x0F);
+	}
+	if (type < 0xA0) {
+		return this->open(false, type & 0x0F);
+	}
+	if (type < 0xC0) {
+		return this->emit_string(this->get_bytes(type & 0x1F), key);
+	}
+	if (type >= 0xE0) {
+		// negative fixint
+		return handler.integer(static_cast<int8_t>(type));
+	}
+	switch (type) {
+		case 0xC0:
+			return handler.null();
+		case 0xC2:
+			return handler.boolean(false);
+		case 0xC3:
+			return handler.boolean(true);
+		case 0xC4: case 0xC5: case 0xC6: // bin 8, 16, 32
+			return this->emit_bytes(this->get_bytes(this->get(size_t(1) << type - 0xC4)));
+		case 0xCA: {
+			auto bits = static_cast<uint32_t>(this->get(4));
+			float single;
+			std::memcpy(&single, &bits, sizeof single);
+			return handler.real(single);
+		}
+		case 0xCB: {
+			uint64_t bits = this->get(8);
+			double real;
+			std::memcpy(&real, &bits, sizeof real);
+			return handler.real(real);
+		}
+		case 0xCC: case 0xCD: case 0xCE: case 0xCF: // uint 8, 16, 32, 64
+			return this->emit_unsigned(this->get(size_t(1) << type - 0xCC));
+		case 0xD0: case 0xD1: case 0xD2: case 0xD3: { // int 8, 16, 32, 64
+			size_t width = size_t(1) << type - 0xD0;
+			// sign-extend from the width of the encoding
+			unsigned shift = static_cast<unsigned>(64 - width * 8);
+			return handler.integer(static_cast<int64_t>(this->get(width) << shift) >> shift);
+		}
+		case 0xD9: case 0xDA: case 0xDB: // str 8, 16, 32
+			return this->emit_string(this->get_bytes(this->get(size_t(1) << type - 0xD9)), key);
+		case 0xDC: case 0xDD: // array 16, 32
+			return this->open(false, this->get(size_t(2) << type - 0xDC));
+		case 0xDE: case 0xDF: // map 16, 32
+			return this->open(true, this->get(size_t(2) << type - 0xDE));
+	}
+	throw std::ios_base::failure("unsupported MessagePack type");
+}
+
+bool Decoder::open(bool object, uint64_t count, bool indefinite) {
+	if (frames.size() == MAX_DEPTH) {
+		throw std::ios_base::failure("nesting too deep");
+	}
+	if (object && count > UINT64_MAX / 2) {
+		throw std::ios_base::failure("map too large");
+	}
+	frames.push_back({ object ? count * 2 : count, object, indefinite, object });
+	return object ? handler.start_object() : handler.start_array();
+}
+
+bool Decoder::emit_bytes(std::string_view bytes) {
+	encoded.clear();
+	return handler.string(transcode<Base64Encoder>(encoded, bytes));
+}
+
+bool Decoder::emit_unsigned(uint64_t integer) {
+	if (integer <= INTMAX_MAX) {
+		return handler.integer(static_cast<intmax_t>(integer));
+	}
+	char text[24], *p = std::to_chars(text, text + sizeof text, integer).ptr;
+	return handler.number({ text, static_cast<size_t>(p - text) }, false);
+}
+
+// passes the integer −1 − n
+bool Decoder::emit_negative(uint64_t n) {
+	if (n <= INTMAX_MAX) {
+		return handler.integer(-1 - static_cast<intmax_t>(n));
+	}
+	// the magnitude may not fit in 64 bits
+	auto magnitude = static_cast<unsigned __int128>(n) + 1;
+	char text[24], *p = text + sizeof text;
+	do {
+		*--p = static_cast<char>('0' + static_cast<unsigned>(magnitude % 10));
+	} while (magnitude /= 10);
+	*--p = '-';
+	return handler.number({ p, static_cast<size_t>(text + sizeof text - p) }, false);
+}
+
+} // namespace
+
+
+bool decode(PeekableSource &source, Handler &handler, BinaryFormat format) {
+	Decoder decoder(source, handler, format);
+	bool ret = decoder.decode();
+	decoder.finish();
+	return ret;
+}
+
+bool decode(std::string_view data, Handler &handler, BinaryFormat format) {
+	MemorySource source(data.data(), data.size());
+	if (!decode(source, handler, format)) {
+		return false;
+	}
+	if (source.grem() > 0) {
+		throw std::ios_base::failure("unexpected data after item");
+	}
+	return true;
+}
+
+
+bool ValueBuilder::start_object() {
+	auto object = std::make_shared<Object>();
+	auto raw = object.get();
+	this->add(object);
+	frames.push_back({ std::move(object), raw, nullptr });
+	return true;
+}
+
+bool ValueBuilder::start_array() {
+	auto array = std::make_shared<Array>();
+	auto raw = array.get();
+	this->add(array);
+	frames.push_back({ std::move(array), nullptr, raw });
+	return true;
+}
+
+void ValueBuilder::add(ValuePtr value) {
+	if (frames.empty()) {
+		root = std::move(value);
+	}
+	else if (auto object = frames.back().object) {
+		object->insert(std::move(pending_key), std::move(value));
+	}
+	else {
+		frames.back().array->insert(std::move(value));
+	}
+}
+
+} // namespace json
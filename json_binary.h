@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "buffer.h"
+#include "compiler.h"
+#include "io.h"
+#include "json.h"
+#include "json_sax.h"
+
+namespace json {
+
+class Node;
+
+
+enum class BinaryFormat {
+	CBOR, // RFC 8949
+	MSGPACK, // MessagePack
+};
+
+
+/**
+ * @brief Encodes JSON in CBOR or MessagePack, receiving the events of a streaming parse or whole values.
+ *
+ * As a @ref Handler, a writer transcodes JSON text to the binary format without building a DOM, e.g.,
+ * <tt>json::parse(text, writer)</tt>, and its callbacks can be called directly to build a message. Objects and arrays
+ * are written with definite lengths: a container opened by an event is given a one-byte header, which is widened in
+ * place when the container closes if its length does not fit. Values of known size are written with their final
+ * headers.
+ *
+ * Integers take their shortest encoding, and reals are written in single precision if that is exact. Numbers beyond
+ * \c intmax_t that fit in 64 bits unsigned are written as integers. In CBOR, a DECIMAL node is written as a decimal
+ * fraction (tag 4); MessagePack has no such type, so it is written as a real.
+ */
+class BinaryWriter : public Handler {
+
+private:
+	struct Frame {
+		size_t offset; // of the reserved header byte
+		size_t count; // of elements, or of members
+		bool object;
+	};
+
+private:
+	const BinaryFormat format;
+	Buffer own_buffer;
+	Buffer &buffer;
+	Sink * const sink;
+	const size_t flush_threshold;
+	std::vector<Frame> frames;
+
+public:
+	// appends to the given buffer, which grows as needed
+	explicit BinaryWriter(Buffer &buffer, BinaryFormat format = BinaryFormat::CBOR) noexcept : format(format), buffer(buffer), sink(), flush_threshold(SIZE_MAX) { }
+
+	/**
+	 * @brief Writes to the given blocking sink whenever more than \p buffer_size bytes have accumulated, and upon flush.
+	 *
+	 * Output is held back while any container opened by an event is still open, as its header may yet change.
+	 */
+	explicit BinaryWriter(Sink &sink, BinaryFormat format = BinaryFormat::CBOR, size_t buffer_size = 1 << 16) : format(format), own_buffer(buffer_size), buffer(own_buffer), sink(&sink), flush_threshold(buffer_size) { }
+
+private:
+	BinaryWriter(const BinaryWriter &) = delete;
+	BinaryWriter & operator = (const BinaryWriter &) = delete;
+
+public:
+	bool start_object() override;
+	bool key(std::string_view key) override;
+	bool end_object() override { return this->close(true); }
+	bool start_array() override;
+	bool end_array() override { return this->close(false); }
+	bool string(std::string_view string) override;
+	bool integer(intmax_t integer) override;
+	bool real(double real) override;
+	bool number(std::string_view text, bool fractional) override;
+	bool boolean(bool boolean) override;
+	bool null() override;
+
+	BinaryWriter & value(const Value &value);
+	BinaryWriter & value(const ValuePtr &value) { return value ? this->value(*value) : (this->null(), *this); }
+	BinaryWriter & value(const Node &node);
+
+	// writes all buffered output to the sink, if any, and flushes it
+	void flush();
+
+private:
+	bool close(bool object);
+	void begin_value() noexcept {
+		if (!frames.empty() && !frames.back().object) {
+			++frames.back().count;
+		}
+	}
+	void put_value(const Value &value);
+	void put_value(const Node &node);
+	void put_unsigned(uint64_t integer);
+	void put_integer(intmax_t integer);
+	void put_real(double real);
+	void put_string(std::string_view string);
+	void put_null();
+	void put_boolean(bool boolean);
+	size_t encode_container(uint8_t (&head)[9], bool object, size_t count) const;
+	void append(const void *data, size_t n);
+	void drain();
+
+};
+
+
+/**
+ * @brief Decodes one CBOR or MessagePack data item from a source and passes its events to the handler.
+ *
+ * Consumes exactly the bytes of the item, so subsequent items remain in the source; the source must be blocking.
+ * Strings that lie wholly within the source's buffer are passed to the handler in place.
+ *
+ * CBOR tags are skipped, but for decimal fractions (tag 4), which are passed to @ref Handler::number as text;
+ * indefinite-length strings and containers are accepted; undefined is decoded as null. Byte strings, which JSON cannot
+ * represent, are passed as strings of their base64 encoding. Integers that do not fit in \c intmax_t are passed to
+ * @ref Handler::number as text. Map keys must be text strings.
+ *
+ * Throws \c std::ios_base::failure on malformed input, an item with no JSON equivalent, such as a MessagePack extension
+ * type, or nesting deeper than \ref MAX_DEPTH.
+ *
+ * @return whether the decode ran to completion, i.e., \c false if the handler stopped it.
+ */
+bool decode(PeekableSource &source, Handler &handler, BinaryFormat format);
+
+// as above, from memory, which must contain nothing else but the item
+bool decode(std::string_view data, Handler &handler, BinaryFormat format);
+
+
+/**
+ * @brief Builds a @ref Value from the events of a streaming parse.
+ *
+ * Nulls become null pointers, as in the values that <tt>operator >></tt> parses. Of duplicate keys, the first wins.
+ */
+class ValueBuilder : public Handler {
+
+private:
+	struct Frame {
+		ValuePtr value; // which is held here too in case a duplicate key has discarded it
+		Object *object;
+		Array *array;
+	};
+
+private:
+	ValuePtr root;
+	std::vector<Frame> frames;
+	std::string pending_key;
+
+public:
+	bool start_object() override;
+	bool key(std::string_view key) override { return pending_key.assign(key), true; }
+	bool end_object() override { return frames.pop_back(), true; }
+	bool start_array() override;
+	bool end_array() override { return frames.pop_back(), true; }
+	bool string(std::string_view string) override { return this->add(std::make_shared<String>(std::string(string))), true; }
+	bool integer(intmax_t integer) override { return this->add(std::make_shared<Integer>(integer)), true; }
+	bool real(double real) override { return this->add(std::make_shared<Real>(real)), true; }
+	bool boolean(bool boolean) override { return this->add(std::make_shared<Boolean>(boolean)), true; }
+	bool null() override { return this->add(nullptr), true; }
+
+	// returns the value that has been built and prepares to build another
+	ValuePtr release() noexcept { return std::move(root); }
+
+private:
+	void add(ValuePtr value);
+
+};
+
+
+template <BinaryFormat F, typename T>
+struct _binary {
+	T x;
+};
+
+static inline _binary<BinaryFormat::CBOR, const Value &> cbor(const Value &value) { return { value }; }
+static inline _binary<BinaryFormat::CBOR, const Node &> cbor(const Node &node) { return { node }; }
+static inline _binary<BinaryFormat::CBOR, ValuePtr &> cbor(ValuePtr &value) { return { value }; }
+
+static inline _binary<BinaryFormat::MSGPACK, const Value &> msgpack(const Value &value) { return { value }; }
+static inline _binary<BinaryFormat::MSGPACK, const Node &> msgpack(const Node &node) { return { node }; }
+static inline _binary<BinaryFormat::MSGPACK, ValuePtr &> msgpack(ValuePtr &value) { return { value }; }
+
+// writes a value in the binary format, e.g., sink << json::cbor(value)
+template <BinaryFormat F, typename T>
+static inline Sink & operator << (Sink &sink, _binary<F, T> binary) {
+	Buffer buffer;
+	BinaryWriter(buffer, F).value(binary.x);
+	sink.write_fully(buffer.gptr, buffer.grem());
+	return sink;
+}
+
+// reads a value in the binary format, e.g., source >> json::cbor(value)
+template <BinaryFormat F>
+static inline PeekableSource & operator >> (PeekableSource &source, _binary<F, ValuePtr &> binary) {
+	ValueBuilder builder;
+	decode(source, builder, F);
+	binary.x = builder.release();
+	return source;
+}
+
+} // namespace json
@@ -0,0 +1,129 @@
+#include "json_bind.h"
+
+#include <cstring>
+
+#include "json_sax.h"
+#include "json_view.h"
+
+
+namespace json {
+
+void Cursor::expect(char c) {
+	if (!this->consume(c)) {
+		switch (c) {
+			case '{':
+				throw std::ios_base::failure("expected object");
+			case '[':
+				throw std::ios_base::failure("expected array");
+			case ':':
+				throw std::ios_base::failure("expected colon");
+			case ',':
+				throw std::ios_base::failure("expected comma");
+			case '}':
+				throw std::ios_base::failure("expected comma or closing brace");
+			case ']':
+				throw std::ios_base::failure("expected comma or closing bracket");
+			default:
+				throw std::ios_base::failure(std::string("expected ") + c);
+		}
+	}
+}
+
+bool Cursor::consume(char c) {
+	this->skip_ws();
+	if (p < end && *p == c) {
+		++p;
+		return true;
+	}
+	return false;
+}
+
+bool Cursor::consume_null() {
+	this->skip_ws();
+	if (end - p >= 4 && std::memcmp(p, "null", 4) == 0) {
+		p += 4;
+		return true;
+	}
+	return false;
+}
+
+bool Cursor::boolean() {
+	this->skip_ws();
+	if (end - p >= 4 && std::memcmp(p, "true", 4) == 0) {
+		p += 4;
+		return true;
+	}
+	if (end - p >= 5 && std::memcmp(p, "false", 5) == 0) {
+		p += 5;
+		return false;
+	}
+	throw std::ios_base::failure("expected boolean");
+}
+
+std::string_view Cursor::number(bool &fractional) {
+	this->skip_ws();
+	const char *q;
+	if (p == end || !(q = scan_number(p, end, fractional))) {
+		throw std::ios_base::failure("expected number");
+	}
+	std::string_view text(p, q - p);
+	p = q;
+	return text;
+}
+
+std::string_view Cursor::string() {
+	this->skip_ws();
+	if (p == end || *p != '"') {
+		throw std::ios_base::failure("expected string");
+	}
+	auto start = ++p;
+	bool escaped = false;
+	for (;; ++p) {
+		if (p == end) {
+			throw std::ios_base::failure("unterminated string");
+		}
+		if (*p == '"') {
+			break;
+		}
+		if (*p == '\\') {
+			escaped = true;
+			if (++p == end) {
+				throw std::ios_base::failure("unterminated string");
+			}
+		}
+		else if (static_cast<unsigned char>(*p) < 0x20) {
+			throw std::ios_base::failure("control character in string");
+		}
+	}
+	std::string_view contents(start, p++ - start);
+	if (!escaped) {
+		return contents;
+	}
+	scratch.clear();
+	unescape(scratch, contents);
+	return scratch;
+}
+
+void Cursor::skip() {
+	this->skip_ws();
+	auto raw = View(std::string_view(p, end - p)).raw();
+	if (raw.empty()) {
+		throw std::ios_base::failure("premature EOF");
+	}
+	p = raw.data() + raw.size();
+}
+
+void Cursor::finish() {
+	this->skip_ws();
+	if (p != end) {
+		throw std::ios_base::failure("unexpected data after JSON value");
+	}
+}
+
+void Cursor::skip_ws() noexcept {
+	while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+		++p;
+	}
+}
+
+} // namespace json
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <ios>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "compiler.h"
+#include "decimal.h"
+#include "json_writer.h"
+#include "pp.h"
+
+
+/**
+ * @brief Binds the listed members of a struct to the members of a JSON object with the same names.
+ *
+ * Use at global scope, e.g.:
+ *
+ *     struct Order { std::string symbol; int64_t quantity; double price; std::optional<bool> post_only; };
+ *     JSON_BINDING(Order, (symbol) (quantity) (price) (post_only))
+ *
+ * Members may be of arithmetic types, @ref Decimal, \c std::string, \c std::optional, \c std::vector, or \c std::array of these, or
+ * of other bound types.
+ */
+#define JSON_BINDING(T, seq) \
+	template <> \
+	struct json::Binding<T> { \
+		using type = T; \
+		static constexpr std::string_view names[] = { LIST(MAP(seq, JSON_BINDING_NAME)) }; \
+		static constexpr auto members = std::make_tuple(LIST(MAP(seq, JSON_BINDING_MEMBER))); \
+	};
+#define JSON_BINDING_NAME(m) #m
+#define JSON_BINDING_MEMBER(m) &type::m
+
+
+namespace json {
+
+template <typename T>
+struct Binding;
+
+template <typename T, typename = void>
+struct is_bound : std::false_type { };
+
+template <typename T>
+struct is_bound<T, std::void_t<decltype(Binding<T>::names)>> : std::true_type { };
+
+
+/**
+ * @brief Reads JSON text token by token, for the generated parsers of bound types.
+ *
+ * The values of unbound members are skipped as @ref View skips them, i.e., without full validation.
+ */
+class Cursor {
+
+private:
+	const char *p;
+	const char * const end;
+	std::string scratch;
+
+public:
+	explicit Cursor(std::string_view json) noexcept : p(json.data()), end(json.data() + json.size()) { }
+
+public:
+	// consumes the given character, which must be next after any whitespace
+	void expect(char c);
+	// consumes the given character if it is next after any whitespace
+	bool consume(char c);
+	// consumes null if it is next after any whitespace
+	bool consume_null();
+
+	bool boolean();
+	// returns the text of a number, which is valid until the next call
+	std::string_view number(bool &fractional);
+	// returns a string in place if it has no escape sequences, or else its decoding, which is valid until the next call
+	std::string_view string();
+	void skip();
+
+	// throws unless nothing but whitespace remains
+	void finish();
+
+private:
+	void skip_ws() noexcept;
+
+};
+
+
+// a perfect hash table of the names of the members of a bound type, found at compile time
+template <size_t Size>
+struct KeyTable {
+	uint64_t seed;
+	std::array<uint8_t, Size> slots; // indices of names, or UINT8_MAX
+};
+
+constexpr uint64_t key_hash(std::string_view key, uint64_t seed) noexcept {
+	uint64_t h = 0xCBF29CE484222325 ^ seed * 0x9E3779B97F4A7C15;
+	for (char c : key) {
+		h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3;
+	}
+	return h ^ h >> 32;
+}
+
+// large enough that about half of all seeds give no collisions
+constexpr size_t key_table_size(size_t n) noexcept {
+	size_t size = 2;
+	while (size < n * n / 2 || size < n * 2) {
+		size <<= 1;
+	}
+	return size;
+}
+
+template <size_t Size, size_t N>
+constexpr KeyTable<Size> make_key_table(const std::string_view (&names)[N]) {
+	static_assert(N < UINT8_MAX, "too many members");
+	for (size_t i = 0; i < N; ++i) {
+		for (size_t j = 0; j < i; ++j) {
+			if (names[i] == names[j]) {
+				throw std::logic_error("duplicate member name");
+			}
+		}
+	}
+	for (uint64_t seed = 0;; ++seed) {
+		KeyTable<Size> table { seed, { } };
+		for (auto &slot : table.slots) {
+			slot = UINT8_MAX;
+		}
+		size_t i = 0;
+		for (; i < N; ++i) {
+			auto &slot = table.slots[key_hash(names[i], seed) & Size - 1];
+			if (slot != UINT8_MAX) {
+				break;
+			}
+			slot = static_cast<uint8_t>(i);
+		}
+		if (i == N) {
+			return table;
+		}
+	}
+}
+
+
+template <typename T>
+struct is_optional : std::false_type { };
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type { };
+
+template <typename T>
+struct is_vector : std::false_type { };
+template <typename T, typename A>
+struct is_vector<std::vector<T, A>> : std::true_type { };
+
+template <typename T>
+struct is_std_array : std::false_type { };
+template <typename T, size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type { };
+
+template <typename T>
+void read_value(Cursor &cursor, T &value);
+
+template <typename T, size_t I>
+void read_member(Cursor &cursor, T &object) {
+	read_value(cursor, object.*std::get<I>(Binding<T>::members));
+}
+
+template <typename T, size_t... I>
+void read_object(Cursor &cursor, T &object, std::index_sequence<I...>) {
+	using B = Binding<T>;
+	constexpr size_t Size = key_table_size(sizeof...(I));
+	static constexpr KeyTable<Size> table = make_key_table<Size>(B::names);
+	static constexpr void (*readers[])(Cursor &, T &) = { &read_member<T, I>... };
+	cursor.expect('{');
+	if (cursor.consume('}')) {
+		return;
+	}
+	do {
+		auto key = cursor.string();
+		size_t i = table.slots[key_hash(key, table.seed) & Size - 1];
+		// the key must be compared before the cursor moves on, as it may be in the cursor's scratch space
+		bool known = i != UINT8_MAX && B::names[i] == key;
+		cursor.expect(':');
+		known ? readers[i](cursor, object) : cursor.skip();
+	} while (cursor.consume(','));
+	cursor.expect('}');
+}
+
+template <typename T>
+void read_value(Cursor &cursor, T &value) {
+	if constexpr (std::is_same_v<T, bool>) {
+		value = cursor.boolean();
+	}
+	else if constexpr (std::is_arithmetic_v<T>) {
+		bool fractional;
+		auto text = cursor.number(fractional);
+		if (std::is_integral_v<T> && fractional) {
+			throw std::ios_base::failure("expected integer");
+		}
+		if (std::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc()) {
+			throw std::ios_base::failure("number out of range");
+		}
+	}
+	else if constexpr (std::is_same_v<T, Decimal>) {
+		bool fractional;
+		auto text = cursor.number(fractional);
+		if (::from_chars(text.data(), text.data() + text.size(), value).ec != std::errc()) {
+			throw std::ios_base::failure("number out of range");
+		}
+	}
+	else if constexpr (std::is_same_v<T, std::string>) {
+		value = cursor.string();
+	}
+	else if constexpr (is_optional<T>::value) {
+		if (cursor.consume_null()) {
+			value.reset();
+		}
+		else {
+			read_value(cursor, value.emplace());
+		}
+	}
+	else if constexpr (is_vector<T>::value) {
+		value.clear();
+		cursor.expect('[');
+		if (!cursor.consume(']')) {
+			do {
+				read_value(cursor, value.emplace_back());
+			} while (cursor.consume(','));
+			cursor.expect(']');
+		}
+	}
+	else if constexpr (is_std_array<T>::value) {
+		cursor.expect('[');
+		for (size_t i = 0; i < value.size(); ++i) {
+			if (i > 0) {
+				cursor.expect(',');
+			}
+			read_value(cursor, value[i]);
+		}
+		cursor.expect(']');
+	}
+	else {
+		static_assert(is_bound<T>::value, "type is not bound; see JSON_BINDING");
+		read_object(cursor, value, std::make_index_sequence<std::size(Binding<T>::names)>());
+	}
+}
+
+template <typename T>
+void write_value(Writer &writer, const T &value);
+
+template <typename T, size_t... I>
+void write_object(Writer &writer, const T &object, std::index_sequence<I...>) {
+	using B = Binding<T>;
+	writer.begin_object();
+	auto write_member = [&](std::string_view name, auto &member) {
+		if constexpr (is_optional<std::decay_t<decltype(member)>>::value) {
+			if (!member) {
+				return;
+			}
+		}
+		writer.key(name);
+		write_value(writer, member);
+	};
+	(write_member(B::names[I], object.*std::get<I>(B::members)), ...);
+	writer.end_object();
+}
+
+template <typename T>
+void write_value(Writer &writer, const T &value) {
+	if constexpr (std::is_arithmetic_v<T> || std::is_same_v<T, Decimal>) {
+		writer.value(value);
+	}
+	else if constexpr (std::is_same_v<T, std::string>) {
+		writer.value(std::string_view(value));
+	}
+	else if constexpr (is_optional<T>::value) {
+		value ? write_value(writer, *value) : void(writer.null());
+	}
+	else if constexpr (is_vector<T>::value || is_std_array<T>::value) {
+		writer.begin_array();
+		for (auto &element : value) {
+			write_value(writer, element);
+		}
+		writer.end_array();
+	}
+	else {
+		static_assert(is_bound<T>::value, "type is not bound; see JSON_BINDING");
+		write_object(writer, value, std::make_index_sequence<std::size(Binding<T>::names)>());
+	}
+}
+
+
+/**
+ * @brief Parses JSON text, which must contain nothing else but whitespace, into a value of a bound type.
+ *
+ * Members absent from the text are left as they were, and members of the text that are not bound are skipped.
+ * Throws \c std::ios_base::failure on malformed text or a value that does not fit its member.
+ */
+template <typename T>
+void read(std::string_view json, T &value) {
+	Cursor cursor(json);
+	read_value(cursor, value);
+	cursor.finish();
+}
+
+// serializes a value of a bound type, omitting members that are empty optionals
+template <typename T>
+Writer & write(Writer &writer, const T &value) {
+	write_value(writer, value);
+	return writer;
+}
+
+} // namespace json
@@ -0,0 +1,249 @@
+#include "json_doc.h"
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "json_binary.h"
+#include "json_sax.h"
+
+
+namespace json {
+
+static uint32_t check_count(size_t count) {
+	if (count > UINT32_MAX) {
+		throw std::length_error("JSON value too large");
+	}
+	return static_cast<uint32_t>(count);
+}
+
+Node::Node(std::string_view string) : type_(STRING), count(check_count(string.size())), string(string.data()) {
+}
+
+Node::Node(const Node *elements, size_t count) : type_(ARRAY), count(check_count(count)), elements(elements) {
+}
+
+Node::Node(const Member *members, size_t count) : type_(OBJECT), count(check_count(count)), members(members) {
+}
+
+bool Node::as_boolean() const {
+	if (type_ != BOOLEAN) {
+		throw std::invalid_argument("expected boolean");
+	}
+	return boolean;
+}
+
+intmax_t Node::as_integer() const {
+	if (type_ != INTEGER) {
+		throw std::invalid_argument("expected integer");
+	}
+	return integer;
+}
+
+double Node::as_number() const {
+	if (type_ == INTEGER) {
+		return static_cast<double>(integer);
+	}
+	if (type_ == DECIMAL) {
+		return static_cast<double>(this->as_decimal());
+	}
+	if (type_ != REAL) {
+		throw std::invalid_argument("expected number");
+	}
+	return real;
+}
+
+Decimal Node::as_decimal() const {
+	if (type_ == INTEGER) {
+		return { integer };
+	}
+	if (type_ != DECIMAL) {
+		throw std::invalid_argument("expected decimal");
+	}
+	return { integer, count };
+}
+
+std::string_view Node::as_string() const {
+	if (type_ != STRING) {
+		throw std::invalid_argument("expected string");
+	}
+	return { string, count };
+}
+
+Range<Node> Node::as_array() const {
+	if (type_ != ARRAY) {
+		throw std::invalid_argument("expected array");
+	}
+	return { elements, elements + count };
+}
+
+Range<Member> Node::as_object() const {
+	if (type_ != OBJECT) {
+		throw std::invalid_argument("expected object");
+	}
+	return { members, members + count };
+}
+
+const Node * Node::find(std::string_view key) const {
+	for (auto &member : this->as_object()) {
+		if (std::string_view(member.key.string, member.key.count) == key) {
+			return &member.value;
+		}
+	}
+	return nullptr;
+}
+
+const Node & Node::get(std::string_view key) const {
+	auto ptr = this->find(key);
+	if (!ptr) {
+		throw std::invalid_argument(std::string(key) + " missing");
+	}
+	return *ptr;
+}
+
+ValuePtr Node::to_value() const {
+	switch (type_) {
+		case NUL:
+			return nullptr;
+		case BOOLEAN:
+			return std::make_shared<Boolean>(boolean);
+		case INTEGER:
+			return std::make_shared<Integer>(integer);
+		case REAL:
+			return std::make_shared<Real>(real);
+		case DECIMAL:
+			return std::make_shared<Real>(this->as_number());
+		case STRING:
+			return std::make_shared<String>(std::string(string, count));
+		case ARRAY: {
+			auto array = std::make_shared<Array>();
+			(*array)->reserve(count);
+			for (auto &element : this->as_array()) {
+				array->insert(element.to_value());
+			}
+			return array;
+		}
+		case OBJECT: {
+			auto object = std::make_shared<Object>();
+			for (auto &member : this->as_object()) {
+				object->insert(std::string(member.key.string, member.key.count), member.value.to_value());
+			}
+			return object;
+		}
+	}
+	return nullptr;
+}
+
+
+class Document::Builder : public Handler {
+
+private:
+	Document &doc;
+	const char * const input_begin, * const input_end;
+
+public:
+	Builder(Document &doc, std::string_view input) noexcept : doc(doc), input_begin(input.data()), input_end(input.data() + input.size()) { }
+
+public:
+	bool start_object() override { return this->open(); }
+	bool key(std::string_view key) override { return doc.stack.push_back(this->intern(key)), true; }
+	bool end_object() override;
+	bool start_array() override { return this->open(); }
+	bool end_array() override;
+	bool string(std::string_view string) override { return doc.stack.push_back(this->intern(string)), true; }
+	bool integer(intmax_t value) override { return doc.stack.push_back(Node(value)), true; }
+	bool real(double value) override { return doc.stack.push_back(Node(value)), true; }
+	bool number(std::string_view text, bool fractional) override;
+	bool boolean(bool value) override { return doc.stack.push_back(Node(value)), true; }
+	bool null() override { return doc.stack.emplace_back(), true; }
+
+private:
+	bool open() { return doc.frames.push_back(doc.stack.size()), true; }
+
+	// a string that lies within the input may be referenced in place; any other is only valid during the callback
+	Node intern(std::string_view string) {
+		if (string.data() >= input_begin && string.data() + string.size() <= input_end) {
+			return Node(string);
+		}
+		return Node(doc.arena.copy(string));
+	}
+
+};
+
+bool Document::Builder::number(std::string_view text, bool fractional) {
+	Decimal decimal;
+	if (fractional && doc.decimals && ::from_chars(text.data(), text.data() + text.size(), decimal).ec == std::errc()) {
+		return doc.stack.push_back(Node(decimal)), true;
+	}
+	return Handler::number(text, fractional);
+}
+
+bool Document::Builder::end_object() {
+	size_t start = doc.frames.back(), count = (doc.stack.size() - start) / 2;
+	doc.frames.pop_back();
+	auto members = doc.arena.allocate_array<Member>(count);
+	for (size_t i = 0; i < count; ++i) {
+		new (&members[i]) Member { doc.stack[start + i * 2], doc.stack[start + i * 2 + 1] };
+	}
+	doc.stack.resize(start);
+	doc.stack.push_back(Node(members, count));
+	return true;
+}
+
+bool Document::Builder::end_array() {
+	size_t start = doc.frames.back(), count = doc.stack.size() - start;
+	doc.frames.pop_back();
+	auto elements = doc.arena.allocate_array<Node>(count);
+	std::uninitialized_copy(doc.stack.begin() + start, doc.stack.end(), elements);
+	doc.stack.resize(start);
+	doc.stack.push_back(Node(elements, count));
+	return true;
+}
+
+
+const Node & Document::parse(std::string_view json) {
+	root_ = Node();
+	arena.clear(), stack.clear(), frames.clear();
+	Builder builder(*this, json);
+	index.build(json);
+	index.parse(builder);
+	return root_ = stack.front();
+}
+
+const Node & Document::parse_lines(std::string_view text) {
+	root_ = Node();
+	arena.clear(), stack.clear(), frames.clear();
+	Builder builder(*this, text);
+	builder.start_array();
+	for (auto p = text.data(), end = p + text.size(); p < end;) {
+		auto newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+		std::string_view line(p, (newline ? newline : end) - p);
+		p += line.size() + 1;
+		if (line.find_first_not_of(" \t\r") != std::string_view::npos) {
+			index.build(line);
+			index.parse(builder);
+		}
+	}
+	builder.end_array();
+	return root_ = stack.front();
+}
+
+const Node & Document::parse(PeekableSource &source) {
+	root_ = Node();
+	arena.clear(), stack.clear(), frames.clear();
+	Builder builder(*this, { });
+	json::parse(source, builder);
+	return root_ = stack.front();
+}
+
+const Node & Document::parse(PeekableSource &source, BinaryFormat format) {
+	root_ = Node();
+	arena.clear(), stack.clear(), frames.clear();
+	Builder builder(*this, { });
+	json::decode(source, builder, format);
+	return root_ = stack.front();
+}
+
+} // namespace json
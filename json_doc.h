@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "compiler.h"
+#include "decimal.h"
+#include "io.h"
+#include "json.h"
+#include "json_index.h"
+
+namespace json {
+
+class Document;
+struct Member;
+enum class BinaryFormat;
+
+
+template <typename T>
+class Range {
+
+private:
+	const T *first, *last;
+
+public:
+	Range(const T *first, const T *last) noexcept : first(first), last(last) { }
+
+public:
+	const T * _pure begin() const noexcept { return first; }
+	const T * _pure end() const noexcept { return last; }
+	size_t _pure size() const noexcept { return last - first; }
+	bool _pure empty() const noexcept { return first == last; }
+	const T & _pure operator [] (size_t i) const noexcept { return first[i]; }
+
+};
+
+
+/**
+ * @brief A value in a @ref Document: a 16-byte tagged union that refers to its strings and children rather than owning them.
+ *
+ * Nodes are valid as long as the document that parsed them, and strings parsed in place as long as the input too.
+ */
+class Node {
+	friend Document;
+
+public:
+	enum Type : uint8_t { NUL, BOOLEAN, INTEGER, REAL, DECIMAL, STRING, ARRAY, OBJECT };
+
+private:
+	Type type_;
+	uint32_t count; // scale of a decimal, bytes of a string, elements of an array, or members of an object
+	union {
+		bool boolean;
+		intmax_t integer;
+		double real;
+		const char *string;
+		const Node *elements;
+		const Member *members;
+	};
+
+public:
+	constexpr Node() noexcept : type_(NUL), count(), integer() { }
+
+private:
+	explicit Node(bool boolean) noexcept : type_(BOOLEAN), count(), boolean(boolean) { }
+	explicit Node(intmax_t integer) noexcept : type_(INTEGER), count(), integer(integer) { }
+	explicit Node(double real) noexcept : type_(REAL), count(), real(real) { }
+	explicit Node(const Decimal &decimal) noexcept : type_(DECIMAL), count(decimal.scale()), integer(decimal.mantissa()) { }
+	explicit Node(std::string_view string);
+	Node(const Node *elements, size_t count);
+	Node(const Member *members, size_t count);
+
+public:
+	Type _pure type() const noexcept { return type_; }
+	bool _pure is_null() const noexcept { return type_ == NUL; }
+
+	bool as_boolean() const;
+	intmax_t as_integer() const;
+	// accepts integers and decimals as well as reals
+	double as_number() const;
+	// accepts integers as well as decimals
+	Decimal as_decimal() const;
+	std::string_view as_string() const;
+	Range<Node> as_array() const;
+	// the members of an object, in source order and including any duplicate keys
+	Range<Member> as_object() const;
+
+	// returns the first member of an object with the given key, or null if there is none
+	const Node * find(std::string_view key) const _pure;
+	const Node & get(std::string_view key) const _pure;
+
+	// deep-copies this value into the shared-pointer representation
+	ValuePtr to_value() const;
+
+};
+
+struct Member {
+	Node key, value;
+};
+
+
+/**
+ * @brief Parses JSON into compact @ref Node "nodes" allocated in one arena.
+ *
+ * Each parse releases the nodes of the previous one and reuses their memory, so a long-lived document parses a stream of
+ * messages without touching the heap once its arena has grown to fit the largest of them.
+ */
+class Document {
+
+private:
+	class Builder;
+
+private:
+	Arena arena;
+	StructuralIndex index;
+	std::vector<Node> stack; // values of the containers under construction, and keys alternating with values in objects
+	std::vector<size_t> frames; // offsets into stack of the containers under construction
+	Node root_;
+	const bool decimals;
+
+public:
+	// if decimals, fractional numbers that a Decimal represents exactly are parsed as DECIMAL rather than REAL nodes
+	explicit Document(size_t block_size = 1 << 16, bool decimals = false) noexcept : arena(block_size), decimals(decimals) { }
+
+public:
+	/**
+	 * @brief Parses a JSON value from memory, which must contain nothing else but whitespace.
+	 *
+	 * The text is parsed in two stages by a @ref StructuralIndex. Strings without escape sequences are not copied but
+	 * refer into \p json, which therefore must outlive the nodes. Throws \c std::ios_base::failure on malformed input.
+	 */
+	const Node & parse(std::string_view json);
+	const Node & parse(const Buffer &buffer) { return this->parse({ reinterpret_cast<const char *>(buffer.gptr), buffer.grem() }); }
+
+	// as above, but copies all strings into the arena, consuming exactly the bytes of the value from the source
+	const Node & parse(PeekableSource &source);
+
+	// decodes a CBOR or MessagePack item from a source as json::decode does, copying all strings into the arena
+	const Node & parse(PeekableSource &source, BinaryFormat format);
+
+	/**
+	 * @brief Parses JSON Lines, i.e., one JSON value per line, into an array of the values.
+	 *
+	 * Lines that are empty or contain only whitespace are skipped. Each line is indexed and parsed in turn, so an error
+	 * on one line does not cost a scan of the rest.
+	 */
+	const Node & parse_lines(std::string_view text);
+
+	const Node & _pure root() const noexcept { return root_; }
+
+	// returns the number of bytes that the arena holds in reserve for nodes and strings
+	size_t _pure capacity() const noexcept { return arena.capacity(); }
+
+};
+
+} // namespace json
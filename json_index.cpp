@@ -0,0 +1,408 @@
+#include "json_index.h"
+
+#include <bitset>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+
+namespace json {
+
+namespace {
+
+// the classes of the 64 bytes of a block, one bit per byte
+struct Masks {
+	uint64_t op; // braces, brackets, colons, and commas
+	uint64_t ws;
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t control; // bytes less than 0x20, which are forbidden in strings
+};
+
+/*
+ * Carries the state of stage one from one block to the next. The technique follows simdjson: quotes that are preceded by
+ * an odd number of backslashes are escaped; a prefix XOR over the unescaped quotes yields the bytes that are within
+ * strings; and a scalar begins at any byte outside of strings that is neither whitespace nor structural and that does not
+ * follow a byte of another scalar.
+ */
+class Scanner {
+
+private:
+	static constexpr uint64_t ODD_BITS = 0xAAAAAAAAAAAAAAAA;
+
+private:
+	uint64_t next_is_escaped = 0; // whether the first byte of the next block is escaped
+	uint64_t prev_in_string = 0; // all ones if the previous block ended within a string
+	uint64_t prev_scalar = 0; // whether the previous block ended with a byte of a scalar other than a string
+	uint64_t errors = 0;
+
+public:
+	inline void scan(const Masks &masks, uint32_t base, uint32_t *&out) noexcept;
+
+	bool _pure in_string() const noexcept { return prev_in_string; }
+	bool _pure has_errors() const noexcept { return errors; }
+
+private:
+	static uint64_t prefix_xor(uint64_t bits) noexcept {
+		bits ^= bits << 1, bits ^= bits << 2, bits ^= bits << 4;
+		bits ^= bits << 8, bits ^= bits << 16, bits ^= bits << 32;
+		return bits;
+	}
+
+};
+
+inline void Scanner::scan(const Masks &masks, uint32_t base, uint32_t *&out) noexcept {
+	uint64_t escaped;
+	if (!masks.backslash) {
+		escaped = next_is_escaped, next_is_escaped = 0;
+	}
+	else {
+		// subtracting the starts of runs of backslashes from their ends flips the odd bits of runs of odd length
+		uint64_t potential_escape = masks.backslash & ~next_is_escaped;
+		uint64_t escape_and_terminal_code = ((potential_escape << 1 | ODD_BITS) - potential_escape) ^ ODD_BITS;
+		escaped = escape_and_terminal_code ^ (masks.backslash | next_is_escaped);
+		next_is_escaped = (escape_and_terminal_code & masks.backslash) >> 63;
+	}
+	uint64_t quote = masks.quote & ~escaped;
+	// from each opening quote up to but excluding its closing quote
+	uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+	prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+	errors |= masks.control & in_string;
+	uint64_t scalar = ~(masks.op | masks.ws), nonquote_scalar = scalar & ~quote;
+	uint64_t scalar_start = scalar & ~(nonquote_scalar << 1 | prev_scalar);
+	prev_scalar = nonquote_scalar >> 63;
+	for (uint64_t bits = (masks.op | quote | scalar_start) & ~(in_string & ~quote); bits; bits &= bits - 1) {
+		*out++ = base + _ctz(bits);
+	}
+}
+
+Masks classify_scalar(const char *p) noexcept {
+	Masks masks { };
+	for (unsigned i = 0; i < 64; ++i) {
+		uint64_t bit = uint64_t(1) << i;
+		switch (p[i]) {
+			case '{': case '}': case '[': case ']': case ':': case ',':
+				masks.op |= bit;
+				break;
+			case ' ': case '\t': case '\n': case '\r':
+				masks.ws |= bit;
+				break;
+			case '"':
+				masks.quote |= bit;
+				break;
+			case '\\':
+				masks.backslash |= bit;
+				break;
+		}
+		if (static_cast<unsigned char>(p[i]) < 0x20) {
+			masks.control |= bit;
+		}
+	}
+	return masks;
+}
+
+uint32_t * index_scalar(const char *p, size_t n, uint32_t *out, Scanner &scanner) noexcept {
+	for (size_t i = 0; i + 64 <= n; i += 64) {
+		scanner.scan(classify_scalar(p + i), static_cast<uint32_t>(i), out);
+	}
+	return out;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/*
+ * Both variants classify each byte with compares against broadcast constants. Braces and brackets differ from each other
+ * only in bit 5, so one compare of the byte with bit 5 set matches both opening and another both closing ones.
+ */
+
+_target("sse2")
+inline uint64_t bits(__m128i mask) noexcept {
+	return static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(mask)));
+}
+
+_target("sse2")
+inline Masks classify_sse2(const char *p) noexcept {
+	const __m128i bit5 = _mm_set1_epi8(0x20), open = _mm_set1_epi8('{'), close = _mm_set1_epi8('}'), colon = _mm_set1_epi8(':'), comma = _mm_set1_epi8(',');
+	const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+	const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), max_control = _mm_set1_epi8(0x1F);
+	Masks masks { };
+	for (unsigned i = 0; i < 64; i += sizeof(__m128i)) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), folded = _mm_or_si128(v, bit5);
+		masks.op |= bits(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)), _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)))) << i;
+		masks.ws |= bits(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)), _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)))) << i;
+		masks.quote |= bits(_mm_cmpeq_epi8(v, quote)) << i;
+		masks.backslash |= bits(_mm_cmpeq_epi8(v, backslash)) << i;
+		masks.control |= bits(_mm_cmpeq_epi8(_mm_max_epu8(v, max_control), max_control)) << i;
+	}
+	return masks;
+}
+
+_target("sse2")
+uint32_t * index_sse2(const char *p, size_t n, uint32_t *out, Scanner &scanner) noexcept {
+	for (size_t i = 0; i + 64 <= n; i += 64) {
+		scanner.scan(classify_sse2(p + i), static_cast<uint32_t>(i), out);
+	}
+	return out;
+}
+
+_target("avx2")
+inline uint64_t bits(__m256i mask) noexcept {
+	return static_cast<uint64_t>(static_cast<unsigned>(_mm256_movemask_epi8(mask)));
+}
+
+_target("avx2")
+inline Masks classify_avx2(const char *p) noexcept {
+	const __m256i bit5 = _mm256_set1_epi8(0x20), open = _mm256_set1_epi8('{'), close = _mm256_set1_epi8('}'), colon = _mm256_set1_epi8(':'), comma = _mm256_set1_epi8(',');
+	const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'), lf = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+	const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\'), max_control = _mm256_set1_epi8(0x1F);
+	Masks masks { };
+	for (unsigned i = 0; i < 64; i += sizeof(__m256i)) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i)), folded = _mm256_or_si256(v, bit5);
+		masks.op |= bits(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)), _mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, comma)))) << i;
+		masks.ws |= bits(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)), _mm256_or_si256(_mm256_cmpeq_epi8(v, lf), _mm256_cmpeq_epi8(v, cr)))) << i;
+		masks.quote |= bits(_mm256_cmpeq_epi8(v, quote)) << i;
+		masks.backslash |= bits(_mm256_cmpeq_epi8(v, backslash)) << i;
+		masks.control |= bits(_mm256_cmpeq_epi8(_mm256_max_epu8(v, max_control), max_control)) << i;
+	}
+	return masks;
+}
+
+_target("avx2")
+uint32_t * index_avx2(const char *p, size_t n, uint32_t *out, Scanner &scanner) noexcept {
+	for (size_t i = 0; i + 64 <= n; i += 64) {
+		scanner.scan(classify_avx2(p + i), static_cast<uint32_t>(i), out);
+	}
+	return out;
+}
+
+#endif
+
+// indexes the whole blocks of the input
+uint32_t * index_blocks(const char *p, size_t n, uint32_t *out, Scanner &scanner) noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	static const auto index = __builtin_cpu_supports("avx2") ? index_avx2 : __builtin_cpu_supports("sse2") ? index_sse2 : index_scalar;
+	return index(p, n, out, scanner);
+#else
+	return index_scalar(p, n, out, scanner);
+#endif
+}
+
+bool is_delimiter(char c) noexcept {
+	switch (c) {
+		case '{': case '}': case '[': case ']': case ':': case ',':
+		case ' ': case '\t': case '\n': case '\r':
+			return true;
+		default:
+			return false;
+	}
+}
+
+} // namespace
+
+
+void StructuralIndex::build(std::string_view json) {
+	if (json.size() > UINT32_MAX) {
+		throw std::length_error("JSON text too large to index");
+	}
+	this->json = json;
+	// every byte could begin a scalar, and so could every byte of the padding of the final block
+	if (capacity < json.size() + 64) {
+		offsets = std::make_unique<uint32_t[]>(capacity = json.size() + 64);
+	}
+	Scanner scanner;
+	auto p = json.data();
+	size_t n = json.size(), whole = n & ~size_t(63);
+	auto out = index_blocks(p, whole, offsets.get(), scanner);
+	if (whole < n) {
+		char block[64];
+		std::memset(block, ' ', sizeof block);
+		std::memcpy(block, p + whole, n - whole);
+		scanner.scan(classify_scalar(block), static_cast<uint32_t>(whole), out);
+	}
+	count = out - offsets.get();
+	if (scanner.in_string()) {
+		throw std::ios_base::failure("unterminated string");
+	}
+	if (scanner.has_errors()) {
+		throw std::ios_base::failure("control character in string");
+	}
+}
+
+bool StructuralIndex::parse(Handler &handler) {
+	enum State { VALUE, KEY, AFTER_VALUE };
+	const char * const p = json.data(), * const end = p + json.size();
+	const uint32_t *next = offsets.get(), * const last = next + count;
+	auto peek = [&]() noexcept { return next < last ? p[*next] : '\0'; };
+	// passes the string that begins with the quote at the given offset; its closing quote is the next indexed position
+	auto string = [&](uint32_t offset) -> std::string_view {
+		std::string_view contents(p + offset + 1, *next++ - offset - 1);
+		if (contents.find('\\') == std::string_view::npos) {
+			return contents;
+		}
+		scratch.clear();
+		unescape(scratch, contents);
+		return scratch;
+	};
+	// checks that a scalar ends where whitespace or a structural character begins
+	auto check_end = [end](const char *q) {
+		if (q < end && !is_delimiter(*q)) {
+			throw std::ios_base::failure("unexpected character after value");
+		}
+	};
+	std::bitset<MAX_DEPTH> in_object;
+	size_t depth = 0;
+	for (State state = VALUE;;) {
+		switch (state) {
+			case VALUE: {
+				if (next == last) {
+					throw std::ios_base::failure("premature EOF");
+				}
+				uint32_t offset = *next++;
+				state = AFTER_VALUE;
+				switch (p[offset]) {
+					case '{':
+						if (!handler.start_object()) {
+							return false;
+						}
+						if (peek() == '}') {
+							++next;
+							if (!handler.end_object()) {
+								return false;
+							}
+							break;
+						}
+						if (depth == MAX_DEPTH) {
+							throw std::ios_base::failure("nesting too deep");
+						}
+						in_object[depth++] = true;
+						state = KEY;
+						break;
+					case '[':
+						if (!handler.start_array()) {
+							return false;
+						}
+						if (peek() == ']') {
+							++next;
+							if (!handler.end_array()) {
+								return false;
+							}
+							break;
+						}
+						if (depth == MAX_DEPTH) {
+							throw std::ios_base::failure("nesting too deep");
+						}
+						in_object[depth++] = false;
+						state = VALUE;
+						break;
+					case '"':
+						if (!handler.string(string(offset))) {
+							return false;
+						}
+						break;
+					case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+						bool fractional;
+						auto q = scan_number(p + offset, end, fractional);
+						if (!q) {
+							throw std::ios_base::failure("expected digit");
+						}
+						check_end(q);
+						if (!handler.number({ p + offset, static_cast<size_t>(q - p - offset) }, fractional)) {
+							return false;
+						}
+						break;
+					}
+					case 't':
+						if (end - p - offset < 4 || std::memcmp(p + offset, "true", 4) != 0) {
+							throw std::ios_base::failure("invalid literal");
+						}
+						check_end(p + offset + 4);
+						if (!handler.boolean(true)) {
+							return false;
+						}
+						break;
+					case 'f':
+						if (end - p - offset < 5 || std::memcmp(p + offset, "false", 5) != 0) {
+							throw std::ios_base::failure("invalid literal");
+						}
+						check_end(p + offset + 5);
+						if (!handler.boolean(false)) {
+							return false;
+						}
+						break;
+					case 'n':
+						if (end - p - offset < 4 || std::memcmp(p + offset, "null", 4) != 0) {
+							throw std::ios_base::failure("invalid literal");
+						}
+						check_end(p + offset + 4);
+						if (!handler.null()) {
+							return false;
+						}
+						break;
+					default:
+						throw std::ios_base::failure("expected object, array, number, string, boolean, or null");
+				}
+				break;
+			}
+			case KEY: {
+				if (peek() != '"') {
+					throw std::ios_base::failure("expected string");
+				}
+				if (!handler.key(string(*next++))) {
+					return false;
+				}
+				if (peek() != ':') {
+					throw std::ios_base::failure("expected colon");
+				}
+				++next;
+				state = VALUE;
+				break;
+			}
+			case AFTER_VALUE:
+				if (depth == 0) {
+					if (next != last) {
+						throw std::ios_base::failure("unexpected data after JSON value");
+					}
+					return true;
+				}
+				if (in_object[depth - 1]) {
+					switch (peek()) {
+						case ',':
+							++next;
+							state = KEY;
+							break;
+						case '}':
+							++next, --depth;
+							if (!handler.end_object()) {
+								return false;
+							}
+							break;
+						default:
+							throw std::ios_base::failure("expected comma or closing brace");
+					}
+				}
+				else {
+					switch (peek()) {
+						case ',':
+							++next;
+							state = VALUE;
+							break;
+						case ']':
+							++next, --depth;
+							if (!handler.end_array()) {
+								return false;
+							}
+							break;
+						default:
+							throw std::ios_base::failure("expected comma or closing bracket");
+					}
+				}
+				break;
+		}
+	}
+}
+
+} // namespace json
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "buffer.h"
+#include "json_sax.h"
+
+namespace json {
+
+/**
+ * @brief A two-stage parser for JSON in contiguous memory.
+ *
+ * Stage one, @ref build, classifies the input 64 bytes at a time with vector compares and bit arithmetic, recording the
+ * offset of every structural character, every unescaped quote, and the first byte of every other scalar that lies outside
+ * of strings. It uses AVX2 or SSE2, as the CPU supports, or else a scalar fallback. Stage two, @ref parse, walks the index
+ * and emits the events of the document to a @ref Handler, so the byte-at-a-time work is confined to scalars.
+ *
+ * The index refers to the input, which therefore must remain unchanged until the last @ref parse.
+ */
+class StructuralIndex {
+
+private:
+	std::string_view json;
+	std::unique_ptr<uint32_t[]> offsets;
+	size_t capacity = 0, count = 0;
+	std::string scratch;
+
+public:
+	/**
+	 * @brief Indexes the given JSON text, which must be shorter than 4 GiB.
+	 *
+	 * Throws \c std::ios_base::failure on an unterminated string or a control character in a string.
+	 */
+	void build(std::string_view json);
+	void build(const Buffer &buffer) { this->build({ reinterpret_cast<const char *>(buffer.gptr), buffer.grem() }); }
+
+	/**
+	 * @brief Emits the events of the indexed document, which must be one JSON value surrounded by nothing but whitespace.
+	 *
+	 * Strings without escape sequences are passed to the handler in place.
+	 * Throws \c std::ios_base::failure on malformed input or nesting deeper than \ref MAX_DEPTH.
+	 *
+	 * @return whether the parse ran to completion, i.e., \c false if the handler stopped it.
+	 */
+	bool parse(Handler &handler);
+
+	// returns the number of indexed positions
+	size_t _pure size() const noexcept { return count; }
+
+};
+
+} // namespace json
@@ -0,0 +1,121 @@
+#include "json_lines.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include <sys/stat.h>
+
+
+namespace json {
+
+namespace {
+
+struct Job {
+	std::string_view text;
+	const LinesReader::callback_t &callback;
+	const bool in_order;
+	const size_t chunk_size;
+	std::mutex mutex;
+	std::condition_variable condition;
+	size_t position = 0; // the offset of the first unclaimed byte
+	size_t claimed = 0, delivered = 0; // the numbers of chunks claimed and (if in order) delivered
+	std::exception_ptr exception;
+
+	Job(std::string_view text, const LinesReader::callback_t &callback, bool in_order, size_t chunk_size) noexcept : text(text), callback(callback), in_order(in_order), chunk_size(chunk_size) { }
+};
+
+} // namespace
+
+
+static void run(Job &job) noexcept {
+	try {
+		Document doc;
+		std::unique_lock<std::mutex> lock(job.mutex);
+		while (job.position < job.text.size() && !job.exception) {
+			size_t chunk = job.claimed++, begin = job.position, end = job.text.size();
+			if (end - begin > job.chunk_size) {
+				auto newline = static_cast<const char *>(std::memchr(job.text.data() + begin + job.chunk_size, '\n', end - begin - job.chunk_size));
+				if (newline) {
+					end = newline + 1 - job.text.data();
+				}
+			}
+			job.position = end;
+			lock.unlock();
+			auto values = doc.parse_lines(job.text.substr(begin, end - begin)).as_array();
+			if (job.in_order) {
+				lock.lock();
+				while (job.delivered != chunk && !job.exception) {
+					job.condition.wait(lock);
+				}
+				if (job.exception) {
+					return;
+				}
+				lock.unlock();
+			}
+			for (auto &value : values) {
+				job.callback(value);
+			}
+			lock.lock();
+			if (job.in_order) {
+				++job.delivered;
+				job.condition.notify_all();
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(job.mutex);
+		if (!job.exception) {
+			job.exception = std::current_exception();
+		}
+		job.condition.notify_all();
+	}
+}
+
+void LinesReader::read(std::string_view text, const callback_t &callback) const {
+	Job job(text, callback, ordering == Ordering::IN_ORDER, chunk_size);
+	// there is no use for more threads than chunks
+	unsigned threads_needed = static_cast<unsigned>(std::min<size_t>(concurrency, text.size() / chunk_size + 1));
+	std::vector<std::thread> threads;
+	threads.reserve(threads_needed - 1);
+	try {
+		for (unsigned i = 1; i < threads_needed; ++i) {
+			threads.emplace_back(run, std::ref(job));
+		}
+	}
+	catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(job.mutex);
+			job.exception = std::current_exception();
+			job.condition.notify_all();
+		}
+		for (auto &thread : threads) {
+			thread.join();
+		}
+		throw;
+	}
+	run(job);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	if (job.exception) {
+		std::rethrow_exception(job.exception);
+	}
+}
+
+void LinesReader::read(FileDescriptor &fd, const callback_t &callback) const {
+	struct stat st;
+	fd.fstat(&st);
+	if (st.st_size == 0) {
+		return;
+	}
+	auto size = static_cast<size_t>(st.st_size);
+	auto mapping = fd.mmap(0, size, PROT_READ, MAP_PRIVATE);
+	mapping.madvise(0, size, MADV_SEQUENTIAL);
+	this->read({ static_cast<const char *>(mapping.data()), size }, callback);
+}
+
+} // namespace json
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+#include <thread>
+
+#include "fd.h"
+#include "json_doc.h"
+
+namespace json {
+
+/**
+ * @brief Parses JSON Lines on a pool of threads.
+ *
+ * The text is split into chunks of about \c chunk_size bytes that end at line breaks. Each thread claims chunks in turn
+ * and parses all of the lines of a chunk into a @ref Document of its own, so the threads share nothing but the claiming of
+ * chunks and, if the values are to be delivered in order, the handing over of the turn to deliver.
+ */
+class LinesReader {
+
+public:
+	enum class Ordering {
+		/**
+		 * @brief Values are delivered one at a time in the order of their lines.
+		 *
+		 * Threads parse their chunks ahead and wait only for their turn to deliver.
+		 */
+		IN_ORDER,
+		/**
+		 * @brief Values are delivered concurrently from all threads, in order only within each chunk.
+		 */
+		ANY_ORDER,
+	};
+
+	// receives each value, which is valid only until the callback returns
+	typedef std::function<void (const Node &value)> callback_t;
+
+private:
+	Ordering ordering;
+	unsigned concurrency;
+	size_t chunk_size;
+
+public:
+	/**
+	 * @param[in] concurrency The number of threads (including the calling thread) among which to spread parsing.
+	 * @param[in] chunk_size The number of bytes that a thread claims at a time, extended to the next line break.
+	 */
+	explicit LinesReader(Ordering ordering = Ordering::IN_ORDER, unsigned concurrency = std::thread::hardware_concurrency(), size_t chunk_size = 1 << 20) noexcept : ordering(ordering), concurrency(concurrency == 0 ? 1 : concurrency), chunk_size(chunk_size == 0 ? 1 : chunk_size) { }
+
+public:
+	/**
+	 * @brief Parses every nonblank line of the given text and passes its value to the callback.
+	 *
+	 * If parsing or the callback throws on any thread, the other threads stop after their current chunks, and the first
+	 * exception is rethrown.
+	 */
+	void read(std::string_view text, const callback_t &callback) const;
+
+	// as above, mapping the file into memory
+	void read(FileDescriptor &fd, const callback_t &callback) const;
+	void read(const char *path, const callback_t &callback) const { FileDescriptor fd(path); this->read(fd, callback); }
+
+};
+
+} // namespace json
@@ -0,0 +1,533 @@
+#include "json_patch.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "json_view.h"
+
+
+namespace json {
+
+namespace {
+
+enum Kind { NUL, OBJECT, ARRAY, INTEGER, REAL, STRING, BOOLEAN };
+
+Kind _pure kind(const Value *value) noexcept {
+	if (!value) {
+		return NUL;
+	}
+	if (dynamic_cast<const Object *>(value)) {
+		return OBJECT;
+	}
+	if (dynamic_cast<const Array *>(value)) {
+		return ARRAY;
+	}
+	if (dynamic_cast<const Integer *>(value)) {
+		return INTEGER;
+	}
+	if (dynamic_cast<const Real *>(value)) {
+		return REAL;
+	}
+	if (dynamic_cast<const String *>(value)) {
+		return STRING;
+	}
+	return BOOLEAN;
+}
+
+// compares an integer and a real exactly, rather than after rounding the integer to a double
+bool _pure equal_numbers(intmax_t integer, double real) noexcept {
+	return real >= -0x1p63 && real < 0x1p63 && static_cast<double>(integer) == real && static_cast<intmax_t>(real) == integer;
+}
+
+constexpr uint64_t combine(uint64_t h, uint64_t x) noexcept {
+	h = (h ^ x) * 0x9E3779B97F4A7C15;
+	return h ^ h >> 29;
+}
+
+class Differ {
+
+private:
+	Array *ops;
+	std::string path;
+	std::unordered_map<const Value *, uint64_t> hashes; // of the subtrees that have been hashed
+
+public:
+	// emits operations into ops, if given
+	explicit Differ(Array *ops = nullptr) noexcept : ops(ops) { }
+
+public:
+	void diff(const ValuePtr &from, const ValuePtr &to);
+	ValuePtr merge_diff(const ValuePtr &from, const ValuePtr &to);
+	bool equal(const Value *lhs, const Value *rhs);
+
+private:
+	uint64_t hash(const Value *value);
+	void diff_objects(const Object &from, const Object &to);
+	void diff_arrays(const Array &from, const Array &to);
+	void push_token(std::string_view token);
+	void push_index(size_t index) { this->push_token(std::to_string(index)); }
+	void emit(const char op[], const ValuePtr *value);
+
+};
+
+void Differ::diff(const ValuePtr &from, const ValuePtr &to) {
+	if (this->equal(from.get(), to.get())) {
+		return;
+	}
+	Kind from_kind = kind(from.get()), to_kind = kind(to.get());
+	if (from_kind == OBJECT && to_kind == OBJECT) {
+		return this->diff_objects(static_cast<const Object &>(*from), static_cast<const Object &>(*to));
+	}
+	if (from_kind == ARRAY && to_kind == ARRAY) {
+		return this->diff_arrays(static_cast<const Array &>(*from), static_cast<const Array &>(*to));
+	}
+	this->emit("replace", &to);
+}
+
+ValuePtr Differ::merge_diff(const ValuePtr &from, const ValuePtr &to) {
+	auto from_object = dynamic_cast<const Object *>(from.get()), to_object = dynamic_cast<const Object *>(to.get());
+	if (!from_object || !to_object) {
+		return to;
+	}
+	auto changes = std::make_shared<Object>();
+	auto f = (*from_object)->begin(), t = (*to_object)->begin();
+	while (f != (*from_object)->end() || t != (*to_object)->end()) {
+		if (t == (*to_object)->end() || f != (*from_object)->end() && f->first < t->first) {
+			changes->insert(f->first, nullptr);
+			++f;
+		}
+		else if (f == (*from_object)->end() || t->first < f->first) {
+			if (t->second) {
+				changes->insert(t->first, t->second);
+			}
+			++t;
+		}
+		else {
+			if (!this->equal(f->second.get(), t->second.get())) {
+				// a member that has become null cannot be expressed and is removed
+				changes->insert(f->first, t->second ? this->merge_diff(f->second, t->second) : nullptr);
+			}
+			++f, ++t;
+		}
+	}
+	return changes;
+}
+
+uint64_t Differ::hash(const Value *value) {
+	if (!value) {
+		return 0;
+	}
+	auto itr = hashes.find(value);
+	if (itr != hashes.end()) {
+		return itr->second;
+	}
+	Kind kind = json::kind(value);
+	uint64_t h = combine(0, kind);
+	switch (kind) {
+		case NUL:
+			break;
+		case OBJECT:
+			for (auto &entry : *static_cast<const Object &>(*value)) {
+				h = combine(combine(h, std::hash<std::string_view>()(entry.first)), this->hash(entry.second.get()));
+			}
+			break;
+		case ARRAY:
+			for (auto &element : *static_cast<const Array &>(*value)) {
+				h = combine(h, this->hash(element.get()));
+			}
+			break;
+		case INTEGER:
+		case REAL: {
+			// equal numbers must hash equally whatever their types
+			double number = static_cast<const Number &>(*value);
+			h = combine(combine(0, INTEGER), std::hash<double>()(number == 0 ? 0 : number));
+			break;
+		}
+		case STRING:
+			h = combine(h, std::hash<std::string_view>()(*static_cast<const String &>(*value)));
+			break;
+		case BOOLEAN:
+			h = combine(h, *static_cast<const Boolean &>(*value));
+			break;
+	}
+	return hashes.emplace(value, h).first->second;
+}
+
+bool Differ::equal(const Value *lhs, const Value *rhs) {
+	if (lhs == rhs) {
+		return true;
+	}
+	if (this->hash(lhs) != this->hash(rhs)) {
+		return false;
+	}
+	// the hashes of the children make unequal children quick to tell apart
+	Kind lhs_kind = kind(lhs), rhs_kind = kind(rhs);
+	if (lhs_kind == INTEGER || lhs_kind == REAL) {
+		if (rhs_kind != INTEGER && rhs_kind != REAL) {
+			return false;
+		}
+		if (lhs_kind == INTEGER && rhs_kind == INTEGER) {
+			return *static_cast<const Integer &>(*lhs) == *static_cast<const Integer &>(*rhs);
+		}
+		if (lhs_kind == REAL && rhs_kind == REAL) {
+			return *static_cast<const Real &>(*lhs) == *static_cast<const Real &>(*rhs);
+		}
+		return lhs_kind == INTEGER ? equal_numbers(*static_cast<const Integer &>(*lhs), *static_cast<const Real &>(*rhs)) : equal_numbers(*static_cast<const Integer &>(*rhs), *static_cast<const Real &>(*lhs));
+	}
+	if (lhs_kind != rhs_kind) {
+		return false;
+	}
+	switch (lhs_kind) {
+		case OBJECT: {
+			auto &lhs_map = *static_cast<const Object &>(*lhs), &rhs_map = *static_cast<const Object &>(*rhs);
+			if (lhs_map.size() != rhs_map.size()) {
+				return false;
+			}
+			for (auto l = lhs_map.begin(), r = rhs_map.begin(); l != lhs_map.end(); ++l, ++r) {
+				if (l->first != r->first || !this->equal(l->second.get(), r->second.get())) {
+					return false;
+				}
+			}
+			return true;
+		}
+		case ARRAY: {
+			auto &lhs_vector = *static_cast<const Array &>(*lhs), &rhs_vector = *static_cast<const Array &>(*rhs);
+			if (lhs_vector.size() != rhs_vector.size()) {
+				return false;
+			}
+			for (size_t i = 0; i < lhs_vector.size(); ++i) {
+				if (!this->equal(lhs_vector[i].get(), rhs_vector[i].get())) {
+					return false;
+				}
+			}
+			return true;
+		}
+		case STRING:
+			return *static_cast<const String &>(*lhs) == *static_cast<const String &>(*rhs);
+		case BOOLEAN:
+			return *static_cast<const Boolean &>(*lhs) == *static_cast<const Boolean &>(*rhs);
+		default:
+			return true;
+	}
+}
+
+void Differ::diff_objects(const Object &from, const Object &to) {
+	// the members of both are in order of their keys
+	auto f = from->begin(), t = to->begin();
+	while (f != from->end() || t != to->end()) {
+		size_t length = path.size();
+		if (t == to->end() || f != from->end() && f->first < t->first) {
+			this->push_token(f->first);
+			this->emit("remove", nullptr);
+			++f;
+		}
+		else if (f == from->end() || t->first < f->first) {
+			this->push_token(t->first);
+			this->emit("add", &t->second);
+			++t;
+		}
+		else {
+			this->push_token(f->first);
+			this->diff(f->second, t->second);
+			++f, ++t;
+		}
+		path.resize(length);
+	}
+}
+
+void Differ::diff_arrays(const Array &from, const Array &to) {
+	auto &a = *from, &b = *to;
+	size_t prefix = 0, suffix = 0;
+	while (prefix < a.size() && prefix < b.size() && this->equal(a[prefix].get(), b[prefix].get())) {
+		++prefix;
+	}
+	while (suffix < a.size() - prefix && suffix < b.size() - prefix && this->equal(a[a.size() - 1 - suffix].get(), b[b.size() - 1 - suffix].get())) {
+		++suffix;
+	}
+	size_t m = a.size() - prefix - suffix, n = b.size() - prefix - suffix;
+
+	// lengths of the longest common subsequences of the suffixes of the middles, unless the table would be too large
+	constexpr size_t MAX_TABLE_SIZE = 1 << 20;
+	std::vector<uint32_t> lcs;
+	if ((m + 1) * (n + 1) <= MAX_TABLE_SIZE && m > 0 && n > 0) {
+		lcs.resize((m + 1) * (n + 1));
+		for (size_t i = m; i-- > 0;) {
+			for (size_t j = n; j-- > 0;) {
+				lcs[i * (n + 1) + j] = this->equal(a[prefix + i].get(), b[prefix + j].get()) ? lcs[(i + 1) * (n + 1) + j + 1] + 1 : std::max(lcs[(i + 1) * (n + 1) + j], lcs[i * (n + 1) + j + 1]);
+			}
+		}
+	}
+
+	// walk the alignment, diffing the removed elements of each gap between common elements with the added ones
+	size_t length = path.size(), index = prefix;
+	for (size_t i = 0, j = 0; i < m || j < n;) {
+		size_t removed = i, added = j;
+		while (i < m || j < n) {
+			if (lcs.empty()) {
+				i = m, j = n;
+			}
+			else if (i < m && j < n && lcs[i * (n + 1) + j] == lcs[(i + 1) * (n + 1) + j + 1] + 1 && this->equal(a[prefix + i].get(), b[prefix + j].get())) {
+				break;
+			}
+			else if (j == n || i < m && lcs[(i + 1) * (n + 1) + j] >= lcs[i * (n + 1) + j + 1]) {
+				++i;
+			}
+			else {
+				++j;
+			}
+		}
+		removed = i - removed, added = j - added;
+		size_t paired = std::min(removed, added);
+		for (size_t k = 0; k < paired; ++k) {
+			this->push_index(index + k);
+			this->diff(a[prefix + i - removed + k], b[prefix + j - added + k]);
+			path.resize(length);
+		}
+		for (size_t k = paired; k < removed; ++k) {
+			this->push_index(index + paired);
+			this->emit("remove", nullptr);
+			path.resize(length);
+		}
+		for (size_t k = paired; k < added; ++k) {
+			this->push_index(index + k);
+			this->emit("add", &b[prefix + j - added + k]);
+			path.resize(length);
+		}
+		index += added;
+		if (i < m && j < n) {
+			// a common element
+			++i, ++j, ++index;
+		}
+	}
+}
+
+void Differ::push_token(std::string_view token) {
+	path.push_back('/');
+	for (char c : token) {
+		c == '~' ? void(path.append("~0")) : c == '/' ? void(path.append("~1")) : path.push_back(c);
+	}
+}
+
+void Differ::emit(const char op[], const ValuePtr *value) {
+	auto object = std::make_shared<Object>();
+	object->insert("op", String(op));
+	object->insert("path", String(path));
+	if (value) {
+		object->insert("value", *value);
+	}
+	ops->insert(ValuePtr(std::move(object)));
+}
+
+
+ValuePtr clone(const ValuePtr &value) {
+	switch (kind(value.get())) {
+		case NUL:
+			return nullptr;
+		case OBJECT: {
+			auto object = std::make_shared<Object>();
+			for (auto &entry : *static_cast<const Object &>(*value)) {
+				object->insert(entry.first, clone(entry.second));
+			}
+			return object;
+		}
+		case ARRAY: {
+			auto array = std::make_shared<Array>();
+			(*array)->reserve(static_cast<const Array &>(*value)->size());
+			for (auto &element : *static_cast<const Array &>(*value)) {
+				array->insert(clone(element));
+			}
+			return array;
+		}
+		case INTEGER:
+			return std::make_shared<Integer>(static_cast<const Integer &>(*value));
+		case REAL:
+			return std::make_shared<Real>(static_cast<const Real &>(*value));
+		case STRING:
+			return std::make_shared<String>(static_cast<const String &>(*value));
+		case BOOLEAN:
+			return std::make_shared<Boolean>(static_cast<const Boolean &>(*value));
+	}
+	return nullptr;
+}
+
+// returns the slot of the value to which the first n tokens of the pointer refer, or null if there is none
+ValuePtr * find(ValuePtr &root, const Pointer &pointer, size_t n) {
+	ValuePtr *slot = &root;
+	for (size_t i = 0; i < n; ++i) {
+		if (auto object = dynamic_cast<Object *>(slot->get())) {
+			auto itr = (*object)->find(pointer.key(i));
+			if (itr == (*object)->end()) {
+				return nullptr;
+			}
+			slot = &itr->second;
+		}
+		else if (auto array = dynamic_cast<Array *>(slot->get())) {
+			if (pointer.index(i) >= (*array)->size()) {
+				return nullptr;
+			}
+			slot = &(**array)[pointer.index(i)];
+		}
+		else {
+			return nullptr;
+		}
+	}
+	return slot;
+}
+
+ValuePtr & find(ValuePtr &root, const Pointer &pointer) {
+	auto slot = find(root, pointer, pointer.size());
+	if (!slot) {
+		throw std::invalid_argument("path not found");
+	}
+	return *slot;
+}
+
+void add(ValuePtr &root, const Pointer &path, ValuePtr value) {
+	if (path.size() == 0) {
+		root = std::move(value);
+		return;
+	}
+	auto parent = find(root, path, path.size() - 1);
+	size_t last = path.size() - 1;
+	if (!parent) {
+		throw std::invalid_argument("path not found");
+	}
+	if (auto object = dynamic_cast<Object *>(parent->get())) {
+		(**object)[path.key(last)] = std::move(value);
+	}
+	else if (auto array = dynamic_cast<Array *>(parent->get())) {
+		auto &vector = **array;
+		if (path.key(last) == "-") {
+			vector.push_back(std::move(value));
+		}
+		else if (path.index(last) <= vector.size()) {
+			vector.insert(vector.begin() + path.index(last), std::move(value));
+		}
+		else {
+			throw std::invalid_argument("array index out of range");
+		}
+	}
+	else {
+		throw std::invalid_argument("path not found");
+	}
+}
+
+ValuePtr remove(ValuePtr &root, const Pointer &path) {
+	if (path.size() == 0) {
+		throw std::invalid_argument("cannot remove the root");
+	}
+	auto parent = find(root, path, path.size() - 1);
+	size_t last = path.size() - 1;
+	ValuePtr value;
+	if (!parent) {
+		throw std::invalid_argument("path not found");
+	}
+	if (auto object = dynamic_cast<Object *>(parent->get())) {
+		auto itr = (*object)->find(path.key(last));
+		if (itr == (*object)->end()) {
+			throw std::invalid_argument("path not found");
+		}
+		value = std::move(itr->second);
+		(*object)->erase(itr);
+	}
+	else if (auto array = dynamic_cast<Array *>(parent->get())) {
+		auto &vector = **array;
+		if (path.index(last) >= vector.size()) {
+			throw std::invalid_argument("array index out of range");
+		}
+		value = std::move(vector[path.index(last)]);
+		vector.erase(vector.begin() + path.index(last));
+	}
+	else {
+		throw std::invalid_argument("path not found");
+	}
+	return value;
+}
+
+const ValuePtr & member(const Object &op, const char name[]) {
+	auto itr = op->find(name);
+	if (itr == op->end()) {
+		throw std::invalid_argument(std::string(name) + " missing");
+	}
+	return itr->second;
+}
+
+} // namespace
+
+
+ValuePtr diff(const ValuePtr &from, const ValuePtr &to) {
+	auto ops = std::make_shared<Array>();
+	Differ(ops.get()).diff(from, to);
+	return ops;
+}
+
+void patch(ValuePtr &target, const Value &patch) {
+	for (auto &element : *patch.as_array()) {
+		if (!element) {
+			throw std::invalid_argument("expected object");
+		}
+		auto &op = element->as_object();
+		auto &name = *member(op, "op")->as_string();
+		auto &path_string = *member(op, "path")->as_string();
+		Pointer path(path_string);
+		if (name == "add") {
+			add(target, path, clone(member(op, "value")));
+		}
+		else if (name == "remove") {
+			remove(target, path);
+		}
+		else if (name == "replace") {
+			find(target, path) = clone(member(op, "value"));
+		}
+		else if (name == "move") {
+			auto &from_string = *member(op, "from")->as_string();
+			// a value cannot be moved into one of its own children
+			if (path_string.size() > from_string.size() && path_string.compare(0, from_string.size(), from_string) == 0 && path_string[from_string.size()] == '/') {
+				throw std::invalid_argument("cannot move a value into itself");
+			}
+			add(target, path, remove(target, Pointer(from_string)));
+		}
+		else if (name == "copy") {
+			add(target, path, clone(find(target, Pointer(*member(op, "from")->as_string()))));
+		}
+		else if (name == "test") {
+			if (!Differ().equal(find(target, path).get(), member(op, "value").get())) {
+				throw std::invalid_argument("test failed at " + path_string);
+			}
+		}
+		else {
+			throw std::invalid_argument("unknown operation " + name);
+		}
+	}
+}
+
+ValuePtr merge_diff(const ValuePtr &from, const ValuePtr &to) {
+	return Differ().merge_diff(from, to);
+}
+
+void merge_patch(ValuePtr &target, const ValuePtr &patch) {
+	auto patch_object = dynamic_cast<const Object *>(patch.get());
+	if (!patch_object) {
+		target = clone(patch);
+		return;
+	}
+	if (!dynamic_cast<Object *>(target.get())) {
+		target = std::make_shared<Object>();
+	}
+	auto &target_map = *static_cast<Object &>(*target);
+	for (auto &entry : **patch_object) {
+		if (!entry.second) {
+			target_map.erase(entry.first);
+		}
+		else {
+			merge_patch(target_map[entry.first], entry.second);
+		}
+	}
+}
+
+} // namespace json
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "json.h"
+
+namespace json {
+
+/**
+ * @brief Computes a JSON Patch (RFC 6902) that transforms one value into another.
+ *
+ * Every subtree is hashed once, so subtrees that are unchanged are recognized without walking them again, and the patch
+ * descends only into those that differ. Members of objects are added, removed, or diffed in turn. The elements of arrays
+ * are aligned by their longest common subsequence after their common ends have been trimmed, so inserting or removing
+ * an element in the middle of an array, such as a level of an order book, yields one operation; elements that take the
+ * place of others are diffed with them.
+ *
+ * The patch has only \c add, \c remove, and \c replace operations. Numbers are compared by value, so \c 1 and \c 1.0
+ * are equal. Values in the patch are shared with \p to.
+ *
+ * @return an array of operations, which is empty if the values are equal.
+ */
+ValuePtr diff(const ValuePtr &from, const ValuePtr &to);
+
+/**
+ * @brief Applies a JSON Patch (RFC 6902) to a value in place.
+ *
+ * All six operations are supported. Values are copied from the patch, so the patch may be applied again or elsewhere.
+ * Throws \c std::invalid_argument if the patch is malformed, a path does not exist, or a \c test operation fails, in which
+ * case the operations preceding the failed one remain applied.
+ */
+void patch(ValuePtr &target, const Value &patch);
+
+/**
+ * @brief Computes a JSON merge patch (RFC 7386) that transforms one value into another.
+ *
+ * A merge patch is smaller than a JSON Patch for objects but replaces arrays whole, and it cannot set a member to
+ * \c null, which it reads as removal; such members are removed instead.
+ *
+ * @return an object of the changed members, which is empty if the values are equal, or \p to if either is not an object.
+ */
+ValuePtr merge_diff(const ValuePtr &from, const ValuePtr &to);
+
+// applies a JSON merge patch (RFC 7386) to a value in place, copying values from the patch
+void merge_patch(ValuePtr &target, const ValuePtr &patch);
+
+} // namespace json
@@ -0,0 +1,249 @@
+#include "json_push.h"
+
+#include <ios>
+
+
+namespace json {
+
+static const char TRUE_LITERAL[] = "true", FALSE_LITERAL[] = "false", NULL_LITERAL[] = "null";
+
+static inline bool is_number_char(char c) noexcept {
+	return c >= '0' && c <= '9' || c == '-' || c == '+' || c == '.' || (c | 0x20) == 'e';
+}
+
+bool PushParser::feed(std::string_view chunk) {
+	for (auto p = chunk.data(), end = p + chunk.size(); p < end;) {
+		if (state <= DONE && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+			++p;
+			continue;
+		}
+		switch (state) {
+			case FIRST_ELEMENT:
+				if (*p == ']') {
+					++p;
+					if (!this->close(false)) {
+						return false;
+					}
+					break;
+				}
+				_fallthrough;
+			case VALUE:
+				switch (*p) {
+					case '{':
+						++p;
+						if (!this->open(true)) {
+							return false;
+						}
+						break;
+					case '[':
+						++p;
+						if (!this->open(false)) {
+							return false;
+						}
+						break;
+					case '"':
+						++p;
+						state = STRING, in_key = false, escaped = false;
+						break;
+					case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+						state = NUMBER;
+						break;
+					case 't':
+						state = LITERAL, literal = TRUE_LITERAL;
+						break;
+					case 'f':
+						state = LITERAL, literal = FALSE_LITERAL;
+						break;
+					case 'n':
+						state = LITERAL, literal = NULL_LITERAL;
+						break;
+					default:
+						throw std::ios_base::failure("expected object, array, number, string, boolean, or null");
+				}
+				break;
+			case FIRST_KEY:
+				if (*p == '}') {
+					++p;
+					if (!this->close(true)) {
+						return false;
+					}
+					break;
+				}
+				_fallthrough;
+			case KEY:
+				if (*p != '"') {
+					throw std::ios_base::failure("expected string");
+				}
+				++p;
+				state = STRING, in_key = true, escaped = false;
+				break;
+			case COLON:
+				if (*p != ':') {
+					throw std::ios_base::failure("expected colon");
+				}
+				++p;
+				state = VALUE;
+				break;
+			case AFTER_VALUE:
+				if (*p == ',') {
+					++p;
+					state = in_object[depth - 1] ? KEY : VALUE;
+				}
+				else if (*p == (in_object[depth - 1] ? '}' : ']')) {
+					++p;
+					if (!this->close(in_object[depth - 1])) {
+						return false;
+					}
+				}
+				else {
+					throw std::ios_base::failure(in_object[depth - 1] ? "expected comma or closing brace" : "expected comma or closing bracket");
+				}
+				break;
+			case DONE:
+				throw std::ios_base::failure("unexpected data after JSON value");
+			case STRING: {
+				auto start = p;
+				if (backslash) {
+					// the escaped character was cut off from its reverse solidus by the end of the last chunk
+					backslash = false;
+					++p;
+				}
+				for (; p < end && *p != '"'; ++p) {
+					if (*p == '\\') {
+						escaped = true;
+						if (++p == end) {
+							backslash = true;
+							break;
+						}
+					}
+					else if (static_cast<unsigned char>(*p) < 0x20) {
+						throw std::ios_base::failure("control character in string");
+					}
+				}
+				if (p == end) {
+					token.append(start, p);
+					break;
+				}
+				std::string_view contents(start, p++ - start);
+				if (!token.empty()) {
+					contents = token.append(contents);
+				}
+				if (!this->emit_string(contents)) {
+					return false;
+				}
+				break;
+			}
+			case NUMBER: {
+				auto start = p;
+				while (p < end && is_number_char(*p)) {
+					++p;
+				}
+				if (p == end) {
+					token.append(start, p);
+					break;
+				}
+				std::string_view text(start, p - start);
+				if (!token.empty()) {
+					text = token.append(text);
+				}
+				if (!this->emit_number(text)) {
+					return false;
+				}
+				break;
+			}
+			case LITERAL:
+				for (; *literal && p < end; ++literal, ++p) {
+					if (*p != *literal) {
+						throw std::ios_base::failure("invalid literal");
+					}
+				}
+				if (!*literal && !this->emit_literal()) {
+					return false;
+				}
+				break;
+			case STOPPED:
+				return false;
+		}
+	}
+	return state != STOPPED;
+}
+
+bool PushParser::finish() {
+	if (state == NUMBER && depth == 0) {
+		return this->emit_number(token);
+	}
+	if (state == STOPPED) {
+		return false;
+	}
+	if (state != DONE) {
+		throw std::ios_base::failure("premature EOF");
+	}
+	return true;
+}
+
+void PushParser::reset() noexcept {
+	state = VALUE, backslash = false, depth = 0;
+	token.clear();
+}
+
+bool PushParser::open(bool object) {
+	if (depth == MAX_DEPTH) {
+		throw std::ios_base::failure("nesting too deep");
+	}
+	in_object[depth++] = object;
+	state = object ? FIRST_KEY : FIRST_ELEMENT;
+	if (!(object ? handler.start_object() : handler.start_array())) {
+		return state = STOPPED, false;
+	}
+	return true;
+}
+
+bool PushParser::close(bool object) {
+	--depth;
+	this->end_value();
+	if (!(object ? handler.end_object() : handler.end_array())) {
+		return state = STOPPED, false;
+	}
+	return true;
+}
+
+bool PushParser::emit_string(std::string_view contents) {
+	if (escaped) {
+		scratch.clear();
+		unescape(scratch, contents);
+		contents = scratch;
+	}
+	in_key ? void(state = COLON) : this->end_value();
+	bool proceed = in_key ? handler.key(contents) : handler.string(contents);
+	token.clear();
+	if (!proceed) {
+		return state = STOPPED, false;
+	}
+	return true;
+}
+
+bool PushParser::emit_number(std::string_view text) {
+	bool fractional;
+	if (scan_number(text.data(), text.data() + text.size(), fractional) != text.data() + text.size()) {
+		throw std::ios_base::failure("invalid number");
+	}
+	this->end_value();
+	bool proceed = handler.number(text, fractional);
+	token.clear();
+	if (!proceed) {
+		return state = STOPPED, false;
+	}
+	return true;
+}
+
+bool PushParser::emit_literal() {
+	this->end_value();
+	// the literal has been matched up to its terminator
+	bool proceed = literal == NULL_LITERAL + sizeof NULL_LITERAL - 1 ? handler.null() : handler.boolean(literal == TRUE_LITERAL + sizeof TRUE_LITERAL - 1);
+	if (!proceed) {
+		return state = STOPPED, false;
+	}
+	return true;
+}
+
+} // namespace json
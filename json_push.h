@@ -0,0 +1,88 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "compiler.h"
+#include "json_sax.h"
+
+namespace json {
+
+/**
+ * @brief Parses one JSON value from chunks of any size as they arrive, keeping its state between chunks.
+ *
+ * Each event is passed to the handler as soon as its last byte has been fed, so a message that arrives over many
+ * WebSocket frames or socket reads is parsed while it is being received rather than after it has been buffered whole:
+ *
+ *     json::PushParser parser(handler);
+ *     while ((r = ws.receive(opcode, source, data)) >= 0) {
+ *         parser.feed({ static_cast<const char *>(data), static_cast<size_t>(r) });
+ *         ...
+ *     }
+ *     if (ws.is_final()) {
+ *         parser.finish();
+ *         parser.reset();
+ *     }
+ *
+ * Strings and numbers that lie wholly within a chunk are passed to the handler in place; those that span chunks are
+ * carried over in a buffer that is reused from value to value.
+ * Throws \c std::ios_base::failure on malformed input or nesting deeper than \ref MAX_DEPTH.
+ */
+class PushParser {
+
+private:
+	// the states up to DONE expect a structural character or a value, before which whitespace is skipped
+	enum State : uint8_t { VALUE, FIRST_ELEMENT, FIRST_KEY, KEY, COLON, AFTER_VALUE, DONE, STRING, NUMBER, LITERAL, STOPPED };
+
+private:
+	Handler &handler;
+	State state;
+	bool in_key; // whether the string being read is a key
+	bool escaped; // whether the string being read has escape sequences
+	bool backslash; // whether the last chunk ended within an escape sequence
+	const char *literal; // the remaining characters of the literal being read
+	size_t depth;
+	std::string token, scratch;
+	std::bitset<MAX_DEPTH> in_object;
+
+public:
+	explicit PushParser(Handler &handler) noexcept : handler(handler), state(VALUE), in_key(), escaped(), backslash(), literal(), depth() { }
+
+public:
+	/**
+	 * @brief Parses the next chunk of the text, which may end anywhere, even within a token.
+	 *
+	 * Only whitespace may follow the value.
+	 *
+	 * @return \c false if the handler has stopped the parse, after which further chunks are ignored.
+	 */
+	bool feed(std::string_view chunk);
+
+	/**
+	 * @brief Signals the end of the text, which completes a number at the top level.
+	 *
+	 * Throws \c std::ios_base::failure if the value is incomplete.
+	 *
+	 * @return \c false if the handler has stopped the parse.
+	 */
+	bool finish();
+
+	// returns whether the value has been parsed to its end
+	bool _pure complete() const noexcept { return state == DONE; }
+
+	// prepares to parse another value
+	void reset() noexcept;
+
+private:
+	bool open(bool object);
+	bool close(bool object);
+	bool emit_string(std::string_view contents);
+	bool emit_number(std::string_view text);
+	bool emit_literal();
+	void end_value() noexcept { state = depth == 0 ? DONE : AFTER_VALUE; }
+
+};
+
+} // namespace json
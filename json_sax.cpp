@@ -0,0 +1,514 @@
+#include "json_sax.h"
+
+#include <bitset>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+#include <string>
+
+
+namespace json {
+
+bool Handler::number(std::string_view text, bool fractional) {
+	auto first = text.data(), last = text.data() + text.size();
+	if (!fractional) {
+		intmax_t value;
+		if (std::from_chars(first, last, value).ec == std::errc()) {
+			return this->integer(value);
+		}
+	}
+	double value;
+	if (std::from_chars(first, last, value).ec == std::errc::result_out_of_range) {
+		// the grammar has been validated, so the magnitude is out of range, and the exponent's sign tells which way
+		auto e = text.find_first_of("eE");
+		bool underflow = e != std::string_view::npos && text[e + 1] == '-';
+		value = std::copysign(underflow ? 0.0 : HUGE_VAL, text.front() == '-' ? -1.0 : 1.0);
+	}
+	return this->real(value);
+}
+
+
+namespace {
+
+// decodes an escape sequence, the backslash of which has been consumed, drawing its characters from get
+template <typename Get>
+static void decode_escape(std::string &out, Get &&get) {
+	auto read_hex4 = [&get] {
+		unsigned value = 0;
+		for (int i = 0; i < 4; ++i) {
+			char c = get();
+			if (c >= '0' && c <= '9') {
+				value = value << 4 | (c - '0');
+			}
+			else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+				value = value << 4 | ((c | 0x20) - 'a' + 10);
+			}
+			else {
+				throw std::ios_base::failure("invalid hex digit");
+			}
+		}
+		return value;
+	};
+	switch (get()) {
+		case 'b': // backspace (U+0008)
+			out.push_back(0x08);
+			break;
+		case 't': // character tabulation (U+0009)
+			out.push_back(0x09);
+			break;
+		case 'n': // line feed (U+000A)
+			out.push_back(0x0A);
+			break;
+		case 'f': // form feed (U+000C)
+			out.push_back(0x0C);
+			break;
+		case 'r': // carriage return (U+000D)
+			out.push_back(0x0D);
+			break;
+		case '"': // quotation mark (U+0022)
+			out.push_back('"');
+			break;
+		case '/': // solidus (U+002F)
+			out.push_back('/');
+			break;
+		case '\\': // reverse solidus (U+005C)
+			out.push_back('\\');
+			break;
+		case 'u': {
+			char32_t cp = read_hex4();
+			if (cp >= 0xD800 && cp <= 0xDBFF) {
+				if (get() != '\\' || get() != 'u') {
+					throw std::ios_base::failure("unpaired surrogate");
+				}
+				char32_t low = read_hex4();
+				if (low < 0xDC00 || low > 0xDFFF) {
+					throw std::ios_base::failure("unpaired surrogate");
+				}
+				cp = 0x10000 + (cp - 0xD800 << 10) + (low - 0xDC00);
+			}
+			else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+				throw std::ios_base::failure("unpaired surrogate");
+			}
+			if (cp <= 0x7F) {
+				out.push_back(static_cast<char>(cp));
+			}
+			else if (cp <= 0x7FF) {
+				out.push_back(static_cast<char>(0xC0 | cp >> 6));
+				out.push_back(static_cast<char>(0x80 | cp & 0x3F));
+			}
+			else if (cp <= 0xFFFF) {
+				out.push_back(static_cast<char>(0xE0 | cp >> 12));
+				out.push_back(static_cast<char>(0x80 | cp >> 6 & 0x3F));
+				out.push_back(static_cast<char>(0x80 | cp & 0x3F));
+			}
+			else {
+				out.push_back(static_cast<char>(0xF0 | cp >> 18));
+				out.push_back(static_cast<char>(0x80 | cp >> 12 & 0x3F));
+				out.push_back(static_cast<char>(0x80 | cp >> 6 & 0x3F));
+				out.push_back(static_cast<char>(0x80 | cp & 0x3F));
+			}
+			break;
+		}
+		default:
+			throw std::ios_base::failure("invalid escape sequence");
+	}
+}
+
+
+class Reader {
+
+private:
+	enum State { VALUE, KEY, AFTER_VALUE };
+
+private:
+	PeekableSource * const source;
+	const char *begin, *ptr, *end;
+	std::string scratch;
+	std::bitset<MAX_DEPTH> in_object;
+
+public:
+	explicit Reader(std::string_view json) noexcept : source(), begin(json.data()), ptr(json.data()), end(json.data() + json.size()) { }
+	explicit Reader(PeekableSource &source) noexcept : source(&source), begin(), ptr(), end() { }
+
+public:
+	bool parse(Handler &handler);
+	void skip_ws();
+	int peek() { return ptr < end || this->refill() ? static_cast<unsigned char>(*ptr) : -1; }
+
+	// consumes from the source everything that has been parsed
+	void finish() {
+		if (source) {
+			source->consume(ptr - begin);
+			begin = ptr;
+		}
+	}
+
+private:
+	bool refill();
+	char get();
+	void expect(const char literal[]);
+	std::string_view read_string();
+	std::string_view read_number(bool &fractional);
+
+};
+
+bool Reader::parse(Handler &handler) {
+	size_t depth = 0;
+	for (State state = VALUE;;) {
+		switch (state) {
+			case VALUE:
+				this->skip_ws();
+				state = AFTER_VALUE;
+				switch (this->peek()) {
+					case '{':
+						++ptr;
+						if (!handler.start_object()) {
+							return false;
+						}
+						this->skip_ws();
+						if (this->peek() == '}') {
+							++ptr;
+							if (!handler.end_object()) {
+								return false;
+							}
+							break;
+						}
+						if (depth == MAX_DEPTH) {
+							throw std::ios_base::failure("nesting too deep");
+						}
+						in_object[depth++] = true;
+						state = KEY;
+						break;
+					case '[':
+						++ptr;
+						if (!handler.start_array()) {
+							return false;
+						}
+						this->skip_ws();
+						if (this->peek() == ']') {
+							++ptr;
+							if (!handler.end_array()) {
+								return false;
+							}
+							break;
+						}
+						if (depth == MAX_DEPTH) {
+							throw std::ios_base::failure("nesting too deep");
+						}
+						in_object[depth++] = false;
+						state = VALUE;
+						break;
+					case '"':
+						if (!handler.string(this->read_string())) {
+							return false;
+						}
+						break;
+					case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': {
+						bool fractional;
+						auto text = this->read_number(fractional);
+						if (!handler.number(text, fractional)) {
+							return false;
+						}
+						break;
+					}
+					case 't':
+						this->expect("true");
+						if (!handler.boolean(true)) {
+							return false;
+						}
+						break;
+					case 'f':
+						this->expect("false");
+						if (!handler.boolean(false)) {
+							return false;
+						}
+						break;
+					case 'n':
+						this->expect("null");
+						if (!handler.null()) {
+							return false;
+						}
+						break;
+					case -1:
+						throw std::ios_base::failure("premature EOF");
+					default:
+						throw std::ios_base::failure("expected object, array, number, string, boolean, or null");
+				}
+				break;
+			case KEY:
+				this->skip_ws();
+				if (this->peek() != '"') {
+					throw std::ios_base::failure("expected string");
+				}
+				if (!handler.key(this->read_string())) {
+					return false;
+				}
+				this->skip_ws();
+				if (this->peek() != ':') {
+					throw std::ios_base::failure("expected colon");
+				}
+				++ptr;
+				state = VALUE;
+				break;
+			case AFTER_VALUE:
+				if (depth == 0) {
+					return true;
+				}
+				this->skip_ws();
+				if (in_object[depth - 1]) {
+					switch (this->peek()) {
+						case ',':
+							++ptr;
+							state = KEY;
+							break;
+						case '}':
+							++ptr, --depth;
+							if (!handler.end_object()) {
+								return false;
+							}
+							break;
+						default:
+							throw std::ios_base::failure("expected comma or closing brace");
+					}
+				}
+				else {
+					switch (this->peek()) {
+						case ',':
+							++ptr;
+							state = VALUE;
+							break;
+						case ']':
+							++ptr, --depth;
+							if (!handler.end_array()) {
+								return false;
+							}
+							break;
+						default:
+							throw std::ios_base::failure("expected comma or closing bracket");
+					}
+				}
+				break;
+		}
+	}
+}
+
+void Reader::skip_ws() {
+	do {
+		for (; ptr < end; ++ptr) {
+			if (*ptr != ' ' && *ptr != '\n' && *ptr != '\r' && *ptr != '\t') {
+				return;
+			}
+		}
+	} while (this->refill());
+}
+
+bool Reader::refill() {
+	if (!source) {
+		return false;
+	}
+	source->consume(ptr - begin);
+	const void *window;
+	ssize_t r = source->peek(window, 1);
+	if (r < 0) {
+		begin = ptr = end = nullptr;
+		return false;
+	}
+	if (r == 0) {
+		throw std::logic_error("non-blocking read in blocking context");
+	}
+	end = (begin = ptr = static_cast<const char *>(window)) + r;
+	return true;
+}
+
+char Reader::get() {
+	if (ptr == end && !this->refill()) {
+		throw std::ios_base::failure("premature EOF");
+	}
+	return *ptr++;
+}
+
+void Reader::expect(const char literal[]) {
+	for (; *literal; ++literal) {
+		if (this->get() != *literal) {
+			throw std::ios_base::failure("invalid literal");
+		}
+	}
+}
+
+std::string_view Reader::read_string() {
+	++ptr;
+	bool copied = false;
+	scratch.clear();
+	for (;;) {
+		const char *start = ptr;
+		while (ptr < end && *ptr != '"' && *ptr != '\\' && static_cast<unsigned char>(*ptr) >= 0x20) {
+			++ptr;
+		}
+		if (ptr == end) {
+			// the string continues beyond the window, which the refill will invalidate
+			scratch.append(start, ptr);
+			copied = true;
+			if (!this->refill()) {
+				throw std::ios_base::failure("unterminated string");
+			}
+			continue;
+		}
+		if (*ptr == '"') {
+			++ptr;
+			if (!copied) {
+				return { start, static_cast<size_t>(ptr - 1 - start) };
+			}
+			scratch.append(start, ptr - 1);
+			return scratch;
+		}
+		if (*ptr != '\\') {
+			throw std::ios_base::failure("control character in string");
+		}
+		scratch.append(start, ptr++);
+		copied = true;
+		decode_escape(scratch, [this] { return this->get(); });
+	}
+}
+
+std::string_view Reader::read_number(bool &fractional) {
+	const char *start = ptr;
+	bool copied = false;
+	scratch.clear();
+	// returns the next character of the number, carrying what has been scanned into scratch if the window must be refilled
+	auto next = [&]() -> int {
+		if (ptr == end) {
+			if (!source) {
+				return -1;
+			}
+			scratch.append(start, ptr);
+			copied = true;
+			bool more = this->refill();
+			start = ptr;
+			if (!more) {
+				return -1;
+			}
+		}
+		return static_cast<unsigned char>(*ptr);
+	};
+	auto is_digit = [](int c) noexcept { return c >= '0' && c <= '9'; };
+	auto digits = [&]() {
+		if (!is_digit(next())) {
+			throw std::ios_base::failure("expected digit");
+		}
+		do {
+			++ptr;
+		} while (is_digit(next()));
+	};
+	if (next() == '-') {
+		++ptr;
+	}
+	if (next() == '0') {
+		++ptr;
+	}
+	else {
+		digits();
+	}
+	fractional = false;
+	if (next() == '.') {
+		++ptr;
+		fractional = true;
+		digits();
+	}
+	if ((next() | 0x20) == 'e') {
+		++ptr;
+		fractional = true;
+		if (next() == '+' || next() == '-') {
+			++ptr;
+		}
+		digits();
+	}
+	if (!copied) {
+		return { start, static_cast<size_t>(ptr - start) };
+	}
+	scratch.append(start, ptr);
+	return scratch;
+}
+
+} // namespace
+
+
+void unescape(std::string &out, std::string_view escaped) {
+	auto p = escaped.data(), end = p + escaped.size();
+	for (;;) {
+		auto backslash = static_cast<const char *>(std::memchr(p, '\\', end - p));
+		if (!backslash) {
+			out.append(p, end);
+			return;
+		}
+		out.append(p, backslash);
+		p = backslash + 1;
+		decode_escape(out, [&p, end] {
+			if (p == end) {
+				throw std::ios_base::failure("invalid escape sequence");
+			}
+			return *p++;
+		});
+	}
+}
+
+const char * scan_number(const char *p, const char *end, bool &fractional) noexcept {
+	auto is_digit = [end](const char *p) noexcept { return p < end && *p >= '0' && *p <= '9'; };
+	auto digits = [&](const char *p) noexcept -> const char * {
+		if (!is_digit(p)) {
+			return nullptr;
+		}
+		do {
+			++p;
+		} while (is_digit(p));
+		return p;
+	};
+	if (*p == '-') {
+		++p;
+	}
+	if (p < end && *p == '0') {
+		++p;
+	}
+	else if (!(p = digits(p))) {
+		return nullptr;
+	}
+	fractional = false;
+	if (p < end && *p == '.') {
+		fractional = true;
+		if (!(p = digits(p + 1))) {
+			return nullptr;
+		}
+	}
+	if (p < end && (*p | 0x20) == 'e') {
+		fractional = true;
+		if (++p < end && (*p == '+' || *p == '-')) {
+			++p;
+		}
+		if (!(p = digits(p))) {
+			return nullptr;
+		}
+	}
+	return p;
+}
+
+bool parse(std::string_view json, Handler &handler) {
+	Reader reader(json);
+	if (!reader.parse(handler)) {
+		return false;
+	}
+	reader.skip_ws();
+	if (reader.peek() >= 0) {
+		throw std::ios_base::failure("unexpected data after JSON value");
+	}
+	return true;
+}
+
+bool parse(PeekableSource &source, Handler &handler) {
+	Reader reader(source);
+	bool ret = reader.parse(handler);
+	reader.finish();
+	return ret;
+}
+
+} // namespace json
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "compiler.h"
+#include "io.h"
+
+namespace json {
+
+/**
+ * @brief Receives the events of a streaming parse.
+ *
+ * Every callback returns whether to continue parsing; returning \c false makes the parse return \c false at once.
+ * String views passed to callbacks are valid only until the callback returns.
+ */
+class Handler {
+
+public:
+	virtual ~Handler() = default;
+
+public:
+	virtual bool start_object() { return true; }
+	virtual bool key(std::string_view) { return true; }
+	virtual bool end_object() { return true; }
+
+	virtual bool start_array() { return true; }
+	virtual bool end_array() { return true; }
+
+	virtual bool string(std::string_view) { return true; }
+	virtual bool integer(intmax_t) { return true; }
+	virtual bool real(double) { return true; }
+	virtual bool boolean(bool) { return true; }
+	virtual bool null() { return true; }
+
+	/**
+	 * @brief Receives the text of a number, which the parser has validated against the JSON grammar.
+	 *
+	 * The default implementation calls \ref integer if \p fractional is \c false and the number fits in \c intmax_t,
+	 * or else \ref real. Override this to receive numbers losslessly.
+	 *
+	 * @param[in] fractional Whether the number has a fraction or an exponent.
+	 */
+	virtual bool number(std::string_view text, bool fractional);
+
+};
+
+/**
+ * @brief Appends the decoding of the contents of a JSON string, i.e., the text between its quotes.
+ *
+ * Throws \c std::ios_base::failure on an invalid escape sequence or an unpaired surrogate.
+ */
+void unescape(std::string &out, std::string_view escaped);
+
+/**
+ * @brief Matches a number against the JSON grammar.
+ *
+ * @param[out] fractional Whether the number has a fraction or an exponent.
+ * @return the end of the number that begins at \p p, or null if it is malformed.
+ */
+const char * scan_number(const char *p, const char *end, bool &fractional) noexcept;
+
+// the deepest nesting of objects and arrays that the streaming parser accepts
+constexpr size_t MAX_DEPTH = 1024;
+
+/**
+ * @brief Parses one JSON value from memory, which must contain nothing else but whitespace.
+ *
+ * Strings without escape sequences are passed to the handler in place; nothing is allocated per value.
+ * Throws \c std::ios_base::failure on malformed input or nesting deeper than \ref MAX_DEPTH.
+ *
+ * @return whether the parse ran to completion, i.e., \c false if the handler stopped it.
+ */
+bool parse(std::string_view json, Handler &handler);
+
+/**
+ * @brief Parses one JSON value from a source, consuming exactly the bytes of the value and any whitespace preceding it.
+ *
+ * The source must be blocking; wrap a plain \c Source in a \c BufferedSource.
+ * Subsequent data, such as the next value of a stream of values, remain in the source.
+ */
+bool parse(PeekableSource &source, Handler &handler);
+
+} // namespace json
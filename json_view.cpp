@@ -0,0 +1,254 @@
+#include "json_view.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+
+#include "json_sax.h"
+
+
+namespace json {
+
+static inline const char * skip_ws(const char *p, const char *end) noexcept {
+	while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+		++p;
+	}
+	return p;
+}
+
+// returns the end of the string that begins with the quote at p
+static const char * skip_string(const char *p, const char *end) {
+	for (auto q = p + 1;;) {
+		auto quote = static_cast<const char *>(std::memchr(q, '"', end - q));
+		if (!quote) {
+			throw std::ios_base::failure("unterminated string");
+		}
+		// the quote is escaped if it is preceded by an odd number of backslashes
+		auto r = quote;
+		while (r[-1] == '\\') {
+			--r;
+		}
+		if ((quote - r) % 2 == 0) {
+			return quote + 1;
+		}
+		q = quote + 1;
+	}
+}
+
+// returns the end of the value that begins at p
+static const char * skip_value(const char *p, const char *end) {
+	switch (*p) {
+		case '"':
+			return skip_string(p, end);
+		case '{': case '[':
+			for (size_t depth = 0; p < end;) {
+				switch (*p++) {
+					case '"':
+						p = skip_string(p - 1, end);
+						break;
+					case '{': case '[':
+						++depth;
+						break;
+					case '}': case ']':
+						if (--depth == 0) {
+							return p;
+						}
+						break;
+				}
+			}
+			throw std::ios_base::failure("premature EOF");
+		default:
+			while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+				++p;
+			}
+			return p;
+	}
+}
+
+
+View::View(std::string_view json) noexcept : end(json.data() + json.size()) {
+	ptr = skip_ws(json.data(), end);
+	if (ptr == end) {
+		ptr = nullptr;
+	}
+}
+
+bool View::as_boolean() const {
+	if (ptr && end - ptr >= 4 && std::memcmp(ptr, "true", 4) == 0) {
+		return true;
+	}
+	if (ptr && end - ptr >= 5 && std::memcmp(ptr, "false", 5) == 0) {
+		return false;
+	}
+	throw std::invalid_argument("expected boolean");
+}
+
+intmax_t View::as_integer() const {
+	intmax_t value;
+	if (this->is_number()) {
+		auto [p, ec] = std::from_chars(ptr, end, value);
+		if (ec == std::errc() && (p == end || *p != '.' && (*p | 0x20) != 'e')) {
+			return value;
+		}
+	}
+	throw std::invalid_argument("expected integer");
+}
+
+double View::as_number() const {
+	double value;
+	if (this->is_number()) {
+		auto [p, ec] = std::from_chars(ptr, end, value);
+		if (ec == std::errc()) {
+			return value;
+		}
+		if (ec == std::errc::result_out_of_range) {
+			// as the parsers do, round to zero or infinity according to the sign of the exponent
+			std::string_view text(ptr, p - ptr);
+			auto e = text.find_first_of("eE");
+			bool underflow = e != std::string_view::npos && text[e + 1] == '-';
+			return std::copysign(underflow ? 0.0 : HUGE_VAL, text.front() == '-' ? -1.0 : 1.0);
+		}
+	}
+	throw std::invalid_argument("expected number");
+}
+
+Decimal View::as_decimal() const {
+	Decimal value;
+	if (this->is_number()) {
+		auto ec = ::from_chars(ptr, end, value).ec;
+		if (ec == std::errc()) {
+			return value;
+		}
+		if (ec == std::errc::result_out_of_range) {
+			throw std::out_of_range("decimal out of range");
+		}
+	}
+	throw std::invalid_argument("expected number");
+}
+
+std::string_view View::as_string(std::string &scratch) const {
+	if (!this->is_string()) {
+		throw std::invalid_argument("expected string");
+	}
+	std::string_view contents(ptr + 1, skip_string(ptr, end) - ptr - 2);
+	if (contents.find('\\') == std::string_view::npos) {
+		return contents;
+	}
+	scratch.clear();
+	unescape(scratch, contents);
+	return scratch;
+}
+
+View View::find(std::string_view key) const {
+	if (!this->is_object()) {
+		return { };
+	}
+	std::string scratch;
+	for (auto p = skip_ws(ptr + 1, end); p < end && *p == '"';) {
+		auto key_end = skip_string(p, end);
+		std::string_view raw_key(p + 1, key_end - p - 2);
+		bool match = raw_key.find('\\') == std::string_view::npos ? raw_key == key : (scratch.clear(), unescape(scratch, raw_key), scratch == key);
+		p = skip_ws(key_end, end);
+		if (p == end || *p != ':') {
+			throw std::ios_base::failure("expected colon");
+		}
+		p = skip_ws(p + 1, end);
+		if (p == end) {
+			throw std::ios_base::failure("premature EOF");
+		}
+		if (match) {
+			return { p, end };
+		}
+		p = skip_ws(skip_value(p, end), end);
+		if (p == end || *p != ',') {
+			break;
+		}
+		p = skip_ws(p + 1, end);
+	}
+	return { };
+}
+
+View View::at(size_t index) const {
+	if (!this->is_array()) {
+		return { };
+	}
+	auto p = skip_ws(ptr + 1, end);
+	if (p == end || *p == ']') {
+		return { };
+	}
+	for (;; --index) {
+		if (index == 0) {
+			return { p, end };
+		}
+		p = skip_ws(skip_value(p, end), end);
+		if (p == end || *p != ',') {
+			return { };
+		}
+		p = skip_ws(p + 1, end);
+		if (p == end) {
+			throw std::ios_base::failure("premature EOF");
+		}
+	}
+}
+
+std::string_view View::raw() const {
+	return ptr ? std::string_view(ptr, skip_value(ptr, end) - ptr) : std::string_view();
+}
+
+
+Pointer::Pointer(std::string_view pointer) {
+	if (pointer.empty()) {
+		return;
+	}
+	if (pointer.front() != '/') {
+		throw std::invalid_argument("JSON pointer must begin with a solidus");
+	}
+	for (size_t pos = 1;;) {
+		size_t slash = std::min(pointer.find('/', pos), pointer.size());
+		auto &token = tokens.emplace_back();
+		for (size_t i = pos; i < slash; ++i) {
+			if (pointer[i] != '~') {
+				token.key.push_back(pointer[i]);
+			}
+			else if (++i < slash && (pointer[i] == '0' || pointer[i] == '1')) {
+				token.key.push_back(pointer[i] == '0' ? '~' : '/');
+			}
+			else {
+				throw std::invalid_argument("invalid escape in JSON pointer");
+			}
+		}
+		token.index = SIZE_MAX;
+		auto first = token.key.data(), last = first + token.key.size();
+		if (!token.key.empty() && (token.key.front() != '0' || token.key.size() == 1)) {
+			size_t index;
+			auto [p, ec] = std::from_chars(first, last, index);
+			if (ec == std::errc() && p == last) {
+				token.index = index;
+			}
+		}
+		if (slash == pointer.size()) {
+			break;
+		}
+		pos = slash + 1;
+	}
+}
+
+View Pointer::find(View view) const {
+	for (auto &token : tokens) {
+		if (view.is_array()) {
+			view = token.index == SIZE_MAX ? View() : view.at(token.index);
+		}
+		else {
+			view = view.find(token.key);
+		}
+		if (!view) {
+			break;
+		}
+	}
+	return view;
+}
+
+} // namespace json
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiler.h"
+#include "decimal.h"
+
+namespace json {
+
+/**
+ * @brief A value in JSON text that is parsed only as far as it is accessed.
+ *
+ * A view is a position in the text. Looking up a member or an element scans forward from it, skipping the values passed
+ * over by matching brackets rather than parsing them, so reading a few fields of a large message costs little more than
+ * scanning to them. The text is validated only where it is scanned; malformed text may yield invalid views rather than
+ * errors. Views refer into the text, which therefore must outlive them.
+ */
+class View {
+
+private:
+	const char *ptr, *end;
+
+public:
+	// an invalid view, as returned for a missing member or element
+	constexpr View() noexcept : ptr(), end() { }
+	// a view of the JSON value with which the given text begins, after any whitespace
+	explicit View(std::string_view json) noexcept;
+
+private:
+	View(const char *ptr, const char *end) noexcept : ptr(ptr), end(end) { }
+
+public:
+	explicit _pure operator bool () const noexcept { return ptr; }
+
+	bool _pure is_object() const noexcept { return ptr && *ptr == '{'; }
+	bool _pure is_array() const noexcept { return ptr && *ptr == '['; }
+	bool _pure is_string() const noexcept { return ptr && *ptr == '"'; }
+	bool _pure is_number() const noexcept { return ptr && (*ptr == '-' || *ptr >= '0' && *ptr <= '9'); }
+	bool _pure is_boolean() const noexcept { return ptr && (*ptr == 't' || *ptr == 'f'); }
+	bool _pure is_null() const noexcept { return ptr && *ptr == 'n'; }
+
+	// these throw std::invalid_argument if the view is invalid or of another type
+	bool as_boolean() const;
+	intmax_t as_integer() const;
+	double as_number() const;
+	// throws std::out_of_range if the number is not exactly representable
+	Decimal as_decimal() const;
+	// returns the string in place if it has no escape sequences, or else its decoding into scratch
+	std::string_view as_string(std::string &scratch) const;
+
+	// returns the member of an object with the given key, or an invalid view if there is none or this is not an object
+	View find(std::string_view key) const;
+	// returns the element of an array at the given index, or an invalid view if there is none or this is not an array
+	View at(size_t index) const;
+
+	// returns the text of the value, finding its end
+	std::string_view raw() const;
+
+};
+
+
+/**
+ * @brief A JSON Pointer (RFC 6901), such as \c "/data/0/price", compiled once for use on any number of documents.
+ *
+ * A reference token that is a non-negative integer without leading zeros indexes an array; every token names a member of
+ * an object.
+ */
+class Pointer {
+
+private:
+	struct Token {
+		std::string key;
+		size_t index; // SIZE_MAX if the token is not an array index
+	};
+
+private:
+	std::vector<Token> tokens;
+
+public:
+	// throws std::invalid_argument if the pointer is neither empty nor begins with a solidus, or has an invalid escape
+	explicit Pointer(std::string_view pointer);
+
+public:
+	// returns the value to which this pointer refers, or an invalid view if there is none
+	View find(View root) const;
+	View find(std::string_view json) const { return this->find(View(json)); }
+
+	// the number of reference tokens, and the unescaped key and the array index, or SIZE_MAX, of each
+	size_t _pure size() const noexcept { return tokens.size(); }
+	const std::string & _pure key(size_t i) const noexcept { return tokens[i].key; }
+	size_t _pure index(size_t i) const noexcept { return tokens[i].index; }
+
+};
+
+} // namespace json
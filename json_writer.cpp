@@ -0,0 +1,287 @@
+#include "json_writer.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "json_doc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+
+namespace json {
+
+static inline bool needs_escape(char c) noexcept {
+	return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+}
+
+static size_t find_escape_scalar(const char *p, size_t n) noexcept {
+	size_t i = 0;
+	while (i < n && !needs_escape(p[i])) {
+		++i;
+	}
+	return i;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/*
+ * Both variants test a block of bytes at once for control characters, quotation marks, and reverse solidi, and then
+ * locate the first such byte in the block by its bit in the mask.
+ */
+
+_target("sse2")
+static size_t find_escape_sse2(const char *p, size_t n) noexcept {
+	const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), max_control = _mm_set1_epi8(0x1F);
+	size_t i = 0;
+	for (; i + sizeof(__m128i) <= n; i += sizeof(__m128i)) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		if (unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)), _mm_cmpeq_epi8(_mm_max_epu8(v, max_control), max_control)))) {
+			return i + _ctz(mask);
+		}
+	}
+	return i + find_escape_scalar(p + i, n - i);
+}
+
+_target("avx2")
+static size_t find_escape_avx2(const char *p, size_t n) noexcept {
+	const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\'), max_control = _mm256_set1_epi8(0x1F);
+	size_t i = 0;
+	for (; i + sizeof(__m256i) <= n; i += sizeof(__m256i)) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		if (unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)), _mm256_cmpeq_epi8(_mm256_max_epu8(v, max_control), max_control)))) {
+			return i + _ctz(mask);
+		}
+	}
+	// a call to the SSE2 variant would incur a transition penalty; 128-bit operations here are VEX-encoded
+	if (i + sizeof(__m128i) <= n) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		if (unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(quote)), _mm_cmpeq_epi8(v, _mm256_castsi256_si128(backslash))), _mm_cmpeq_epi8(_mm_max_epu8(v, _mm256_castsi256_si128(max_control)), _mm256_castsi256_si128(max_control))))) {
+			return i + _ctz(mask);
+		}
+		i += sizeof(__m128i);
+	}
+	return i + find_escape_scalar(p + i, n - i);
+}
+
+#endif
+
+// returns the offset of the first byte in the buffer that must be escaped, or n if there is none
+static size_t find_escape(const char *p, size_t n) noexcept {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	static const auto find = __builtin_cpu_supports("avx2") ? find_escape_avx2 : find_escape_sse2;
+	return find(p, n);
+#else
+	return find_escape_scalar(p, n);
+#endif
+}
+
+
+Writer & Writer::key(std::string_view key) {
+	this->separate();
+	this->string(key);
+	this->put(':');
+	need_comma = false;
+	return *this;
+}
+
+Writer & Writer::value(std::string_view string) {
+	this->separate();
+	this->string(string);
+	return *this;
+}
+
+Writer & Writer::value(bool boolean) {
+	this->separate();
+	boolean ? this->append("true", 4) : this->append("false", 5);
+	return *this;
+}
+
+Writer & Writer::value(double real) {
+	if (!std::isfinite(real)) {
+		return this->null();
+	}
+	this->separate();
+	char buf[32];
+	auto end = std::to_chars(buf, buf + sizeof buf, real).ptr;
+	this->append(buf, end - buf);
+	return *this;
+}
+
+Writer & Writer::value(const Decimal &decimal) {
+	this->separate();
+	char buf[48];
+	auto end = to_chars(buf, buf + sizeof buf, decimal).ptr;
+	this->append(buf, end - buf);
+	return *this;
+}
+
+Writer & Writer::value(const Value &value) {
+	if (auto object = dynamic_cast<const Object *>(&value)) {
+		this->begin_object();
+		for (auto &entry : **object) {
+			this->key(entry.first).value(entry.second);
+		}
+		return this->end_object();
+	}
+	if (auto array = dynamic_cast<const Array *>(&value)) {
+		this->begin_array();
+		for (auto &element : **array) {
+			this->value(element);
+		}
+		return this->end_array();
+	}
+	if (auto integer = dynamic_cast<const Integer *>(&value)) {
+		return this->integer(**integer);
+	}
+	if (auto real = dynamic_cast<const Real *>(&value)) {
+		return this->value(**real);
+	}
+	if (auto string = dynamic_cast<const String *>(&value)) {
+		return this->value(std::string_view(**string));
+	}
+	return this->value(*value.as_boolean());
+}
+
+Writer & Writer::value(const Node &node) {
+	switch (node.type()) {
+		case Node::NUL:
+			return this->null();
+		case Node::BOOLEAN:
+			return this->value(node.as_boolean());
+		case Node::INTEGER:
+			return this->integer(node.as_integer());
+		case Node::REAL:
+			return this->value(node.as_number());
+		case Node::DECIMAL:
+			return this->value(node.as_decimal());
+		case Node::STRING:
+			return this->value(node.as_string());
+		case Node::ARRAY:
+			this->begin_array();
+			for (auto &element : node.as_array()) {
+				this->value(element);
+			}
+			return this->end_array();
+		case Node::OBJECT:
+			this->begin_object();
+			for (auto &member : node.as_object()) {
+				this->key(member.key.as_string()).value(member.value);
+			}
+			return this->end_object();
+	}
+	return *this;
+}
+
+Writer & Writer::null() {
+	this->separate();
+	this->append("null", 4);
+	return *this;
+}
+
+Writer & Writer::raw(std::string_view json) {
+	this->separate();
+	this->append(json.data(), json.size());
+	return *this;
+}
+
+void Writer::flush() {
+	if (sink) {
+		this->drain();
+		sink->flush_fully();
+	}
+}
+
+Writer & Writer::open(char c) {
+	this->separate();
+	this->put(c);
+	need_comma = false;
+	return *this;
+}
+
+Writer & Writer::close(char c) {
+	this->put(c);
+	need_comma = true;
+	return *this;
+}
+
+Writer & Writer::integer(intmax_t integer) {
+	this->separate();
+	char buf[24];
+	auto end = std::to_chars(buf, buf + sizeof buf, integer).ptr;
+	this->append(buf, end - buf);
+	return *this;
+}
+
+Writer & Writer::integer(uintmax_t integer) {
+	this->separate();
+	char buf[24];
+	auto end = std::to_chars(buf, buf + sizeof buf, integer).ptr;
+	this->append(buf, end - buf);
+	return *this;
+}
+
+void Writer::separate() {
+	if (need_comma) {
+		this->put(',');
+	}
+	need_comma = true;
+}
+
+void Writer::append(const void *data, size_t n) {
+	if (sink && buffer.grem() + n > flush_threshold) {
+		this->drain();
+	}
+	buffer.append(data, n);
+}
+
+void Writer::string(std::string_view string) {
+	static const char HEX[] = "0123456789ABCDEF";
+	this->put('"');
+	for (auto p = string.data(), end = p + string.size();;) {
+		if (size_t run = find_escape(p, end - p)) {
+			this->append(p, run);
+			p += run;
+		}
+		if (p == end) {
+			break;
+		}
+		char c = *p++, escape[6] = { '\\' };
+		switch (c) {
+			case 0x08: // backspace (U+0008)
+				escape[1] = 'b';
+				break;
+			case 0x09: // character tabulation (U+0009)
+				escape[1] = 't';
+				break;
+			case 0x0A: // line feed (U+000A)
+				escape[1] = 'n';
+				break;
+			case 0x0C: // form feed (U+000C)
+				escape[1] = 'f';
+				break;
+			case 0x0D: // carriage return (U+000D)
+				escape[1] = 'r';
+				break;
+			case '"': // quotation mark (U+0022)
+			case '\\': // reverse solidus (U+005C)
+				escape[1] = c;
+				break;
+			default:
+				escape[1] = 'u', escape[2] = '0', escape[3] = '0', escape[4] = HEX[c >> 4], escape[5] = HEX[c & (1 << 4) - 1];
+				this->append(escape, 6);
+				continue;
+		}
+		this->append(escape, 2);
+	}
+	this->put('"');
+}
+
+void Writer::drain() {
+	sink->write_fully(buffer.gptr, buffer.grem());
+	buffer.clear();
+}
+
+} // namespace json
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "buffer.h"
+#include "compiler.h"
+#include "decimal.h"
+#include "io.h"
+#include "json.h"
+
+namespace json {
+
+class Node;
+
+
+/**
+ * @brief Serializes JSON into a buffer or a sink without going through \c std::ostream.
+ *
+ * Values are written one at a time with the builder methods, which insert commas and colons as needed, so a message can
+ * be written without building a DOM; whole @ref Value or @ref Node trees can be written as values too. The caller is
+ * responsible for the nesting of objects and arrays and for writing a key before each value in an object.
+ *
+ * Strings are escaped by copying runs of bytes that need no escaping, which are found with vector compares, and reals
+ * are written in their shortest round-trip form. Non-finite reals are written as \c null, as @ref Real does.
+ */
+class Writer {
+
+private:
+	Buffer own_buffer;
+	Buffer &buffer;
+	Sink * const sink;
+	const size_t flush_threshold;
+	bool need_comma;
+
+public:
+	// appends to the given buffer, which grows as needed
+	explicit Writer(Buffer &buffer) noexcept : buffer(buffer), sink(), flush_threshold(SIZE_MAX), need_comma() { }
+	explicit Writer(BufferSink &buffer) noexcept : Writer(static_cast<Buffer &>(buffer)) { }
+
+	// writes to the given blocking sink whenever more than buffer_size bytes have accumulated, and upon flush
+	explicit Writer(Sink &sink, size_t buffer_size = 1 << 16) : own_buffer(buffer_size), buffer(own_buffer), sink(&sink), flush_threshold(buffer_size), need_comma() { }
+
+private:
+	Writer(const Writer &) = delete;
+	Writer & operator = (const Writer &) = delete;
+
+public:
+	Writer & begin_object() { return this->open('{'); }
+	Writer & end_object() { return this->close('}'); }
+	Writer & begin_array() { return this->open('['); }
+	Writer & end_array() { return this->close(']'); }
+
+	Writer & key(std::string_view key);
+
+	Writer & value(std::string_view string);
+	Writer & value(const char string[]) { return this->value(std::string_view(string)); }
+	Writer & value(bool boolean);
+	Writer & value(double real);
+	Writer & value(const Decimal &decimal);
+	Writer & value(const Value &value);
+	Writer & value(const ValuePtr &value) { return value ? this->value(*value) : this->null(); }
+	Writer & value(const Node &node);
+	template <typename T>
+	std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, Writer &> value(T integer) {
+		return std::is_signed_v<T> ? this->integer(static_cast<intmax_t>(integer)) : this->integer(static_cast<uintmax_t>(integer));
+	}
+	Writer & null();
+
+	// writes a value that is already serialized
+	Writer & raw(std::string_view json);
+
+	// writes all buffered output to the sink, if any, and flushes it
+	void flush();
+
+private:
+	Writer & open(char c);
+	Writer & close(char c);
+	Writer & integer(intmax_t integer);
+	Writer & integer(uintmax_t integer);
+	void separate();
+	void append(const void *data, size_t n);
+	void put(char c) {
+		if (buffer.pptr == buffer.eptr || buffer.grem() >= flush_threshold) {
+			return this->append(&c, 1);
+		}
+		*buffer.pptr++ = c;
+	}
+	void string(std::string_view string);
+	void drain();
+
+};
+
+} // namespace json
@@ -0,0 +1,121 @@
+#include "lz4stream.tcc"
+
+#include <ios>
+#include <new>
+
+
+namespace lz4 {
+
+namespace {
+
+struct CCtxDeleter {
+	void operator () (LZ4F_cctx *cctx) const noexcept { LZ4F_freeCompressionContext(cctx); }
+};
+
+struct DCtxDeleter {
+	void operator () (LZ4F_dctx *dctx) const noexcept { LZ4F_freeDecompressionContext(dctx); }
+};
+
+} // namespace
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+static LZ4F_cctx * thread_cctx() {
+	static thread_local std::unique_ptr<LZ4F_cctx, CCtxDeleter> cctx;
+	if (!cctx) {
+		LZ4F_cctx *ptr;
+		check(LZ4F_createCompressionContext(&ptr, LZ4F_VERSION));
+		cctx.reset(ptr);
+	}
+	return cctx.get();
+}
+#endif
+
+static LZ4F_dctx * thread_dctx() {
+	static thread_local std::unique_ptr<LZ4F_dctx, DCtxDeleter> dctx;
+	if (!dctx) {
+		LZ4F_dctx *ptr;
+		check(LZ4F_createDecompressionContext(&ptr, LZ4F_VERSION));
+		dctx.reset(ptr);
+	}
+	return dctx.get();
+}
+
+static LZ4F_preferences_t make_preferences(size_t n, int level) noexcept {
+	LZ4F_preferences_t preferences;
+	std::memset(&preferences, 0, sizeof preferences);
+	preferences.compressionLevel = level;
+	preferences.frameInfo.contentSize = n;
+	return preferences;
+}
+
+static size_t decompress(void *dst, size_t dst_size, const void *src, size_t n, const void *dict, size_t dict_size) {
+	auto dctx = thread_dctx();
+	size_t r = 0;
+	try {
+		for (size_t hint = 1; n > 0;) {
+			size_t dst_chunk = dst_size - r, src_chunk = n;
+#ifdef HAVE_LZ4F_DICTIONARIES
+			hint = check(dict ? LZ4F_decompress_usingDict(dctx, static_cast<uint8_t *>(dst) + r, &dst_chunk, src, &src_chunk, dict, dict_size, nullptr) : LZ4F_decompress(dctx, static_cast<uint8_t *>(dst) + r, &dst_chunk, src, &src_chunk, nullptr));
+#else
+			(void) dict, (void) dict_size;
+			hint = check(LZ4F_decompress(dctx, static_cast<uint8_t *>(dst) + r, &dst_chunk, src, &src_chunk, nullptr));
+#endif
+			r += dst_chunk;
+			src = static_cast<const uint8_t *>(src) + src_chunk, n -= src_chunk;
+			if (hint != 0 && (n == 0 || src_chunk == 0 && dst_chunk == 0)) {
+				throw std::ios_base::failure(n == 0 ? "truncated LZ4 frame" : "LZ4 output buffer too small");
+			}
+		}
+	}
+	catch (...) {
+		// the shared context is left mid-frame, or in an undefined state after an LZ4F error, so ready it for the next call
+		LZ4F_resetDecompressionContext(dctx);
+		throw;
+	}
+	return r;
+}
+
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+Dictionary::Dictionary(const void *dict, size_t size) : cdict(LZ4F_createCDict(dict, size)), dict(static_cast<const char *>(dict), size) {
+	if (!cdict) {
+		throw std::bad_alloc();
+	}
+}
+#endif
+
+
+void throw_error(size_t code) {
+	throw std::ios_base::failure(LZ4F_getErrorName(code));
+}
+
+size_t compress_bound(size_t n, int level) noexcept {
+	auto preferences = make_preferences(n, level);
+	return LZ4F_compressFrameBound(n, &preferences);
+}
+
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, int level) {
+	auto preferences = make_preferences(n, level);
+	return check(LZ4F_compressFrame(dst, dst_size, src, n, &preferences));
+}
+
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n) {
+	return decompress(dst, dst_size, src, n, nullptr, 0);
+}
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary, int level) {
+	auto preferences = make_preferences(n, level);
+	return check(LZ4F_compressFrame_usingCDict(thread_cctx(), dst, dst_size, src, n, dictionary.cdict_ptr(), &preferences));
+}
+
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary) {
+	return decompress(dst, dst_size, src, n, dictionary.data(), dictionary.size());
+}
+#endif
+
+} // namespace lz4
+
+
+template class BasicLZ4Source<Source>;
+template class BasicLZ4Sink<Sink>;
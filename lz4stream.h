@@ -0,0 +1,165 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <lz4.h>
+#include <lz4frame.h>
+
+#include "io.h"
+
+// dictionary compression in the frame format became part of the stable API of liblz4 in 1.10.0
+#if LZ4_VERSION_NUMBER >= 11000
+#define HAVE_LZ4F_DICTIONARIES 1
+#endif
+
+
+namespace lz4 {
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+/**
+ * @brief A digested dictionary, which may be shared among any number of compressors and decompressors.
+ */
+class Dictionary {
+
+private:
+	LZ4F_CDict *cdict;
+	std::string dict;
+
+public:
+	Dictionary(const void *dict, size_t size);
+	Dictionary(Dictionary &&move) noexcept : cdict(move.cdict), dict(std::move(move.dict)) { move.cdict = nullptr; }
+	Dictionary & operator = (Dictionary &&move) noexcept { return this->swap(move), *this; }
+	~Dictionary() { LZ4F_freeCDict(cdict); }
+	void swap(Dictionary &other) noexcept { using std::swap; swap(cdict, other.cdict), swap(dict, other.dict); }
+	friend void swap(Dictionary &lhs, Dictionary &rhs) noexcept { lhs.swap(rhs); }
+
+private:
+	Dictionary(const Dictionary &) = delete;
+	Dictionary & operator = (const Dictionary &) = delete;
+
+public:
+	const LZ4F_CDict * _pure cdict_ptr() const noexcept { return cdict; }
+	const void * _pure data() const noexcept { return dict.data(); }
+	size_t _pure size() const noexcept { return dict.size(); }
+
+};
+#endif
+
+// throws the error denoted by an LZ4F return code
+_noreturn void throw_error(size_t code);
+
+static inline size_t check(size_t code) {
+	if (LZ4F_isError(code)) {
+		throw_error(code);
+	}
+	return code;
+}
+
+size_t compress_bound(size_t n, int level = 0) noexcept;
+
+/**
+ * @brief Compresses a buffer into a single frame that records its content size.
+ *
+ * @return the size of the frame. Throws if \p dst_size is too small, which it cannot be if it is at least \ref compress_bound(\p n, \p level).
+ */
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, int level = 0);
+
+/**
+ * @brief Decompresses all frames in a buffer.
+ *
+ * @return the decompressed size. Throws if \p dst_size is too small or the last frame is truncated.
+ */
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n);
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary, int level = 0);
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary);
+#endif
+
+} // namespace lz4
+
+
+// definitions in lz4stream.tcc; see the note on stream adapters in io.h
+template <typename S = Source>
+class BasicLZ4Source : public Source {
+
+private:
+	S &source;
+	LZ4F_dctx *dctx;
+	const void * const dict;
+	const size_t dict_size;
+	uint8_t ibuf[1 << 16];
+	size_t ipos, iend;
+	bool eof, in_frame;
+
+public:
+	explicit BasicLZ4Source(S &source);
+#ifdef HAVE_LZ4F_DICTIONARIES
+	// the dictionary must outlive this object
+	BasicLZ4Source(S &source, const lz4::Dictionary &dictionary);
+#endif
+	~BasicLZ4Source();
+
+private:
+	BasicLZ4Source(const BasicLZ4Source &) = delete;
+	BasicLZ4Source & operator = (const BasicLZ4Source &) = delete;
+
+public:
+	ssize_t read(void *buf, size_t n) override;
+
+private:
+	BasicLZ4Source(S &source, const void *dict, size_t dict_size);
+
+};
+
+using LZ4Source = BasicLZ4Source<>;
+
+
+/**
+ * @brief Compresses into a sink in the LZ4 frame format.
+ *
+ * @ref flush ends the current frame; a subsequent write begins a new one, and an @ref LZ4Source reads all frames as one stream.
+ */
+template <typename K = Sink>
+class BasicLZ4Sink : public Sink {
+
+private:
+	K &sink;
+	LZ4F_cctx *cctx;
+#ifdef HAVE_LZ4F_DICTIONARIES
+	const LZ4F_CDict * const cdict;
+#endif
+	LZ4F_preferences_t preferences;
+	std::unique_ptr<uint8_t[]> obuf;
+	size_t obuf_size, opos, oend;
+	bool in_frame;
+
+public:
+	/**
+	 * @param[in] level Zero for the fast compressor, or a level up to \c LZ4HC_CLEVEL_MAX for the high-compression one.
+	 */
+	explicit BasicLZ4Sink(K &sink, int level = 0);
+#ifdef HAVE_LZ4F_DICTIONARIES
+	// the dictionary must outlive this object
+	BasicLZ4Sink(K &sink, const lz4::Dictionary &dictionary, int level = 0);
+#endif
+	~BasicLZ4Sink();
+
+private:
+	BasicLZ4Sink(const BasicLZ4Sink &) = delete;
+	BasicLZ4Sink & operator = (const BasicLZ4Sink &) = delete;
+
+public:
+	size_t write(const void *buf, size_t n) override;
+	bool flush() override;
+
+private:
+#ifdef HAVE_LZ4F_DICTIONARIES
+	BasicLZ4Sink(K &sink, const LZ4F_CDict *cdict, int level);
+#endif
+	bool drain();
+
+};
+
+using LZ4Sink = BasicLZ4Sink<>;
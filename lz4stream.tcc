@@ -0,0 +1,148 @@
+#include "lz4stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+template <typename S>
+BasicLZ4Source<S>::BasicLZ4Source(S &source) : BasicLZ4Source(source, nullptr, 0) {
+}
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+template <typename S>
+BasicLZ4Source<S>::BasicLZ4Source(S &source, const lz4::Dictionary &dictionary) : BasicLZ4Source(source, dictionary.data(), dictionary.size()) {
+}
+#endif
+
+template <typename S>
+BasicLZ4Source<S>::BasicLZ4Source(S &source, const void *dict, size_t dict_size) : source(source), dict(dict), dict_size(dict_size), ipos(), iend(), eof(), in_frame() {
+	lz4::check(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION));
+}
+
+template <typename S>
+BasicLZ4Source<S>::~BasicLZ4Source() {
+	LZ4F_freeDecompressionContext(dctx);
+}
+
+template <typename S>
+ssize_t BasicLZ4Source<S>::read(void *buf, size_t n) {
+	if (ipos == iend) {
+		ipos = iend = 0;
+	}
+	if (!eof && iend < sizeof ibuf) {
+		ssize_t r = source.read(ibuf + iend, sizeof ibuf - iend);
+		if (r > 0) {
+			iend += r;
+		}
+		else if (r < 0) {
+			eof = true;
+		}
+	}
+	size_t dst_size = 0;
+	// between frames, a call without input would return the size of the next frame header
+	while (ipos < iend || in_frame) {
+		size_t src_size = iend - ipos;
+		dst_size = n;
+#ifdef HAVE_LZ4F_DICTIONARIES
+		size_t hint = dict ? LZ4F_decompress_usingDict(dctx, buf, &dst_size, ibuf + ipos, &src_size, dict, dict_size, nullptr) : LZ4F_decompress(dctx, buf, &dst_size, ibuf + ipos, &src_size, nullptr);
+#else
+		size_t hint = LZ4F_decompress(dctx, buf, &dst_size, ibuf + ipos, &src_size, nullptr);
+#endif
+		// a hint of zero means that a frame has been completely decoded and flushed
+		in_frame = lz4::check(hint) != 0;
+		ipos += src_size;
+		if (dst_size > 0 || ipos == iend) {
+			break;
+		}
+	}
+	if (dst_size > 0) {
+		return dst_size;
+	}
+	if (eof && ipos == iend) {
+		if (in_frame) {
+			throw std::ios_base::failure("truncated LZ4 frame");
+		}
+		return -1;
+	}
+	return 0;
+}
+
+
+// the largest piece of input fed to the compressor at once, which bounds the size of the output buffer
+static constexpr size_t LZ4_SINK_CHUNK_SIZE = 1 << 16;
+
+#ifdef HAVE_LZ4F_DICTIONARIES
+template <typename K>
+BasicLZ4Sink<K>::BasicLZ4Sink(K &sink, int level) : BasicLZ4Sink(sink, nullptr, level) {
+}
+
+template <typename K>
+BasicLZ4Sink<K>::BasicLZ4Sink(K &sink, const lz4::Dictionary &dictionary, int level) : BasicLZ4Sink(sink, dictionary.cdict_ptr(), level) {
+}
+
+template <typename K>
+BasicLZ4Sink<K>::BasicLZ4Sink(K &sink, const LZ4F_CDict *cdict, int level) : sink(sink), cdict(cdict), opos(), oend(), in_frame() {
+#else
+template <typename K>
+BasicLZ4Sink<K>::BasicLZ4Sink(K &sink, int level) : sink(sink), opos(), oend(), in_frame() {
+#endif
+	std::memset(&preferences, 0, sizeof preferences);
+	preferences.compressionLevel = level;
+	// compress straight from the caller's buffer rather than staging input in the context
+	preferences.autoFlush = 1;
+	obuf_size = LZ4F_compressBound(LZ4_SINK_CHUNK_SIZE, &preferences);
+	obuf.reset(new uint8_t[obuf_size]);
+	lz4::check(LZ4F_createCompressionContext(&cctx, LZ4F_VERSION));
+}
+
+template <typename K>
+BasicLZ4Sink<K>::~BasicLZ4Sink() {
+	LZ4F_freeCompressionContext(cctx);
+}
+
+template <typename K>
+size_t BasicLZ4Sink<K>::write(const void *buf, size_t n) {
+	size_t consumed = 0;
+	while (consumed < n && this->drain()) {
+		if (!in_frame) {
+#ifdef HAVE_LZ4F_DICTIONARIES
+			oend = lz4::check(cdict ? LZ4F_compressBegin_usingCDict(cctx, obuf.get(), obuf_size, cdict, &preferences) : LZ4F_compressBegin(cctx, obuf.get(), obuf_size, &preferences));
+#else
+			oend = lz4::check(LZ4F_compressBegin(cctx, obuf.get(), obuf_size, &preferences));
+#endif
+			opos = 0;
+			in_frame = true;
+			continue;
+		}
+		size_t c = std::min(n - consumed, LZ4_SINK_CHUNK_SIZE);
+		oend = lz4::check(LZ4F_compressUpdate(cctx, obuf.get(), obuf_size, static_cast<const uint8_t *>(buf) + consumed, c, nullptr));
+		opos = 0;
+		consumed += c;
+	}
+	return consumed;
+}
+
+template <typename K>
+bool BasicLZ4Sink<K>::flush() {
+	while (this->drain()) {
+		if (!in_frame) {
+			return sink.flush();
+		}
+		oend = lz4::check(LZ4F_compressEnd(cctx, obuf.get(), obuf_size, nullptr));
+		opos = 0;
+		in_frame = false;
+	}
+	return false;
+}
+
+template <typename K>
+bool BasicLZ4Sink<K>::drain() {
+	while (opos < oend) {
+		size_t w = sink.write(obuf.get() + opos, oend - opos);
+		if (w == 0) {
+			return false;
+		}
+		opos += w;
+	}
+	return true;
+}
@@ -0,0 +1,226 @@
+#include "readahead.h"
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+#include "memory.h"
+
+
+ReadAheadSource::ReadAheadSource(Source &source, size_t buffer_size, unsigned buffer_count) : source(source), buffer_size(buffer_size), buffer_count(buffer_count), head(), filled(), done(), stopping(), gptr(), gend(), holding() {
+	if (buffer_size == 0 || buffer_count == 0 || buffer_size > SIZE_MAX / buffer_count) {
+		throw std::invalid_argument("invalid read-ahead buffer geometry");
+	}
+	storage = make_buffer(buffer_size * buffer_count);
+	sizes.reset(new size_t[buffer_count]);
+	thread = std::thread(std::mem_fn(&ReadAheadSource::run), this);
+}
+
+ReadAheadSource::~ReadAheadSource() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	// if the I/O thread is blocked in the upstream source, this waits for that read to return
+	thread.join();
+}
+
+ssize_t ReadAheadSource::read(void *buf, size_t n) {
+	if (n == 0) {
+		return 0;
+	}
+	if (gptr == gend && !this->next(true)) {
+		return -1;
+	}
+	size_t r = 0;
+	do {
+		size_t c = std::min(n - r, static_cast<size_t>(gend - gptr));
+		std::memcpy(static_cast<uint8_t *>(buf) + r, gptr, c);
+		gptr += c, r += c;
+	} while (r < n && this->next(false));
+	return r;
+}
+
+bool ReadAheadSource::next(bool wait) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (holding) {
+		head = head + 1 == buffer_count ? 0 : head + 1;
+		--filled, holding = false;
+		condition.notify_all();
+	}
+	while (wait && filled == 0 && !done) {
+		condition.wait(lock);
+	}
+	if (filled == 0) {
+		if (wait && exception) {
+			std::rethrow_exception(exception);
+		}
+		return false;
+	}
+	gend = (gptr = storage.get() + head * buffer_size) + sizes[head];
+	holding = true;
+	return true;
+}
+
+void ReadAheadSource::run() noexcept {
+	static constexpr std::chrono::microseconds MIN_BACKOFF(50), MAX_BACKOFF(50000);
+	try {
+		auto backoff = MIN_BACKOFF;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			while (filled == buffer_count && !stopping) {
+				condition.wait(lock);
+			}
+			if (stopping) {
+				return;
+			}
+			unsigned index = (head + filled) % buffer_count;
+			lock.unlock();
+			// the consumer never touches buffers beyond the filled ones, so this one is ours until we publish it
+			uint8_t *buf = storage.get() + index * buffer_size;
+			size_t pos = 0;
+			bool eof = false;
+			while (pos < buffer_size) {
+				ssize_t r = source.read(buf + pos, buffer_size - pos);
+				if (r < 0) {
+					eof = true;
+					break;
+				}
+				if (r == 0) {
+					// hand over what we have rather than wait with data in hand
+					if (pos > 0) {
+						break;
+					}
+					// a non-blocking upstream has nothing for us, so poll it at a decreasing rate until asked to stop
+					lock.lock();
+					if (condition.wait_for(lock, backoff, [this] { return stopping; })) {
+						return;
+					}
+					lock.unlock();
+					backoff = std::min(backoff * 2, MAX_BACKOFF);
+					continue;
+				}
+				backoff = MIN_BACKOFF;
+				pos += r;
+			}
+			lock.lock();
+			if (pos > 0) {
+				sizes[index] = pos;
+				++filled;
+			}
+			done = eof;
+			condition.notify_all();
+			if (eof) {
+				return;
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		exception = std::current_exception();
+		done = true;
+		condition.notify_all();
+	}
+}
+
+
+WriteBehindSink::WriteBehindSink(Sink &sink, size_t buffer_size, unsigned buffer_count) : sink(sink), buffer_size(buffer_size), buffer_count(buffer_count), head(), pending(), flush_requested(), flush_completed(), stopping() {
+	if (buffer_size == 0 || buffer_count == 0 || buffer_size > SIZE_MAX / buffer_count) {
+		throw std::invalid_argument("invalid write-behind buffer geometry");
+	}
+	storage = make_buffer(buffer_size * buffer_count);
+	sizes.reset(new size_t[buffer_count]);
+	eptr = (pptr = bptr = storage.get()) + buffer_size;
+	thread = std::thread(std::mem_fn(&WriteBehindSink::run), this);
+}
+
+WriteBehindSink::~WriteBehindSink() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	thread.join();
+}
+
+size_t WriteBehindSink::write(const void *buf, size_t n) {
+	for (size_t w = 0;;) {
+		size_t c = std::min(n - w, static_cast<size_t>(eptr - pptr));
+		std::memcpy(pptr, static_cast<const uint8_t *>(buf) + w, c);
+		pptr += c, w += c;
+		if (w == n) {
+			return n;
+		}
+		this->submit();
+	}
+}
+
+bool WriteBehindSink::flush() {
+	if (pptr > bptr) {
+		this->submit();
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	unsigned ticket = ++flush_requested;
+	condition.notify_all();
+	while (static_cast<int>(flush_completed - ticket) < 0 && !exception) {
+		condition.wait(lock);
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+	return true;
+}
+
+void WriteBehindSink::submit() {
+	std::unique_lock<std::mutex> lock(mutex);
+	unsigned index = static_cast<unsigned>((bptr - storage.get()) / buffer_size);
+	sizes[index] = pptr - bptr;
+	++pending;
+	condition.notify_all();
+	while (pending == buffer_count && !exception) {
+		condition.wait(lock);
+	}
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+	index = index + 1 == buffer_count ? 0 : index + 1;
+	eptr = (pptr = bptr = storage.get() + index * buffer_size) + buffer_size;
+}
+
+void WriteBehindSink::run() noexcept {
+	try {
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			while (pending == 0 && flush_completed == flush_requested && !stopping) {
+				condition.wait(lock);
+			}
+			if (pending > 0) {
+				const uint8_t *buf = storage.get() + head * buffer_size;
+				size_t size = sizes[head];
+				lock.unlock();
+				sink.write_fully(buf, size);
+				lock.lock();
+				head = head + 1 == buffer_count ? 0 : head + 1;
+				--pending;
+				condition.notify_all();
+			}
+			else if (flush_completed != flush_requested) {
+				unsigned ticket = flush_requested;
+				lock.unlock();
+				sink.flush_fully();
+				lock.lock();
+				flush_completed = ticket;
+				condition.notify_all();
+			}
+			else {
+				return;
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		exception = std::current_exception();
+		condition.notify_all();
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "io.h"
+
+
+/**
+ * @brief Reads ahead from a blocking source on a dedicated thread into a ring of buffers.
+ *
+ * The I/O thread keeps up to \c buffer_count buffers filled while the consumer drains the oldest of them,
+ * so that the upstream's blocking reads overlap with whatever work the consumer does between reads.
+ * The upstream source is used only by the I/O thread for the lifetime of this object.
+ * It should block; a non-blocking upstream that has no data is polled with exponential backoff, up to 50 ms apart.
+ * Exceptions thrown by the upstream source are rethrown by \ref read once the data preceding them have been consumed.
+ */
+class ReadAheadSource : public Source {
+
+private:
+	Source &source;
+	const size_t buffer_size;
+	const unsigned buffer_count;
+	std::unique_ptr<uint8_t[]> storage;
+	std::unique_ptr<size_t[]> sizes;
+	std::mutex mutex;
+	std::condition_variable condition;
+	unsigned head, filled; // guarded by mutex
+	bool done, stopping; // guarded by mutex
+	std::exception_ptr exception; // guarded by mutex
+	const uint8_t *gptr, *gend; // the unread portion of buffer [head] while holding
+	bool holding;
+	std::thread thread;
+
+public:
+	explicit ReadAheadSource(Source &source, size_t buffer_size = 1 << 20, unsigned buffer_count = 2);
+	~ReadAheadSource() override;
+
+public:
+	_nodiscard ssize_t read(void *buf, size_t n) override;
+	size_t avail() override { return gend - gptr; }
+
+private:
+	ReadAheadSource(const ReadAheadSource &) = delete;
+	ReadAheadSource & operator = (const ReadAheadSource &) = delete;
+
+private:
+	bool next(bool wait);
+	void run() noexcept;
+
+};
+
+
+/**
+ * @brief Hands full buffers to a dedicated thread that writes them to a blocking sink.
+ *
+ * \ref write copies into the current buffer and returns immediately unless all \c buffer_count buffers are awaiting the writer thread.
+ * \ref flush submits the current buffer and waits until the writer thread has written and flushed everything submitted.
+ * Exceptions thrown by the downstream sink are rethrown by the next \ref write or \ref flush that has to wait for the writer thread.
+ * Buffers submitted before destruction are written; unflushed data in the current buffer are discarded, as with \ref BufferedSink.
+ */
+class WriteBehindSink : public Sink {
+
+private:
+	Sink &sink;
+	const size_t buffer_size;
+	const unsigned buffer_count;
+	std::unique_ptr<uint8_t[]> storage;
+	std::unique_ptr<size_t[]> sizes;
+	std::mutex mutex;
+	std::condition_variable condition;
+	unsigned head, pending; // guarded by mutex
+	unsigned flush_requested, flush_completed; // guarded by mutex
+	bool stopping; // guarded by mutex
+	std::exception_ptr exception; // guarded by mutex
+	uint8_t *bptr, *pptr, *eptr; // buffer [(head + pending) % buffer_count], owned by the producer
+	std::thread thread;
+
+public:
+	explicit WriteBehindSink(Sink &sink, size_t buffer_size = 1 << 20, unsigned buffer_count = 2);
+	~WriteBehindSink() override;
+
+public:
+	_nodiscard size_t write(const void *buf, size_t n) override;
+	bool flush() override;
+
+private:
+	WriteBehindSink(const WriteBehindSink &) = delete;
+	WriteBehindSink & operator = (const WriteBehindSink &) = delete;
+
+private:
+	void submit();
+	void run() noexcept;
+
+};
@@ -0,0 +1,34 @@
+#include "ringbuffer.h"
+
+#include <algorithm>
+#include <system_error>
+
+#include "fd.h"
+
+
+RingBuffer::RingBuffer(size_t min_size) {
+	size_t page_size = ::sysconf(_SC_PAGESIZE);
+	size_t size = (std::max(min_size, size_t(1)) + page_size - 1) & ~(page_size - 1);
+	if (size > SIZE_MAX / 2) {
+		throw std::bad_alloc();
+	}
+	FileDescriptor fd(posix::memfd_create("RingBuffer"));
+	fd.ftruncate(size);
+	// reserve a contiguous span of address space and then overlay both halves with the same pages
+	map = static_cast<uint8_t *>(posix::mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	try {
+		posix::mmap(map, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+		posix::mmap(map + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+	}
+	catch (...) {
+		::munmap(map, size * 2);
+		throw;
+	}
+	eptr = (pptr = gptr = bptr = map) + size;
+}
+
+RingBuffer::~RingBuffer() {
+	if (map) {
+		::munmap(map, this->size() * 2);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "buffer.h"
+
+
+/**
+ * @brief A circular buffer whose storage is mapped twice at adjacent virtual addresses.
+ *
+ * Because the second mapping mirrors the first, the readable region [gptr, pptr) and the writable region [pptr, eptr)
+ * are always contiguous, even when they wrap around the end of the underlying storage.
+ * @ref compact merely rebases the window in constant time rather than moving any data.
+ *
+ * @ref compact hides the non-virtual StaticBuffer::compact rather than overriding it, so code that would benefit must
+ * call it on a RingBuffer, e.g., by being templated on the buffer type. Through a StaticBuffer reference, compact still
+ * works, as the window lies within the mirrored mapping, but memmoves the unread data as it would in any StaticBuffer.
+ */
+class RingBuffer : public StaticBuffer {
+
+private:
+	uint8_t *map;
+
+public:
+	RingBuffer() noexcept : map() { }
+
+	/**
+	 * @param[in] min_size The minimum capacity of the buffer. It is rounded up to a multiple of the page size.
+	 */
+	explicit RingBuffer(size_t min_size);
+
+	RingBuffer(RingBuffer &&move) noexcept : StaticBuffer(move), map(move.map) { move.map = move.eptr = move.pptr = move.gptr = move.bptr = nullptr; }
+	RingBuffer & operator = (RingBuffer &&move) noexcept { return this->swap(move), *this; }
+	~RingBuffer();
+	void swap(RingBuffer &other) noexcept { using std::swap; swap(static_cast<StaticBuffer &>(*this), static_cast<StaticBuffer &>(other)), swap(map, other.map); }
+	friend void swap(RingBuffer &lhs, RingBuffer &rhs) noexcept { lhs.swap(rhs); }
+
+private:
+	RingBuffer(const RingBuffer &) = delete;
+	RingBuffer & operator = (const RingBuffer &) = delete;
+
+public:
+	// makes all free space writable at pptr without moving any data
+	void compact() noexcept {
+		size_t size = this->size();
+		if (gptr >= map + size) {
+			gptr -= size, pptr -= size;
+		}
+		eptr = (bptr = gptr) + size;
+	}
+
+};
@@ -218,11 +218,25 @@ static inline Sink & operator << (Sink &sink, const std::tuple<Types...> &tuple)
 	return write_tuple<0>(sink, tuple);
 }
 
-template <typename T>
-static inline Buffer serialize(const T &value) {
-	BufferSink sink;
+template <typename T, typename Allocator = MallocAllocator>
+static inline BasicBuffer<uint8_t, Allocator> serialize(const T &value, const Allocator &allocator = Allocator()) {
+	BasicBufferSink<Allocator> sink(allocator);
 	sink << value;
-	return sink;
+	return std::move(sink);
+}
+
+// appends the serialization of the value to the given buffer, reusing its storage
+template <typename T, typename Allocator>
+static inline BasicBuffer<uint8_t, Allocator> & serialize(BasicBuffer<uint8_t, Allocator> &buffer, const T &value) {
+	BasicBufferSink<Allocator> sink(std::move(buffer));
+	try {
+		sink << value;
+	}
+	catch (...) {
+		buffer = std::move(sink);
+		throw;
+	}
+	return buffer = std::move(sink);
 }
 
 template <typename T>
@@ -0,0 +1,159 @@
+#include "tee.h"
+
+#include <cstring>
+#include <functional>
+
+#include "memory.h"
+
+
+void AsyncTee::Branch::detach(std::exception_ptr exception) noexcept {
+	if (!this->is_detached()) {
+		this->exception = std::move(exception);
+		detached.store(true, std::memory_order_release);
+	}
+}
+
+
+AsyncTee::ThreadBranch::ThreadBranch(Sink &sink, size_t max_lag, bool block) : Branch(max_lag), sink(sink), block(block), in_flight(), flush_pending(), stopping() {
+	thread = std::thread(std::mem_fn(&ThreadBranch::run), this);
+}
+
+AsyncTee::ThreadBranch::~ThreadBranch() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	writer_condition.notify_one();
+	thread.join();
+}
+
+size_t AsyncTee::ThreadBranch::lag() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return queue.size() + in_flight;
+}
+
+void AsyncTee::ThreadBranch::push(BufferChain &&chain) {
+	std::unique_lock<std::mutex> lock(mutex);
+	// a chain larger than max_lag is let through once the branch has caught up entirely, lest it wait forever
+	while (queue.size() + in_flight + chain.size() > max_lag && queue.size() + in_flight > 0 && !this->is_detached()) {
+		if (!block) {
+			this->detach();
+			queue.clear();
+			break;
+		}
+		producer_condition.wait(lock);
+	}
+	if (this->is_detached()) {
+		return;
+	}
+	queue.append(std::move(chain));
+	writer_condition.notify_one();
+}
+
+bool AsyncTee::ThreadBranch::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	flush_pending = true;
+	writer_condition.notify_one();
+	return queue.empty() && in_flight == 0;
+}
+
+void AsyncTee::ThreadBranch::run() noexcept {
+	std::unique_lock<std::mutex> lock(mutex);
+	try {
+		for (;;) {
+			while (queue.empty() && !flush_pending && !stopping) {
+				writer_condition.wait(lock);
+			}
+			if (!queue.empty()) {
+				BufferChain batch;
+				batch.swap(queue);
+				in_flight = batch.size();
+				lock.unlock();
+				sink.write_fully(batch);
+				lock.lock();
+				in_flight = 0;
+				producer_condition.notify_all();
+			}
+			else if (flush_pending) {
+				flush_pending = false;
+				lock.unlock();
+				sink.flush_fully();
+				lock.lock();
+			}
+			else {
+				return;
+			}
+		}
+	}
+	catch (...) {
+		if (!lock.owns_lock()) {
+			lock.lock();
+		}
+		this->detach(std::current_exception());
+		queue.clear();
+		in_flight = 0;
+		producer_condition.notify_all();
+	}
+}
+
+
+void AsyncTee::SelectorBranch::push(BufferChain &&chain) {
+	if (stream.queued() + chain.size() > max_lag && stream.queued() > 0) {
+		return this->detach();
+	}
+	try {
+		stream.write(std::move(chain));
+	}
+	catch (...) {
+		this->detach(std::current_exception());
+	}
+}
+
+bool AsyncTee::SelectorBranch::flush() {
+	try {
+		stream.flush();
+		return stream.queued() == 0;
+	}
+	catch (...) {
+		this->detach(std::current_exception());
+		return true;
+	}
+}
+
+
+size_t AsyncTee::write(const void *buf, size_t n) {
+	if (n > 0) {
+		std::shared_ptr<uint8_t[]> owner(make_buffer(n));
+		auto copy = owner.get();
+		std::memcpy(copy, buf, n);
+		BufferChain chain;
+		chain.append(std::move(owner), copy, n);
+		this->write(std::move(chain));
+	}
+	return n;
+}
+
+void AsyncTee::write(BufferChain &&chain) {
+	Branch *last = nullptr;
+	for (auto &branch : branches) {
+		if (!branch->is_detached()) {
+			if (last) {
+				last->push(BufferChain(chain));
+			}
+			last = branch.get();
+		}
+	}
+	if (last) {
+		last->push(std::move(chain));
+	}
+}
+
+bool AsyncTee::flush() {
+	bool ret = true;
+	for (auto &branch : branches) {
+		if (!branch->is_detached()) {
+			ret &= branch->flush();
+		}
+	}
+	return ret;
+}
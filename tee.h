@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "async.h"
+#include "iobuf.h"
+
+
+/**
+ * @brief Fans written data out to any number of sinks, each draining its own queue at its own pace.
+ *
+ * Unlike @ref Tee, a slow sink does not hold up the others. Each written buffer is copied at most once and then shared
+ * by reference among the queues of all branches. A branch whose lag would exceed its \c max_lag either makes the writer
+ * wait for it or is detached, per its policy; a branch whose sink throws is detached, and its exception is retained.
+ */
+class AsyncTee : public Sink {
+
+public:
+	class Branch {
+		friend AsyncTee;
+	protected:
+		const size_t max_lag;
+	private:
+		std::atomic<bool> detached;
+		std::exception_ptr exception; // written before detached is set
+	public:
+		virtual ~Branch() = default;
+	protected:
+		explicit Branch(size_t max_lag) noexcept : max_lag(max_lag), detached() { }
+	private:
+		Branch(const Branch &) = delete;
+		Branch & operator = (const Branch &) = delete;
+	public:
+		// returns the number of bytes written to the tee that this branch has yet to write to its sink
+		virtual size_t lag() const = 0;
+		bool is_detached() const noexcept { return detached.load(std::memory_order_acquire); }
+		// returns the exception that detached this branch, if any
+		std::exception_ptr error() const noexcept { return this->is_detached() ? exception : nullptr; }
+	protected:
+		virtual void push(BufferChain &&chain) = 0;
+		virtual bool flush() = 0;
+		void detach(std::exception_ptr exception = nullptr) noexcept;
+	};
+
+	/**
+	 * @brief A branch drained by a dedicated thread that writes to a blocking sink.
+	 *
+	 * If \c block is \c true, a write to the tee that would make this branch's lag exceed \c max_lag waits for it to catch up;
+	 * otherwise the branch is detached.
+	 */
+	class ThreadBranch : public Branch {
+	private:
+		Sink &sink;
+		const bool block;
+		mutable std::mutex mutex;
+		std::condition_variable writer_condition, producer_condition;
+		BufferChain queue; // guarded by mutex
+		size_t in_flight; // guarded by mutex
+		bool flush_pending, stopping; // guarded by mutex
+		std::thread thread;
+	public:
+		explicit ThreadBranch(Sink &sink, size_t max_lag = SIZE_MAX, bool block = true);
+		~ThreadBranch() override;
+	public:
+		size_t lag() const override;
+	protected:
+		void push(BufferChain &&chain) override;
+		bool flush() override;
+	private:
+		void run() noexcept;
+	};
+
+	/**
+	 * @brief A branch whose queue is the write queue of an @ref AsyncStream, drained by its selector.
+	 *
+	 * The reactor thread must never wait, so this branch is detached if its lag would exceed \c max_lag.
+	 * Writes to a tee with such a branch must be made on the thread that pumps the stream's selector.
+	 */
+	class SelectorBranch : public Branch {
+	private:
+		AsyncStream &stream;
+	public:
+		explicit SelectorBranch(AsyncStream &stream, size_t max_lag = SIZE_MAX) noexcept : Branch(max_lag), stream(stream) { }
+	public:
+		size_t lag() const override { return stream.queued(); }
+	protected:
+		void push(BufferChain &&chain) override;
+		bool flush() override;
+	};
+
+private:
+	std::vector<std::unique_ptr<Branch>> branches;
+
+public:
+	AsyncTee() = default;
+
+public:
+	template <typename B, typename... Args>
+	B & add(Args&&... args) {
+		auto branch = std::make_unique<B>(std::forward<Args>(args)...);
+		auto &ret = *branch;
+		branches.push_back(std::move(branch));
+		return ret;
+	}
+
+	size_t _pure branch_count() const noexcept { return branches.size(); }
+	const Branch & _pure branch(size_t i) const noexcept { return *branches[i]; }
+
+public:
+	using Sink::write;
+	_nodiscard size_t write(const void *buf, size_t n) override;
+
+	// shares the slices of the chain among all branches without copying them
+	void write(BufferChain &&chain);
+
+	/**
+	 * @brief Asks every attached branch to flush its sink once it has drained its queue.
+	 *
+	 * @return whether every attached branch has already drained its queue.
+	 */
+	bool flush() override;
+
+};
@@ -0,0 +1,89 @@
+#include "../http.tcc"
+#include "../io.tcc"
+
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/*
+ * Reads a chunked body through MemorySource -> LimitedSource -> BufferedSource -> ChunkedSource in small pieces,
+ * once through the dynamic (virtual) adapters and once through statically composed, sealed ones. ChunkedSource parses
+ * the chunk framing in place when its upstream is peekable, as BufferedSource is; each pipeline is also run without the
+ * BufferedSource stage, which makes ChunkedSource frame the body a byte at a time.
+ */
+
+static std::string make_chunked_body(size_t chunk_count, size_t chunk_size) {
+	std::string body;
+	std::string chunk(chunk_size, 'x');
+	char size_line[32];
+	for (size_t i = 0; i < chunk_count; ++i) {
+		body.append(size_line, std::snprintf(size_line, sizeof size_line, "%zx\r\n", chunk_size));
+		body.append(chunk).append("\r\n");
+	}
+	return body.append("0\r\n\r\n");
+}
+
+template <typename Chunked>
+static size_t drain(Chunked &chunked) {
+	size_t total = 0;
+	char buf[61];
+	for (ssize_t r; (r = chunked.read(buf, sizeof buf)) >= 0;) {
+		total += r;
+	}
+	return total;
+}
+
+static size_t dynamic_peek_pipeline(const std::string &body) {
+	MemorySource memory(body.data(), body.size());
+	LimitedSource limited(memory, body.size());
+	BufferedSource<4096> buffered(limited);
+	ChunkedSource chunked(buffered);
+	return drain(chunked);
+}
+
+static size_t static_peek_pipeline(const std::string &body) {
+	Final<MemorySource> memory(body.data(), body.size());
+	Final<BasicLimitedSource<decltype(memory)>> limited(memory, body.size());
+	Final<BufferedSource<4096, decltype(limited)>> buffered(limited);
+	BasicChunkedSource chunked(buffered);
+	return drain(chunked);
+}
+
+static size_t dynamic_byte_pipeline(const std::string &body) {
+	MemorySource memory(body.data(), body.size());
+	BufferedSource<4096> buffered(memory);
+	LimitedSource limited(buffered, body.size());
+	ChunkedSource chunked(limited);
+	return drain(chunked);
+}
+
+static size_t static_byte_pipeline(const std::string &body) {
+	Final<MemorySource> memory(body.data(), body.size());
+	Final<BufferedSource<4096, decltype(memory)>> buffered(memory);
+	Final<BasicLimitedSource<decltype(buffered)>> limited(buffered, body.size());
+	BasicChunkedSource chunked(limited);
+	return drain(chunked);
+}
+
+template <typename Func>
+static void bench(const char name[], Func &&func, const std::string &body, size_t expected) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < 50; ++i) {
+		size_t total = func(body);
+		assert(total == expected);
+		(void) total, (void) expected;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << name << ": " << static_cast<double>(50 * body.size()) / elapsed.count() / (1 << 20) << " MiB/s" << std::endl;
+}
+
+int main() {
+	const size_t chunk_count = 1 << 14, chunk_size = 1000;
+	auto body = make_chunked_body(chunk_count, chunk_size);
+	bench("dynamic, peeking", dynamic_peek_pipeline, body, chunk_count * chunk_size);
+	bench("static, peeking", static_peek_pipeline, body, chunk_count * chunk_size);
+	bench("dynamic, bytewise", dynamic_byte_pipeline, body, chunk_count * chunk_size);
+	bench("static, bytewise", static_byte_pipeline, body, chunk_count * chunk_size);
+	return 0;
+}
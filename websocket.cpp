@@ -1,15 +1,19 @@
 #include "websocket.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "base64.h"
 #include "codec.h"
 #include "connect.h"
 #include "endian.h"
 #include "memory.h"
+#include "narrow.h"
 #include "sha.h"
 
 using namespace ci::literals;
@@ -44,6 +48,134 @@ static void memxor32(void *buf, size_t n, uint32_t mask, size_t phase) {
 }
 
 
+using z_avail_t = decltype(z_stream::avail_in);
+static_assert(std::is_same_v<decltype(z_stream::avail_out), z_avail_t>, "");
+
+// the empty stored block that ends the output of a flush, which permessage-deflate omits from each message
+static const uint8_t DEFLATE_TRAILER[4] = { 0x00, 0x00, 0xFF, 0xFF };
+
+
+WebSocketDeflater::WebSocketDeflater(unsigned window_bits, bool context_takeover, int level) : context_takeover(context_takeover) {
+	std::memset(&stream, 0, sizeof stream);
+	if (::deflateInit2(&stream, level, Z_DEFLATED, -static_cast<int>(window_bits) /* raw deflate */, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		throw std::runtime_error(stream.msg ? stream.msg : "invalid deflate parameters");
+	}
+}
+
+WebSocketDeflater::~WebSocketDeflater() {
+	::deflateEnd(&stream);
+}
+
+void WebSocketDeflater::deflate(Buffer &out, const void *buf, size_t n) {
+	out.clear();
+	if (n == 0) {
+		// an empty message is a lone stored block header (RFC 7692 §7.2.3.6), which leaves the stream as it was
+		out.append("", 1);
+		return;
+	}
+	out.ensure(::deflateBound(&stream, n) + 8);
+	stream.next_in = static_cast<const Bytef *>(buf);
+	do {
+		n -= stream.avail_in = saturate<z_avail_t>(n);
+		do {
+			if (out.prem() < 8) {
+				out.ensure(out.size() * 2);
+			}
+			stream.next_out = out.pptr;
+			stream.avail_out = saturate<z_avail_t>(out.prem());
+			::deflate(&stream, n ? Z_NO_FLUSH : Z_SYNC_FLUSH);
+			out.pptr = stream.next_out;
+		} while (stream.avail_out == 0);
+	} while (n > 0);
+	out.pptr -= sizeof DEFLATE_TRAILER;
+	if (!context_takeover) {
+		::deflateReset(&stream);
+	}
+}
+
+
+WebSocketInflater::WebSocketInflater(bool context_takeover) : context_takeover(context_takeover) {
+	std::memset(&stream, 0, sizeof stream);
+	// a window of the largest size can decompress data that were compressed in a window of any size
+	if (::inflateInit2(&stream, -15 /* raw deflate */) != Z_OK) {
+		throw std::runtime_error(stream.msg);
+	}
+}
+
+WebSocketInflater::~WebSocketInflater() {
+	::inflateEnd(&stream);
+}
+
+void WebSocketInflater::inflate(Buffer &out, const void *data, size_t n, bool final, size_t max_size) {
+	this->inflate(out, data, n, max_size);
+	if (final) {
+		this->inflate(out, DEFLATE_TRAILER, sizeof DEFLATE_TRAILER, max_size);
+		if (!context_takeover) {
+			::inflateReset(&stream);
+		}
+	}
+}
+
+void WebSocketInflater::inflate(Buffer &out, const void *data, size_t n, size_t max_size) {
+	stream.next_in = static_cast<const Bytef *>(data);
+	do {
+		n -= stream.avail_in = saturate<z_avail_t>(n);
+		do {
+			if (out.prem() == 0) {
+				out.ensure(std::max<size_t>(out.size() * 2, 1 << 12));
+			}
+			// offer a byte more than the cap allows, so that output beyond it is detected rather than presumed
+			size_t room = max_size - std::min(out.grem(), max_size);
+			stream.next_out = out.pptr;
+			stream.avail_out = saturate<z_avail_t>(std::min(out.prem(), room == SIZE_MAX ? room : room + 1));
+			int ret = ::inflate(&stream, Z_SYNC_FLUSH);
+			out.pptr = stream.next_out;
+			if (out.grem() > max_size) {
+				out.pptr -= out.grem() - max_size;
+				throw std::ios_base::failure("decompressed WebSocket message too large");
+			}
+			if (ret == Z_STREAM_END) {
+				// the sender ended the stream with a final block, so the next message begins a new one
+				::inflateReset(&stream);
+				stream.avail_in = 0;
+				return;
+			}
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				throw std::ios_base::failure(stream.msg ? stream.msg : "corrupt compressed WebSocket message");
+			}
+		} while (stream.avail_in > 0 || stream.avail_out == 0);
+	} while (n > 0);
+}
+
+
+auto WebSocket::check_opcode(uint8_t byte0) -> Opcode {
+	auto opcode = static_cast<Opcode>(byte0 & 0xF);
+	// RSV1 marks the first frame of a compressed message when permessage-deflate is enabled
+	if (byte0 & (inflater && (opcode == Text || opcode == Binary) ? 0x30 : 0x70)) {
+		throw std::ios_base::failure("received WebSocket frame with non-zero reserved bits");
+	}
+	switch (opcode) {
+		case Text:
+		case Binary:
+			recv_compressed = byte0 & 0x40;
+			_fallthrough;
+		case Continuation:
+			recv_control = false;
+			break;
+		case Close:
+		case Ping:
+		case Pong:
+			if (!(byte0 & 0x80)) {
+				throw std::ios_base::failure("received fragmented WebSocket control frame");
+			}
+			recv_control = true;
+			break;
+		default:
+			throw std::ios_base::failure("received WebSocket frame with unrecognized opcode");
+	}
+	return opcode;
+}
+
 ssize_t WebSocket::receive(Opcode &opcode, void *buf, size_t n) {
 	if (static_cast<int8_t>(recv_hdr_pos) >= 0) {
 		if (recv_hdr_pos == 0) {
@@ -55,25 +187,7 @@ ssize_t WebSocket::receive(Opcode &opcode, void *buf, size_t n) {
 				}
 				return 0;
 			}
-			if (recv_state & 0x70) {
-				throw std::ios_base::failure("received WebSocket frame with non-zero reserved bits");
-			}
-			opcode = static_cast<Opcode>(recv_state & 0xF);
-			switch (opcode) {
-				case Continuation:
-				case Text:
-				case Binary:
-					break;
-				case Close:
-				case Ping:
-				case Pong:
-					if (!(recv_state & 0x80)) {
-						throw std::ios_base::failure("received fragmented WebSocket control frame");
-					}
-					break;
-				default:
-					throw std::ios_base::failure("received WebSocket frame with unrecognized opcode");
-			}
+			opcode = check_opcode(recv_state);
 			if (r == 1) {
 				recv_hdr_pos = 1;
 				return 0;
@@ -153,45 +267,186 @@ ssize_t WebSocket::receive(Opcode &opcode, void *buf, size_t n) {
 	return r;
 }
 
-bool WebSocket::send(Opcode opcode, const void *buf, size_t n, bool more) {
-	if (static_cast<int8_t>(send_hdr_pos) >= 0) {
-		uint8_t send_hdr[14];
-		size_t send_hdr_len = 2;
-		send_hdr[0] = opcode & 0xF;
-		if (!more) {
-			send_hdr[0] |= 0x80;
+ssize_t WebSocket::receive(Opcode &opcode, BufferedSourceBase &source, void *&data, size_t n) {
+	void *ptr;
+	ssize_t r;
+	if (static_cast<int8_t>(recv_hdr_pos) >= 0) {
+		if (recv_hdr_pos != 0) {
+			throw std::logic_error("WebSocket frame header partially received by other overload");
 		}
-		if (n >> 16) {
-			send_hdr[1] = 127;
-#if SIZE_MAX > UINT32_MAX
-			send_hdr[2] = static_cast<uint8_t>(n >> 56);
-			send_hdr[3] = static_cast<uint8_t>(n >> 48);
-			send_hdr[4] = static_cast<uint8_t>(n >> 40);
-			send_hdr[5] = static_cast<uint8_t>(n >> 32);
-#else
-			send_hdr[5] = send_hdr[4] = send_hdr[3] = send_hdr[2] = 0;
-#endif
-			send_hdr[6] = static_cast<uint8_t>(n >> 24);
-			send_hdr[7] = static_cast<uint8_t>(n >> 16);
-			send_hdr[8] = static_cast<uint8_t>(n >> 8);
-			send_hdr[9] = static_cast<uint8_t>(n);
-			send_hdr_len += 8;
+		if ((r = source.peek(ptr, 2)) < 2) {
+			if (r < 0) {
+				opcode = End;
+				return r;
+			}
+			return 0;
 		}
-		else if (n > 125) {
-			send_hdr[1] = 126;
-			send_hdr[2] = static_cast<uint8_t>(n >> 8);
-			send_hdr[3] = static_cast<uint8_t>(n);
-			send_hdr_len += 2;
+		auto hdr = static_cast<const uint8_t *>(ptr);
+		opcode = check_opcode(hdr[0]);
+		size_t payload_len = hdr[1] & 0x7F, hdr_size = 2 + (payload_len == 127 ? sizeof(uint64_t) : payload_len == 126 ? sizeof(uint16_t) : 0) + (hdr[1] & 0x80 ? sizeof recv_mask : 0);
+		if ((r = source.peek(ptr, hdr_size)) < static_cast<ssize_t>(hdr_size)) {
+			if (r < 0) {
+				opcode = End;
+				return r;
+			}
+			return 0;
+		}
+		hdr = static_cast<const uint8_t *>(ptr);
+		if (payload_len == 127) {
+			uint64_t len;
+			std::memcpy(&len, hdr + 2, sizeof len);
+			recv_data_rem = static_cast<size_t>(as_be(len));
+		}
+		else if (payload_len == 126) {
+			uint16_t len;
+			std::memcpy(&len, hdr + 2, sizeof len);
+			recv_data_rem = as_be(len);
 		}
 		else {
-			send_hdr[1] = static_cast<uint8_t>(n);
+			recv_data_rem = payload_len;
 		}
-		if (send_mask) {
-			send_hdr[1] |= 0x80;
-			// always send a null mask, as this lets us avoid XORing the data
-			std::memset(send_hdr + send_hdr_len, 0, sizeof(uint32_t));
-			send_hdr_len += sizeof(uint32_t);
+		if (hdr[1] & 0x80) {
+			std::memcpy(&recv_mask, hdr + hdr_size - sizeof recv_mask, sizeof recv_mask);
 		}
+		else {
+			recv_mask = 0;
+		}
+		recv_state = static_cast<uint8_t>(hdr[0] & 0x80 | hdr[1] & 0x7F);
+		recv_hdr_pos = ~0;
+		source.consume(hdr_size);
+	}
+	if (recv_data_rem == 0) {
+		recv_hdr_pos = 0;
+		return -1; // end of frame
+	}
+	if (n == 0 || (r = source.peek(ptr)) == 0) {
+		return 0;
+	}
+	if (r < 0) {
+		opcode = End;
+		return r;
+	}
+	r = std::min(std::min(static_cast<size_t>(r), recv_data_rem), n);
+	source.consume(r);
+	recv_data_rem -= r;
+	if (recv_mask) {
+		memxor32(ptr, r, recv_mask, ~recv_hdr_pos);
+		recv_hdr_pos = static_cast<uint8_t>(~((~recv_hdr_pos + r) % sizeof recv_mask));
+	}
+	data = ptr;
+	return r;
+}
+
+void WebSocket::enable_deflate(const WebSocketDeflateParams &params, int level) {
+	if (send_mask) {
+		deflater = std::make_unique<WebSocketDeflater>(params.client_max_window_bits, !params.client_no_context_takeover, level);
+		inflater = std::make_unique<WebSocketInflater>(!params.server_no_context_takeover);
+	}
+	else {
+		deflater = std::make_unique<WebSocketDeflater>(params.server_max_window_bits, !params.server_no_context_takeover, level);
+		inflater = std::make_unique<WebSocketInflater>(!params.client_no_context_takeover);
+	}
+}
+
+void WebSocket::inflate(Buffer &out, const void *data, size_t n, bool final, size_t max_size) {
+	if (!this->is_compressed()) {
+		throw std::logic_error("WebSocket message is not compressed");
+	}
+	inflater->inflate(out, data, n, final, max_size);
+}
+
+size_t WebSocket::make_header(uint8_t (&hdr)[14], Opcode opcode, size_t n, bool more, bool compressed) const noexcept {
+	size_t hdr_len = 2;
+	hdr[0] = opcode & 0xF;
+	if (!more) {
+		hdr[0] |= 0x80;
+	}
+	if (compressed) {
+		hdr[0] |= 0x40;
+	}
+	if (n >> 16) {
+		hdr[1] = 127;
+#if SIZE_MAX > UINT32_MAX
+		hdr[2] = static_cast<uint8_t>(n >> 56);
+		hdr[3] = static_cast<uint8_t>(n >> 48);
+		hdr[4] = static_cast<uint8_t>(n >> 40);
+		hdr[5] = static_cast<uint8_t>(n >> 32);
+#else
+		hdr[5] = hdr[4] = hdr[3] = hdr[2] = 0;
+#endif
+		hdr[6] = static_cast<uint8_t>(n >> 24);
+		hdr[7] = static_cast<uint8_t>(n >> 16);
+		hdr[8] = static_cast<uint8_t>(n >> 8);
+		hdr[9] = static_cast<uint8_t>(n);
+		hdr_len += 8;
+	}
+	else if (n > 125) {
+		hdr[1] = 126;
+		hdr[2] = static_cast<uint8_t>(n >> 8);
+		hdr[3] = static_cast<uint8_t>(n);
+		hdr_len += 2;
+	}
+	else {
+		hdr[1] = static_cast<uint8_t>(n);
+	}
+	if (send_mask) {
+		hdr[1] |= 0x80;
+		// always send a null mask, as this lets us avoid XORing the data
+		std::memset(hdr + hdr_len, 0, sizeof(uint32_t));
+		hdr_len += sizeof(uint32_t);
+	}
+	return hdr_len;
+}
+
+bool WebSocket::send(Opcode opcode, const void *buf, size_t n, bool more) {
+	return this->send_frame(opcode, buf, n, more, false);
+}
+
+void WebSocket::send(Sink &sink, Opcode opcode, const void *buf, size_t n, bool more) {
+	this->send_frame(sink, opcode, buf, n, more, false);
+}
+
+bool WebSocket::send_message(Opcode opcode, const void *buf, size_t n) {
+	if (!deflater || (opcode != Text && opcode != Binary)) {
+		return this->send_frame(opcode, buf, n, false, false);
+	}
+	if (deflated.grem() == 0) {
+		deflater->deflate(deflated, buf, n);
+	}
+	if (!this->send_frame(opcode, deflated.gptr, deflated.grem(), false, true)) {
+		return false;
+	}
+	deflated.clear();
+	return true;
+}
+
+void WebSocket::send_message(Sink &sink, Opcode opcode, const void *buf, size_t n) {
+	if (!deflater || (opcode != Text && opcode != Binary)) {
+		return this->send_frame(sink, opcode, buf, n, false, false);
+	}
+	deflater->deflate(deflated, buf, n);
+	this->send_frame(sink, opcode, deflated.gptr, deflated.grem(), false, true);
+	deflated.clear();
+}
+
+bool WebSocket::send_compressed(Opcode opcode, const void *buf, size_t n) {
+	if (!deflater) {
+		throw std::logic_error("permessage-deflate is not enabled");
+	}
+	return this->send_frame(opcode, buf, n, false, true);
+}
+
+void WebSocket::send_compressed(Sink &sink, Opcode opcode, const void *buf, size_t n) {
+	if (!deflater) {
+		throw std::logic_error("permessage-deflate is not enabled");
+	}
+	this->send_frame(sink, opcode, buf, n, false, true);
+}
+
+bool WebSocket::send_frame(Opcode opcode, const void *buf, size_t n, bool more, bool compressed) {
+	if (static_cast<int8_t>(send_hdr_pos) >= 0) {
+		uint8_t send_hdr[14];
+		size_t send_hdr_len = this->make_header(send_hdr, opcode, n, more, compressed);
 		size_t w = socket.write({ { send_hdr + send_hdr_pos, send_hdr_len -= send_hdr_pos }, { buf, send_data_rem = n } });
 		if (w < send_hdr_len) {
 			send_hdr_pos = static_cast<uint8_t>(send_hdr_pos + w);
@@ -207,6 +462,7 @@ bool WebSocket::send(Opcode opcode, const void *buf, size_t n, bool more) {
 		if ((send_data_rem -= socket.write(static_cast<const uint8_t *>(buf) + n - send_data_rem, send_data_rem)) > 0) {
 			return false;
 		}
+		send_hdr_pos = 0;
 	}
 	if (!more) {
 		socket.flush();
@@ -214,6 +470,15 @@ bool WebSocket::send(Opcode opcode, const void *buf, size_t n, bool more) {
 	return true;
 }
 
+void WebSocket::send_frame(Sink &sink, Opcode opcode, const void *buf, size_t n, bool more, bool compressed) {
+	uint8_t hdr[14];
+	size_t hdr_len = this->make_header(hdr, opcode, n, more, compressed);
+	sink.write_fully({ { hdr, hdr_len }, { buf, n } });
+	if (!more) {
+		sink.flush_fully();
+	}
+}
+
 
 static std::string make_accept_field_value(std::string_view key) {
 	SHA1 sha1;
@@ -223,6 +488,127 @@ static std::string make_accept_field_value(std::string_view key) {
 	return transcode<Base64Encoder>(hash.data(), hash.size());
 }
 
+namespace {
+struct DeflateExtension {
+	WebSocketDeflateParams params;
+	bool server_max_window_bits, client_max_window_bits; // whether present
+	bool valid;
+};
+}
+
+static std::string_view _pure trim(std::string_view sv) noexcept {
+	while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t')) {
+		sv.remove_prefix(1);
+	}
+	while (!sv.empty() && (sv.back() == ' ' || sv.back() == '\t')) {
+		sv.remove_suffix(1);
+	}
+	return sv;
+}
+
+static bool parse_window_bits(uint8_t &bits, std::string_view value) noexcept {
+	if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+		value = value.substr(1, value.size() - 2);
+	}
+	if (value.size() == 1 && value[0] >= '8' && value[0] <= '9') {
+		bits = static_cast<uint8_t>(value[0] - '0');
+	}
+	else if (value.size() == 2 && value[0] == '1' && value[1] >= '0' && value[1] <= '5') {
+		bits = static_cast<uint8_t>(10 + (value[1] - '0'));
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// parses the permessage-deflate elements of the Sec-WebSocket-Extensions header fields, in order of preference
+static std::vector<DeflateExtension> parse_deflate_extensions(const HttpHeaders &headers) {
+	std::vector<DeflateExtension> extensions;
+	auto range = headers.equal_range("Sec-WebSocket-Extensions"_ci);
+	for (auto itr = range.first; itr != range.second; ++itr) {
+		for (std::string_view list = itr->second; !list.empty();) {
+			size_t comma = list.find(',');
+			std::string_view element = list.substr(0, comma);
+			list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+			size_t semicolon = element.find(';');
+			if (trim(element.substr(0, semicolon)) != "permessage-deflate"_ci) {
+				continue;
+			}
+			DeflateExtension &extension = extensions.emplace_back();
+			extension.valid = true;
+			while (semicolon != std::string_view::npos) {
+				element.remove_prefix(semicolon + 1);
+				std::string_view param = element.substr(0, semicolon = element.find(';'));
+				size_t equals = param.find('=');
+				std::string_view name = trim(param.substr(0, equals)), value = equals == std::string_view::npos ? std::string_view() : trim(param.substr(equals + 1));
+				bool duplicate;
+				if (name == "server_no_context_takeover") {
+					duplicate = std::exchange(extension.params.server_no_context_takeover, true);
+					extension.valid &= equals == std::string_view::npos;
+				}
+				else if (name == "client_no_context_takeover") {
+					duplicate = std::exchange(extension.params.client_no_context_takeover, true);
+					extension.valid &= equals == std::string_view::npos;
+				}
+				else if (name == "server_max_window_bits") {
+					duplicate = std::exchange(extension.server_max_window_bits, true);
+					extension.valid &= parse_window_bits(extension.params.server_max_window_bits, value);
+				}
+				else if (name == "client_max_window_bits") {
+					// a client may offer this without a value to say only that it supports it
+					duplicate = std::exchange(extension.client_max_window_bits, true);
+					extension.valid &= equals == std::string_view::npos || parse_window_bits(extension.params.client_max_window_bits, value);
+				}
+				else {
+					duplicate = false, extension.valid = false;
+				}
+				extension.valid &= !duplicate;
+			}
+		}
+	}
+	return extensions;
+}
+
+static std::string format_deflate_extension(const WebSocketDeflateParams &params, bool server_max_window_bits, bool client_max_window_bits) {
+	std::ostringstream ss;
+	ss << "permessage-deflate";
+	if (params.server_no_context_takeover) {
+		ss << "; server_no_context_takeover";
+	}
+	if (params.client_no_context_takeover) {
+		ss << "; client_no_context_takeover";
+	}
+	if (server_max_window_bits) {
+		ss << "; server_max_window_bits=" << unsigned(params.server_max_window_bits);
+	}
+	if (client_max_window_bits) {
+		ss << "; client_max_window_bits";
+		if (params.client_max_window_bits < 15) {
+			ss << '=' << unsigned(params.client_max_window_bits);
+		}
+	}
+	return ss.str();
+}
+
+// accepts the first offer of permessage-deflate that is compatible with the server's configuration
+static std::optional<WebSocketDeflateParams> negotiate_deflate(const HttpRequestHeaders &request_headers, const WebSocketDeflateParams &config) {
+	for (auto &offer : parse_deflate_extensions(request_headers)) {
+		if (!offer.valid || config.client_max_window_bits < 15 && !offer.client_max_window_bits) {
+			continue;
+		}
+		WebSocketDeflateParams params;
+		params.server_max_window_bits = std::min(offer.params.server_max_window_bits, config.server_max_window_bits);
+		params.client_max_window_bits = std::min(offer.params.client_max_window_bits, config.client_max_window_bits);
+		params.server_no_context_takeover = offer.params.server_no_context_takeover || config.server_no_context_takeover;
+		params.client_no_context_takeover = offer.params.client_no_context_takeover || config.client_no_context_takeover;
+		if (params.server_max_window_bits >= 9) {
+			return params;
+		}
+	}
+	return std::nullopt;
+}
+
 bool WebSocketServerHandshake::ready() {
 	ssize_t r;
 	if ((r = socket.read(request_buf.data() + request_pos, request_buf.size() - request_pos)) < 0) {
@@ -258,7 +644,12 @@ bool WebSocketServerHandshake::ready() {
 				response_headers.emplace_hint(response_headers.end(), "Connection", "Upgrade");
 				response_headers.emplace_hint(response_headers.end(), "Sec-WebSocket-Accept", make_accept_field_value(key_itr->second));
 				response_headers.emplace_hint(response_headers.end(), "Upgrade", "websocket");
+				if (deflate_config && (deflate = negotiate_deflate(request_headers, *deflate_config))) {
+					response_headers.emplace("Sec-WebSocket-Extensions", format_deflate_extension(*deflate, deflate->server_max_window_bits < 15, deflate->client_max_window_bits < 15));
+				}
 				this->prepare_response_headers(request_headers, response_headers);
+				// the response is the first data written to the connection and fits in its empty send buffer, so the blocking
+				// SinkBuf does not block; should it find the buffer full, the handshake fails rather than waiting
 				SinkBuf sb(socket);
 				char buf[1024];
 				sb.pubsetbuf(buf, sizeof buf);
@@ -306,6 +697,10 @@ void WebSocketServerHandshake::send_error(int status_code, const char reason_phr
 
 
 void WebSocketClientHandshake::start(const char host[], in_port_t port, const char request_uri[]) {
+	// the window of our own compressor is the least of this and the server's bound, and zlib cannot deflate in 2^8 bytes
+	if (deflate_config && deflate_config->client_max_window_bits < 9) {
+		throw std::invalid_argument("client_max_window_bits must be at least 9");
+	}
 	HttpRequestHeaders request_headers("GET", request_uri, "HTTP/1.1");
 	request_headers.emplace_hint(request_headers.end(), "Connection", "Upgrade");
 	if (port == 0) {
@@ -326,7 +721,11 @@ void WebSocketClientHandshake::start(const char host[], in_port_t port, const ch
 	}
 	request_headers.emplace_hint(request_headers.end(), "Sec-WebSocket-Version", "13");
 	request_headers.emplace_hint(request_headers.end(), "Upgrade", "websocket");
+	if (deflate_config) {
+		request_headers.emplace("Sec-WebSocket-Extensions", format_deflate_extension(*deflate_config, deflate_config->server_max_window_bits < 15, true));
+	}
 	this->prepare_request_headers(request_headers);
+	// as with the server's response, the request fits in the empty send buffer of the new connection
 	SinkBuf sb(socket);
 	char buf[1024];
 	sb.pubsetbuf(buf, sizeof buf);
@@ -353,6 +752,7 @@ bool WebSocketClientHandshake::ready() {
 			auto accept_itr = response_headers.find("Sec-WebSocket-Accept"_ci);
 			auto end_itr = response_headers.end();
 			if (upgrade_itr != end_itr && connection_itr != end_itr && accept_itr != end_itr && upgrade_itr->second == "websocket"_ci && accept_itr->second.size() == 28 && accept_itr->second == make_accept_field_value(key)) {
+				this->accept_deflate(response_headers);
 				this->connected(response_headers);
 				return false;
 			}
@@ -365,6 +765,24 @@ bool WebSocketClientHandshake::ready() {
 	return true;
 }
 
+void WebSocketClientHandshake::accept_deflate(const HttpResponseHeaders &response_headers) {
+	auto extensions = parse_deflate_extensions(response_headers);
+	if (extensions.empty()) {
+		return;
+	}
+	if (!deflate_config || extensions.size() > 1) {
+		throw std::ios_base::failure("WebSocket server responded with unoffered extension");
+	}
+	auto &accepted = extensions.front();
+	// the server must honor our request to keep its own compression from taking context over and may not widen its window
+	if (!accepted.valid || deflate_config->server_no_context_takeover && !accepted.params.server_no_context_takeover || accepted.params.server_max_window_bits > deflate_config->server_max_window_bits || accepted.client_max_window_bits && accepted.params.client_max_window_bits < 9) {
+		throw std::ios_base::failure("WebSocket server responded with unacceptable permessage-deflate parameters");
+	}
+	deflate = accepted.params;
+	deflate->client_max_window_bits = std::min(accepted.params.client_max_window_bits, deflate_config->client_max_window_bits);
+	deflate->client_no_context_takeover |= deflate_config->client_no_context_takeover;
+}
+
 void WebSocketClientHandshake::prepare_request_headers(HttpRequestHeaders &) {
 }
 
@@ -1,12 +1,95 @@
+#define ZLIB_CONST
+
 #include <array>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <streambuf>
 
+#include <zlib.h>
+
+#include "buffer.h"
 #include "compiler.h"
 #include "http.h"
 #include "socket.h"
 
 
+/**
+ * @brief The parameters of the permessage-deflate extension (RFC 7692).
+ *
+ * As negotiated, these bound the LZ77 window that each endpoint compresses with and say whether it must compress each
+ * message independently of the ones before it. As the configuration of a handshake, they bound what is offered or
+ * accepted: window sizes no larger than these are agreed to, and a \c no_context_takeover that is set is requested.
+ * The window of an endpoint's own compressor must be at least 2^9 bytes, as zlib cannot deflate in a smaller one.
+ */
+struct WebSocketDeflateParams {
+	uint8_t server_max_window_bits = 15;
+	uint8_t client_max_window_bits = 15;
+	bool server_no_context_takeover = false;
+	bool client_no_context_takeover = false;
+};
+
+
+/**
+ * @brief Compresses messages for the permessage-deflate extension.
+ *
+ * Without context takeover, every message is compressed independently, so the output does not depend on which
+ * connection it is sent on. A server that has negotiated \c server_no_context_takeover can therefore compress a
+ * broadcast message once and send the result to each of its clients with @ref WebSocket::send_compressed, provided that
+ * the window of the compressor fits the \c server_max_window_bits negotiated with each of them.
+ */
+class WebSocketDeflater {
+
+private:
+	z_stream stream;
+	const bool context_takeover;
+
+public:
+	explicit WebSocketDeflater(unsigned window_bits = 15, bool context_takeover = false, int level = Z_DEFAULT_COMPRESSION);
+	~WebSocketDeflater();
+
+private:
+	WebSocketDeflater(const WebSocketDeflater &) = delete;
+	WebSocketDeflater & operator = (const WebSocketDeflater &) = delete;
+
+public:
+	// compresses a whole message into the payload data of its frame, replacing the contents of out
+	void deflate(Buffer &out, const void *buf, size_t n);
+
+};
+
+
+// decompresses messages for the permessage-deflate extension
+class WebSocketInflater {
+
+private:
+	z_stream stream;
+	const bool context_takeover;
+
+public:
+	explicit WebSocketInflater(bool context_takeover = true);
+	~WebSocketInflater();
+
+private:
+	WebSocketInflater(const WebSocketInflater &) = delete;
+	WebSocketInflater & operator = (const WebSocketInflater &) = delete;
+
+public:
+	/**
+	 * @brief Decompresses payload data of a compressed message, appending to \p out.
+	 *
+	 * The payload data may be passed in pieces as they are received; \p final must be set with the last piece of the
+	 * message, which may be empty. Throws \c std::ios_base::failure if the data are corrupt or if the unread contents
+	 * of \p out would grow beyond \p max_size bytes, which bounds the memory that a small message can make us allocate.
+	 */
+	void inflate(Buffer &out, const void *data, size_t n, bool final, size_t max_size = SIZE_MAX);
+
+private:
+	void inflate(Buffer &out, const void *data, size_t n, size_t max_size);
+
+};
+
+
 class WebSocket {
 
 public:
@@ -63,6 +146,27 @@ private:
 	 */
 	size_t send_data_rem = 0;
 
+	/**
+	 * @brief Whether the message being read is compressed, i.e., whether its first frame has the \c RSV1 bit set.
+	 */
+	bool recv_compressed = false;
+
+	/**
+	 * @brief Whether the frame being read is a control frame, which may come between the frames of a data message.
+	 */
+	bool recv_control = false;
+
+	/**
+	 * @brief The compressor and decompressor of permessage-deflate, if it has been enabled.
+	 */
+	std::unique_ptr<WebSocketDeflater> deflater;
+	std::unique_ptr<WebSocketInflater> inflater;
+
+	/**
+	 * @brief The compressed payload data of the message being written by @ref send_message, if any.
+	 */
+	Buffer deflated;
+
 public:
 	explicit WebSocket(Socket &&socket, bool send_mask) noexcept : socket(std::move(socket)), send_mask(send_mask) { }
 
@@ -82,6 +186,23 @@ public:
 	 */
 	bool _pure is_frame_fully_received() const noexcept { return static_cast<int8_t>(recv_hdr_pos) < 0 && recv_data_rem == 0; }
 
+	/**
+	 * @brief Returns whether the message being received is compressed, in which case its payload data are to be passed
+	 * through @ref inflate.
+	 *
+	 * This is valid once the opcode of the first frame of the message has been received and remains so through its
+	 * continuation frames. It is \c false for control frames, which are never compressed.
+	 */
+	bool _pure is_compressed() const noexcept { return recv_compressed && !recv_control; }
+
+	/**
+	 * @brief Enables the permessage-deflate extension with the parameters negotiated in the opening handshake.
+	 *
+	 * Which parameters apply to which direction follows from whether this endpoint masks its frames, i.e., is a client.
+	 * Peers may then send compressed messages, and @ref send_message compresses the messages that it sends.
+	 */
+	void enable_deflate(const WebSocketDeflateParams &params, int level = Z_DEFAULT_COMPRESSION);
+
 	/**
 	 * @brief Receives (part of) a WebSocket frame.
 	 *
@@ -97,6 +218,20 @@ public:
 	 */
 	_nodiscard ssize_t receive(Opcode &opcode, void *buf, size_t n);
 
+	/**
+	 * @brief Receives (part of) a WebSocket frame without copying its payload data out of the buffer of \p source.
+	 *
+	 * The frame header is parsed in place, and masked payload data are unmasked in place.
+	 * Calls of this function must not be interleaved with calls of the other overload in the middle of a frame header.
+	 *
+	 * @param[out] opcode As for the other overload.
+	 * @param[in] source A buffered source reading from @ref socket.
+	 * @param[out] data Set to point to the received payload data, which remain valid until the next call of any member function of \p source.
+	 * @param[in] n The maximum number of bytes of payload data to receive.
+	 * @return as for the other overload.
+	 */
+	_nodiscard ssize_t receive(Opcode &opcode, BufferedSourceBase &source, void *&data, size_t n = SIZE_MAX);
+
 	/**
 	 * @brief Sends a WebSocket frame.
 	 *
@@ -111,6 +246,50 @@ public:
 	 */
 	_nodiscard bool send(Opcode opcode, const void *buf, size_t n, bool more = false);
 
+	/**
+	 * @brief Sends a WebSocket frame through a sink that accepts all data written to it, such as an @ref AsyncStream over @ref socket.
+	 *
+	 * The frame is encoded once and handed to \p sink in a single gathering write, so there is nothing to retry.
+	 * This must not be interleaved with an incomplete send of the other overload.
+	 */
+	void send(Sink &sink, Opcode opcode, const void *buf, size_t n, bool more = false);
+
+	/**
+	 * @brief Sends a whole message in one frame, compressing it if permessage-deflate is enabled and it is a data message.
+	 *
+	 * @return as for @ref send, which applies likewise. The message is compressed only by the first call.
+	 */
+	_nodiscard bool send_message(Opcode opcode, const void *buf, size_t n);
+
+	// as above, through a sink that accepts all data written to it
+	void send_message(Sink &sink, Opcode opcode, const void *buf, size_t n);
+
+	/**
+	 * @brief Sends a data message in one frame whose payload data were compressed by @ref WebSocketDeflater::deflate.
+	 *
+	 * permessage-deflate must be enabled. This lets a compressor be shared among connections; see @ref WebSocketDeflater.
+	 *
+	 * @return as for @ref send, which applies likewise.
+	 */
+	_nodiscard bool send_compressed(Opcode opcode, const void *buf, size_t n);
+
+	// as above, through a sink that accepts all data written to it
+	void send_compressed(Sink &sink, Opcode opcode, const void *buf, size_t n);
+
+	/**
+	 * @brief Decompresses payload data of the message being received; see @ref WebSocketInflater::inflate.
+	 *
+	 * The message must be compressed, as @ref is_compressed says. Pass \p final once its final frame has been fully
+	 * received.
+	 */
+	void inflate(Buffer &out, const void *data, size_t n, bool final, size_t max_size = SIZE_MAX);
+
+private:
+	Opcode check_opcode(uint8_t byte0);
+	size_t make_header(uint8_t (&hdr)[14], Opcode opcode, size_t n, bool more, bool compressed) const noexcept;
+	bool send_frame(Opcode opcode, const void *buf, size_t n, bool more, bool compressed);
+	void send_frame(Sink &sink, Opcode opcode, const void *buf, size_t n, bool more, bool compressed);
+
 };
 
 
@@ -122,12 +301,24 @@ public:
 public:
 	Socket socket;
 
+	/**
+	 * @brief The parameters of permessage-deflate, if they have been negotiated.
+	 *
+	 * This is set before @ref prepare_response_headers is called.
+	 */
+	std::optional<WebSocketDeflateParams> deflate;
+
 private:
 	std::array<uint8_t, 1460> request_buf;
 	size_t request_pos;
+	const WebSocketDeflateParams * const deflate_config;
 
 public:
-	WebSocketServerHandshake(Socket &&socket) noexcept : socket(std::move(socket)), request_pos() { }
+	/**
+	 * @param deflate_config If not null, the parameters with which to accept an offer of permessage-deflate, in which
+	 * case it must outlive the handshake. The first offer that is compatible with them is accepted.
+	 */
+	WebSocketServerHandshake(Socket &&socket, const WebSocketDeflateParams *deflate_config = nullptr) noexcept : socket(std::move(socket)), request_pos(), deflate_config(deflate_config) { }
 
 public:
 	bool ready();
@@ -148,14 +339,27 @@ class WebSocketClientHandshake {
 public:
 	Socket socket;
 
+	/**
+	 * @brief The parameters of permessage-deflate, if the server has accepted them.
+	 *
+	 * This is set before @ref connected is called.
+	 */
+	std::optional<WebSocketDeflateParams> deflate;
+
 private:
 	std::string key;
 	DelimitedSource delimited_source;
 	std::array<uint8_t, 1460> response_buf;
 	size_t response_pos;
+	const WebSocketDeflateParams * const deflate_config;
 
 public:
-	WebSocketClientHandshake(Socket &&socket) noexcept : socket(std::move(socket)), delimited_source(this->socket, "\r\n\r\n"), response_pos() { }
+	/**
+	 * @param deflate_config If not null, the parameters with which to offer permessage-deflate, in which case it must
+	 * outlive the handshake. A response that does not honor them fails the handshake. Since they bound the window
+	 * of the client's own compressor, @ref start throws \c std::invalid_argument if \c client_max_window_bits is below 9.
+	 */
+	WebSocketClientHandshake(Socket &&socket, const WebSocketDeflateParams *deflate_config = nullptr) noexcept : socket(std::move(socket)), delimited_source(this->socket, "\r\n\r\n"), response_pos(), deflate_config(deflate_config) { }
 
 public:
 	void start(const char host[], in_port_t port = 0, const char request_uri[] = "/");
@@ -166,6 +370,9 @@ protected:
 	virtual void validate_response_headers(const HttpResponseHeaders &response_headers);
 	virtual void connected(const HttpResponseHeaders &response_headers) = 0;
 
+private:
+	void accept_deflate(const HttpResponseHeaders &response_headers);
+
 };
 
 
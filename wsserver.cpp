@@ -18,7 +18,7 @@ private:
 	Selector &selector;
 
 public:
-	Handshake(Socket &&socket, WebSocketServer &server, Selector &selector, bool add = true) noexcept : WebSocketServerHandshake(std::move(socket)), server(server), selector(selector) {
+	Handshake(Socket &&socket, WebSocketServer &server, Selector &selector, bool add = true) noexcept : WebSocketServerHandshake(std::move(socket), server.deflate_config()), server(server), selector(selector) {
 		if (add) {
 			selector.add(this->socket, this, Selector::Flags::READABLE);
 		}
@@ -55,7 +55,7 @@ protected:
 	}
 
 	void connected(const HttpRequestHeaders &request_headers, const HttpResponseHeaders &) override {
-		server.client_attached(std::move(socket), selector, request_headers);
+		server.client_attached(std::move(socket), selector, request_headers, deflate ? &*deflate : nullptr);
 	}
 
 };
@@ -76,3 +76,7 @@ auto WebSocketServer::validate_request_headers(const HttpRequestHeaders &request
 	}
 	return { 101, HTTP_REASON_PHRASE_101 };
 }
+
+void WebSocketServer::client_attached(Socket &&socket, Selector &selector, const HttpRequestHeaders &request_headers, const WebSocketDeflateParams *) {
+	this->client_attached(std::move(socket), selector, request_headers);
+}
@@ -7,6 +7,8 @@ namespace {
 class Handshake;
 }
 
+struct WebSocketDeflateParams;
+
 class WebSocketServer : public Socket, public Selectable {
 	friend Handshake;
 
@@ -20,6 +22,18 @@ protected:
 	void selected(Selector &selector, Selector::Flags flags) noexcept override;
 	virtual status_t validate_request_headers(const HttpRequestHeaders &request_headers) _pure;
 	virtual void prepare_response_headers(const HttpRequestHeaders &, HttpResponseHeaders &) { }
-	virtual void client_attached(Socket &&socket, Selector &selector, const HttpRequestHeaders &request_headers) = 0;
+
+	// the parameters with which to accept offers of permessage-deflate, or null to decline them
+	virtual const WebSocketDeflateParams * _pure deflate_config() const noexcept { return nullptr; }
+
+	/**
+	 * @brief Called when a client has completed the opening handshake.
+	 *
+	 * @param deflate The parameters of permessage-deflate if they were negotiated, in which case the connection's
+	 * @ref WebSocket must enable it with them, or else null. A server that overrides @ref deflate_config must override
+	 * this overload; by default it calls the other, which servers that never negotiate permessage-deflate may override instead.
+	 */
+	virtual void client_attached(Socket &&socket, Selector &selector, const HttpRequestHeaders &request_headers, const WebSocketDeflateParams *deflate);
+	virtual void client_attached(Socket &&, Selector &, const HttpRequestHeaders &) { }
 
 };
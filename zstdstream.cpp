@@ -0,0 +1,91 @@
+#include "zstdstream.tcc"
+
+#include <ios>
+
+#include <zstd_errors.h>
+
+
+namespace zstd {
+
+namespace {
+
+struct CCtxDeleter {
+	void operator () (ZSTD_CCtx *cctx) const noexcept { ZSTD_freeCCtx(cctx); }
+};
+
+struct DCtxDeleter {
+	void operator () (ZSTD_DCtx *dctx) const noexcept { ZSTD_freeDCtx(dctx); }
+};
+
+} // namespace
+
+// one-shot calls reuse a context per thread, as creating one costs far more than compressing a small message
+static ZSTD_CCtx * thread_cctx() {
+	static thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> cctx;
+	if (!cctx && !(cctx.reset(ZSTD_createCCtx()), cctx)) {
+		throw std::bad_alloc();
+	}
+	return cctx.get();
+}
+
+static ZSTD_DCtx * thread_dctx() {
+	static thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> dctx;
+	if (!dctx && !(dctx.reset(ZSTD_createDCtx()), dctx)) {
+		throw std::bad_alloc();
+	}
+	return dctx.get();
+}
+
+
+Dictionary::Dictionary(const void *dict, size_t size, int level) : cdict(ZSTD_createCDict(dict, size, level)), ddict(ZSTD_createDDict(dict, size)) {
+	if (!cdict || !ddict) {
+		ZSTD_freeCDict(cdict), ZSTD_freeDDict(ddict);
+		throw std::bad_alloc();
+	}
+}
+
+Dictionary::~Dictionary() {
+	ZSTD_freeCDict(cdict), ZSTD_freeDDict(ddict);
+}
+
+
+void throw_error(size_t code) {
+	if (ZSTD_getErrorCode(code) == ZSTD_error_memory_allocation) {
+		throw std::bad_alloc();
+	}
+	throw std::ios_base::failure(ZSTD_getErrorName(code));
+}
+
+size_t compress_bound(size_t n) noexcept {
+	return ZSTD_compressBound(n);
+}
+
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, int level) {
+	return check(ZSTD_compressCCtx(thread_cctx(), dst, dst_size, src, n, level));
+}
+
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary) {
+	return check(ZSTD_compress_usingCDict(thread_cctx(), dst, dst_size, src, n, dictionary.cdict_ptr()));
+}
+
+uint64_t content_size(const void *src, size_t n) {
+	unsigned long long size = ZSTD_getFrameContentSize(src, n);
+	if (size == ZSTD_CONTENTSIZE_ERROR) {
+		throw std::ios_base::failure("invalid zstd frame");
+	}
+	return size == ZSTD_CONTENTSIZE_UNKNOWN ? UINT64_MAX : size;
+}
+
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n) {
+	return check(ZSTD_decompressDCtx(thread_dctx(), dst, dst_size, src, n));
+}
+
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary) {
+	return check(ZSTD_decompress_usingDDict(thread_dctx(), dst, dst_size, src, n, dictionary.ddict_ptr()));
+}
+
+} // namespace zstd
+
+
+template class BasicZstdSource<Source>;
+template class BasicZstdSink<Sink>;
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+
+#include <zstd.h>
+
+#include "io.h"
+
+
+namespace zstd {
+
+/**
+ * @brief A digested dictionary, which may be shared among any number of compressors and decompressors.
+ *
+ * Digesting a dictionary is costly, so reuse one object for all messages that share a dictionary.
+ */
+class Dictionary {
+
+private:
+	ZSTD_CDict *cdict;
+	ZSTD_DDict *ddict;
+
+public:
+	Dictionary(const void *dict, size_t size, int level = ZSTD_CLEVEL_DEFAULT);
+	Dictionary(Dictionary &&move) noexcept : cdict(move.cdict), ddict(move.ddict) { move.cdict = nullptr, move.ddict = nullptr; }
+	Dictionary & operator = (Dictionary &&move) noexcept { return this->swap(move), *this; }
+	~Dictionary();
+	void swap(Dictionary &other) noexcept { using std::swap; swap(cdict, other.cdict), swap(ddict, other.ddict); }
+	friend void swap(Dictionary &lhs, Dictionary &rhs) noexcept { lhs.swap(rhs); }
+
+private:
+	Dictionary(const Dictionary &) = delete;
+	Dictionary & operator = (const Dictionary &) = delete;
+
+public:
+	const ZSTD_CDict * _pure cdict_ptr() const noexcept { return cdict; }
+	const ZSTD_DDict * _pure ddict_ptr() const noexcept { return ddict; }
+
+};
+
+// throws the error denoted by a zstd return code
+_noreturn void throw_error(size_t code);
+
+static inline size_t check(size_t code) {
+	if (ZSTD_isError(code)) {
+		throw_error(code);
+	}
+	return code;
+}
+
+size_t _const compress_bound(size_t n) noexcept;
+
+/**
+ * @brief Compresses a buffer into a single frame that records its content size.
+ *
+ * @return the size of the frame. Throws if \p dst_size is too small, which it cannot be if it is at least \ref compress_bound(\p n).
+ */
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, int level = ZSTD_CLEVEL_DEFAULT);
+size_t compress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary);
+
+/**
+ * @brief Returns the decompressed size of the frame at the start of the given buffer, or \c UINT64_MAX if the frame does not record it.
+ */
+uint64_t content_size(const void *src, size_t n);
+
+/**
+ * @brief Decompresses all frames in a buffer.
+ *
+ * @return the decompressed size. Throws if \p dst_size is too small.
+ */
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n);
+size_t decompress(void *dst, size_t dst_size, const void *src, size_t n, const Dictionary &dictionary);
+
+} // namespace zstd
+
+
+// definitions in zstdstream.tcc; see the note on stream adapters in io.h
+template <typename S = Source>
+class BasicZstdSource : public Source {
+
+private:
+	S &source;
+	ZSTD_DCtx * const dctx;
+	std::unique_ptr<uint8_t[]> ibuf;
+	ZSTD_inBuffer in;
+	bool eof, in_frame;
+
+public:
+	explicit BasicZstdSource(S &source);
+	BasicZstdSource(S &source, const zstd::Dictionary &dictionary);
+	~BasicZstdSource();
+
+private:
+	BasicZstdSource(const BasicZstdSource &) = delete;
+	BasicZstdSource & operator = (const BasicZstdSource &) = delete;
+
+public:
+	ssize_t read(void *buf, size_t n) override;
+
+};
+
+using ZstdSource = BasicZstdSource<>;
+
+
+/**
+ * @brief Compresses into a sink.
+ *
+ * @ref flush ends the current frame; a subsequent write begins a new one, and a @ref ZstdSource reads all frames as one stream.
+ */
+template <typename K = Sink>
+class BasicZstdSink : public Sink {
+
+private:
+	K &sink;
+	ZSTD_CCtx * const cctx;
+	std::unique_ptr<uint8_t[]> obuf;
+	size_t opos, oend;
+	bool in_frame;
+
+public:
+	/**
+	 * @param[in] workers The number of threads with which to compress in parallel, or zero to compress on the writing thread.
+	 * Throws if non-zero and the zstd library was built without multithreading.
+	 */
+	explicit BasicZstdSink(K &sink, int level = ZSTD_CLEVEL_DEFAULT, unsigned workers = 0);
+	BasicZstdSink(K &sink, const zstd::Dictionary &dictionary, unsigned workers = 0);
+	~BasicZstdSink();
+
+private:
+	BasicZstdSink(const BasicZstdSink &) = delete;
+	BasicZstdSink & operator = (const BasicZstdSink &) = delete;
+
+public:
+	size_t write(const void *buf, size_t n) override;
+	bool flush() override;
+
+private:
+	void set_workers(unsigned workers);
+	bool drain();
+
+};
+
+using ZstdSink = BasicZstdSink<>;
@@ -0,0 +1,146 @@
+#include "zstdstream.h"
+
+#include <cstring>
+#include <new>
+
+
+template <typename S>
+BasicZstdSource<S>::BasicZstdSource(S &source) : source(source), dctx(ZSTD_createDCtx()), in { nullptr, 0, 0 }, eof(), in_frame() {
+	if (!dctx) {
+		throw std::bad_alloc();
+	}
+	try {
+		ibuf.reset(new uint8_t[ZSTD_DStreamInSize()]);
+	}
+	catch (...) {
+		ZSTD_freeDCtx(dctx);
+		throw;
+	}
+	in.src = ibuf.get();
+}
+
+template <typename S>
+BasicZstdSource<S>::BasicZstdSource(S &source, const zstd::Dictionary &dictionary) : BasicZstdSource(source) {
+	// the delegated constructor has completed, so the destructor frees the context if this throws
+	zstd::check(ZSTD_DCtx_refDDict(dctx, dictionary.ddict_ptr()));
+}
+
+template <typename S>
+BasicZstdSource<S>::~BasicZstdSource() {
+	ZSTD_freeDCtx(dctx);
+}
+
+template <typename S>
+ssize_t BasicZstdSource<S>::read(void *buf, size_t n) {
+	auto ibegin = const_cast<uint8_t *>(static_cast<const uint8_t *>(in.src));
+	if (in.pos == in.size) {
+		in.pos = in.size = 0;
+	}
+	else if (in.pos > 0 && in.size == ZSTD_DStreamInSize()) {
+		std::memmove(ibegin, ibegin + in.pos, in.size -= in.pos);
+		in.pos = 0;
+	}
+	if (!eof && in.size < ZSTD_DStreamInSize()) {
+		ssize_t r = source.read(ibegin + in.size, ZSTD_DStreamInSize() - in.size);
+		if (r > 0) {
+			in.size += r;
+		}
+		else if (r < 0) {
+			eof = true;
+		}
+	}
+	ZSTD_outBuffer out = { buf, n, 0 };
+	// between frames, a call without input would return the size of the next frame header
+	while (in.pos < in.size || in_frame) {
+		// a return of zero means that a frame has been completely decoded and flushed
+		in_frame = zstd::check(ZSTD_decompressStream(dctx, &out, &in)) != 0;
+		if (out.pos > 0 || in.pos == in.size) {
+			break;
+		}
+	}
+	if (out.pos > 0) {
+		return out.pos;
+	}
+	if (eof && in.pos == in.size) {
+		if (in_frame) {
+			throw std::ios_base::failure("truncated zstd frame");
+		}
+		return -1;
+	}
+	return 0;
+}
+
+
+template <typename K>
+BasicZstdSink<K>::BasicZstdSink(K &sink, int level, unsigned workers) : sink(sink), cctx(ZSTD_createCCtx()), opos(), oend(), in_frame() {
+	if (!cctx) {
+		throw std::bad_alloc();
+	}
+	try {
+		obuf.reset(new uint8_t[ZSTD_CStreamOutSize()]);
+		zstd::check(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level));
+		this->set_workers(workers);
+	}
+	catch (...) {
+		ZSTD_freeCCtx(cctx);
+		throw;
+	}
+}
+
+template <typename K>
+BasicZstdSink<K>::BasicZstdSink(K &sink, const zstd::Dictionary &dictionary, unsigned workers) : BasicZstdSink(sink, ZSTD_CLEVEL_DEFAULT, workers) {
+	zstd::check(ZSTD_CCtx_refCDict(cctx, dictionary.cdict_ptr()));
+}
+
+template <typename K>
+BasicZstdSink<K>::~BasicZstdSink() {
+	ZSTD_freeCCtx(cctx);
+}
+
+template <typename K>
+size_t BasicZstdSink<K>::write(const void *buf, size_t n) {
+	size_t consumed = 0;
+	while (consumed < n && this->drain()) {
+		ZSTD_inBuffer in = { static_cast<const uint8_t *>(buf) + consumed, n - consumed, 0 };
+		ZSTD_outBuffer out = { obuf.get(), ZSTD_CStreamOutSize(), 0 };
+		// with workers, this may neither consume nor produce while the job queue is full, in which case we simply try again
+		zstd::check(ZSTD_compressStream2(cctx, &out, &in, ZSTD_e_continue));
+		consumed += in.pos;
+		opos = 0, oend = out.pos;
+		in_frame = true;
+	}
+	return consumed;
+}
+
+template <typename K>
+bool BasicZstdSink<K>::flush() {
+	while (this->drain()) {
+		if (!in_frame) {
+			return sink.flush();
+		}
+		ZSTD_inBuffer in = { nullptr, 0, 0 };
+		ZSTD_outBuffer out = { obuf.get(), ZSTD_CStreamOutSize(), 0 };
+		in_frame = zstd::check(ZSTD_compressStream2(cctx, &out, &in, ZSTD_e_end)) != 0;
+		opos = 0, oend = out.pos;
+	}
+	return false;
+}
+
+template <typename K>
+void BasicZstdSink<K>::set_workers(unsigned workers) {
+	if (workers > 0) {
+		zstd::check(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, static_cast<int>(workers)));
+	}
+}
+
+template <typename K>
+bool BasicZstdSink<K>::drain() {
+	while (opos < oend) {
+		size_t w = sink.write(obuf.get() + opos, oend - opos);
+		if (w == 0) {
+			return false;
+		}
+		opos += w;
+	}
+	return true;
+}